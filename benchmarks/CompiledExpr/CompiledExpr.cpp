@@ -0,0 +1,216 @@
+//===-- CompiledExpr.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures how long it takes to check whether assignments satisfy a path
+// condition, as the counterexample cache does, with Assignment::evaluate,
+// with compiled expressions and with the memoizing CompiledExprCache. The
+// constraints are read from .kquery files, where the query with the longest
+// path condition of each file is used, or generated if none are given.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/CompiledExpr.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/Parser/Parser.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+using namespace klee::expr;
+using namespace llvm;
+
+namespace {
+cl::list<std::string> InputFiles(cl::Positional,
+                                 cl::desc("<.kquery files>"));
+
+cl::opt<unsigned> Conjuncts("conjuncts",
+                            cl::desc("Number of constraints of a generated "
+                                     "path condition (default=200)"),
+                            cl::init(200));
+
+cl::opt<unsigned> Assignments("assignments",
+                              cl::desc("Number of assignments to check "
+                                       "(default=64)"),
+                              cl::init(64));
+
+cl::opt<unsigned> Rounds("rounds",
+                         cl::desc("Number of times each assignment is "
+                                  "checked (default=5)"),
+                         cl::init(5));
+
+// Comparisons and arithmetic on 32-bit integers made of four bytes of a few
+// arrays, as in the path conditions of C programs, with some reads at
+// symbolic indices.
+std::vector<ref<Expr> > generate(ArrayCache &cache) {
+  std::mt19937 rng(42);
+  std::vector<const Array *> arrays;
+  for (unsigned i = 0; i < 8; ++i)
+    arrays.push_back(cache.CreateArray("arr" + llvm::utostr(i), 64));
+
+  auto byte = [&](ref<Expr> index) {
+    return ReadExpr::create(UpdateList(arrays[rng() % arrays.size()], 0),
+                            index);
+  };
+  auto integer = [&]() {
+    unsigned offset = 4 * (rng() % 16);
+    ref<Expr> e = byte(ConstantExpr::alloc(offset, Expr::Int32));
+    for (unsigned i = 1; i < 4; ++i)
+      e = ConcatExpr::create(
+          byte(ConstantExpr::alloc(offset + i, Expr::Int32)), e);
+    return e;
+  };
+
+  std::vector<ref<Expr> > constraints;
+  for (unsigned i = 0; i < Conjuncts; ++i) {
+    ref<Expr> l = integer();
+    switch (rng() % 4) {
+    case 0:
+      l = AddExpr::create(l, integer());
+      break;
+    case 1:
+      l = MulExpr::create(l, ConstantExpr::alloc(rng() % 16, Expr::Int32));
+      break;
+    case 2:
+      l = ZExtExpr::create(
+          byte(ZExtExpr::create(ExtractExpr::create(integer(), 0, 5),
+                                Expr::Int32)),
+          Expr::Int32);
+      break;
+    default:
+      break;
+    }
+    ref<Expr> r = ConstantExpr::alloc(rng(), Expr::Int32);
+    constraints.push_back(rng() % 2 ? SltExpr::create(l, r)
+                                    : UleExpr::create(l, r));
+  }
+  return constraints;
+}
+
+void run(const std::string &name, const std::vector<ref<Expr> > &constraints) {
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(constraints.begin(), constraints.end(), arrays);
+
+  std::mt19937 rng(7);
+  std::vector<std::shared_ptr<const Assignment> > assignments;
+  for (unsigned i = 0; i < Assignments; ++i) {
+    Assignment::map_bindings_ty models;
+    for (const Array *array : arrays)
+      for (unsigned j = 0; j < array->size; ++j)
+        models[array].add(j, rng());
+    assignments.push_back(std::make_shared<const Assignment>(models));
+  }
+  const uint64_t evaluations =
+      uint64_t(Rounds) * assignments.size() * constraints.size();
+
+  unsigned satisfied = 0;
+  time::Point start = time::getWallTime();
+  for (unsigned r = 0; r < Rounds; ++r)
+    for (auto &a : assignments)
+      for (const ref<Expr> &e : constraints)
+        satisfied += a->evaluate(e)->isTrue();
+  time::Span visitorTime = time::getWallTime() - start;
+
+  start = time::getWallTime();
+  std::vector<std::unique_ptr<CompiledExpr> > compiled;
+  size_t instructions = 0;
+  for (const ref<Expr> &e : constraints) {
+    compiled.emplace_back(new CompiledExpr(e));
+    instructions += compiled.back()->size();
+  }
+  time::Span compileTime = time::getWallTime() - start;
+
+  unsigned compiledSatisfied = 0;
+  start = time::getWallTime();
+  for (unsigned r = 0; r < Rounds; ++r) {
+    for (auto &a : assignments) {
+      for (auto &c : compiled) {
+        bool isTrue;
+        if (c->isTrue(*a, isTrue))
+          compiledSatisfied += isTrue;
+      }
+    }
+  }
+  time::Span compiledTime = time::getWallTime() - start;
+
+  CompiledExprCache cache;
+  unsigned cachedSatisfied = 0;
+  start = time::getWallTime();
+  for (unsigned r = 0; r < Rounds; ++r)
+    for (auto &a : assignments)
+      for (const ref<Expr> &e : constraints)
+        cachedSatisfied += cache.evaluate(e, a)->isTrue();
+  time::Span cachedTime = time::getWallTime() - start;
+
+  if (compiledSatisfied != satisfied || cachedSatisfied != satisfied)
+    errs() << name << ": results differ\n";
+
+  auto perEvaluation = [&](time::Span t) {
+    return format("%.1f", (double)t.toMicroseconds() * 1000 / evaluations);
+  };
+  outs() << name << ": " << constraints.size() << " constraints, "
+         << instructions << " instructions, " << assignments.size()
+         << " assignments\n";
+  outs() << "  visitor:  " << perEvaluation(visitorTime) << " ns/eval\n";
+  outs() << "  compiled: " << perEvaluation(compiledTime) << " ns/eval ("
+         << compileTime.toMicroseconds() << " us to compile)\n";
+  outs() << "  memoized: " << perEvaluation(cachedTime) << " ns/eval\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Compiled expression benchmark\n");
+
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  ArrayCache cache;
+
+  if (InputFiles.empty())
+    run("generated", generate(cache));
+
+  for (const std::string &file : InputFiles) {
+    auto buffer = MemoryBuffer::getFile(file);
+    if (!buffer) {
+      errs() << file << ": " << buffer.getError().message() << "\n";
+      return 1;
+    }
+    std::unique_ptr<Parser> parser(
+        Parser::Create(file, buffer->get(), builder.get(), false));
+    std::vector<std::unique_ptr<Decl> > decls;
+    // measure the query with the longest path condition
+    std::vector<ref<Expr> > longest;
+    while (Decl *decl = parser->ParseTopLevelDecl()) {
+      decls.emplace_back(decl);
+      if (QueryCommand *qc = dyn_cast<QueryCommand>(decl))
+        if (qc->Constraints.size() >= longest.size())
+          longest = qc->Constraints;
+    }
+    if (parser->GetNumErrors()) {
+      errs() << file << ": parse failure\n";
+      return 1;
+    }
+    if (longest.empty()) {
+      errs() << file << ": no query with constraints\n";
+      continue;
+    }
+    run(file, longest);
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+//===-- IndependentSolver.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures how long the independent solver takes to split path conditions
+// into independent factors. The queries are read from .kquery files, e.g.
+// recorded with --use-query-log=all:kquery, where the query with the longest
+// path condition of each file is used, or generated if none are given.
+// The underlying solver is the dummy solver, so only the partitioning is
+// measured.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/Parser/Parser.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/Solver.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+using namespace klee::expr;
+using namespace llvm;
+
+namespace {
+cl::list<std::string> InputFiles(cl::Positional,
+                                 cl::desc("<.kquery files>"));
+
+cl::opt<unsigned> Conjuncts("conjuncts",
+                            cl::desc("Number of constraints of a generated "
+                                     "path condition (default=4000)"),
+                            cl::init(4000));
+
+cl::opt<unsigned> Arrays("arrays",
+                         cl::desc("Number of arrays read by a generated path "
+                                  "condition (default=256)"),
+                         cl::init(256));
+
+cl::opt<unsigned> Rounds("rounds",
+                         cl::desc("Number of times each query is solved "
+                                  "(default=5)"),
+                         cl::init(5));
+
+struct PathCondition {
+  std::vector<ref<Expr> > constraints;
+  ref<Expr> expr;
+};
+
+// Mostly bounds on single bytes, some equalities between bytes of
+// different arrays and a few reads at symbolic indices.
+PathCondition generate(ArrayCache &cache) {
+  std::mt19937 rng(42);
+  std::vector<const Array *> arrays;
+  for (unsigned i = 0; i < Arrays; ++i)
+    arrays.push_back(cache.CreateArray("arr" + llvm::utostr(i), 16));
+
+  auto read = [&](const Array *array, ref<Expr> index) {
+    return ReadExpr::create(UpdateList(array, 0), index);
+  };
+  auto byte = [&]() {
+    return read(arrays[rng() % Arrays],
+                ConstantExpr::alloc(rng() % 16, Expr::Int32));
+  };
+
+  PathCondition pc;
+  for (unsigned i = 0; i < Conjuncts; ++i) {
+    unsigned kind = rng() % 100;
+    if (kind < 70) {
+      pc.constraints.push_back(
+          UltExpr::create(byte(), ConstantExpr::alloc(rng() % 256, Expr::Int8)));
+    } else if (kind < 95) {
+      pc.constraints.push_back(EqExpr::create(byte(), byte()));
+    } else {
+      ref<Expr> index = ZExtExpr::create(byte(), Expr::Int32);
+      pc.constraints.push_back(
+          UltExpr::create(read(arrays[rng() % Arrays], index),
+                          ConstantExpr::alloc(rng() % 256, Expr::Int8)));
+    }
+  }
+  pc.expr = EqExpr::create(byte(), ConstantExpr::alloc(5, Expr::Int8));
+  return pc;
+}
+
+void run(Solver *solver, const std::string &name, const PathCondition &pc) {
+  ConstraintManager constraints(pc.constraints);
+  Query query(constraints, pc.expr);
+
+  time::Point start = time::getWallTime();
+  for (unsigned r = 0; r < Rounds; ++r) {
+    bool result;
+    solver->mustBeTrue(query, result);
+  }
+  time::Span truthTime = time::getWallTime() - start;
+
+  start = time::getWallTime();
+  for (unsigned r = 0; r < Rounds; ++r) {
+    std::shared_ptr<const Assignment> result;
+    solver->getInitialValues(query.withFalse(), result);
+  }
+  time::Span factorsTime = time::getWallTime() - start;
+
+  outs() << name << ": " << pc.constraints.size() << " constraints, "
+         << truthTime.toMicroseconds() / Rounds << " us/closure, "
+         << factorsTime.toMicroseconds() / Rounds << " us/factors\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Independent solver benchmark\n");
+
+  std::unique_ptr<Solver> solver(createIndependentSolver(createDummySolver()));
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  ArrayCache cache;
+
+  if (InputFiles.empty())
+    run(solver.get(), "generated", generate(cache));
+
+  for (const std::string &file : InputFiles) {
+    auto buffer = MemoryBuffer::getFile(file);
+    if (!buffer) {
+      errs() << file << ": " << buffer.getError().message() << "\n";
+      return 1;
+    }
+    std::unique_ptr<Parser> parser(
+        Parser::Create(file, buffer->get(), builder.get(), false));
+    std::vector<std::unique_ptr<Decl> > decls;
+    // measure the query with the longest path condition
+    PathCondition longest;
+    unsigned queries = 0;
+    while (Decl *decl = parser->ParseTopLevelDecl()) {
+      decls.emplace_back(decl);
+      if (QueryCommand *qc = dyn_cast<QueryCommand>(decl)) {
+        ++queries;
+        if (qc->Constraints.size() >= longest.constraints.size() &&
+            !isa<ConstantExpr>(qc->Query)) {
+          longest.constraints = qc->Constraints;
+          longest.expr = qc->Query;
+        }
+      }
+    }
+    if (parser->GetNumErrors()) {
+      errs() << file << ": parse failure\n";
+      return 1;
+    }
+    if (longest.expr.isNull()) {
+      errs() << file << ": no query with a non-constant expression\n";
+      continue;
+    }
+    run(solver.get(), file + " (longest of " + llvm::utostr(queries) + ")",
+        longest);
+  }
+  return 0;
+}
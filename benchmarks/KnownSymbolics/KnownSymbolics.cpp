@@ -0,0 +1,135 @@
+//===-- KnownSymbolics.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures write8/read8 of an ObjectState when a given fraction of its
+// bytes holds symbolic values, together with the memory taken by the object
+// and the cost of copying it, and the same costs for many small objects
+// holding a single symbolic byte.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Context.h"
+#include "Memory.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> ObjectSize("object-size",
+                             cl::desc("Size of the object in bytes "
+                                      "(default=262144)"),
+                             cl::init(256 * 1024));
+
+cl::opt<unsigned> Rounds("rounds",
+                         cl::desc("Number of passes over the object "
+                                  "(default=10)"),
+                         cl::init(10));
+
+void run(ArrayCache &cache, unsigned percent) {
+  const Array *array = cache.CreateArray("sym", ObjectSize);
+  UpdateList ul(array, 0);
+
+  MemoryObject *mo =
+      new MemoryObject(FIRST_ORDINARY_SEGMENT,
+                       ConstantExpr::create(ObjectSize, Expr::Int64),
+                       ObjectSize, false, false, false, nullptr, nullptr);
+  size_t mallocBefore = util::GetTotalMallocUsage();
+  std::unique_ptr<ObjectState> os(new ObjectState(mo));
+  os->initializeToZero();
+
+  // 37 is coprime to 100, so this spreads the symbolic bytes evenly
+  auto isSymbolic = [percent](unsigned i) { return (i * 37u) % 100 < percent; };
+
+  time::Point start = time::getWallTime();
+  for (unsigned r = 0; r < Rounds; ++r)
+    for (unsigned i = 0; i < ObjectSize; ++i) {
+      if (isSymbolic(i))
+        os->write(i, KValue(ReadExpr::create(
+                         ul, ConstantExpr::alloc(i, Expr::Int32))));
+      else
+        os->write8(i, VALUES_SEGMENT, i);
+    }
+  time::Span writeTime = time::getWallTime() - start;
+  size_t bytes = util::GetTotalMallocUsage() - mallocBefore;
+
+  start = time::getWallTime();
+  for (unsigned r = 0; r < Rounds; ++r)
+    for (unsigned i = 0; i < ObjectSize; ++i)
+      os->read8(i);
+  time::Span readTime = time::getWallTime() - start;
+
+  start = time::getWallTime();
+  std::unique_ptr<ObjectState> copy(new ObjectState(*os));
+  copy->write8(0, VALUES_SEGMENT, 0);
+  time::Span copyTime = time::getWallTime() - start;
+
+  uint64_t accesses = (uint64_t)ObjectSize * Rounds;
+  outs() << percent << "% symbolic: "
+         << writeTime.toMicroseconds() * 1000 / accesses << " ns/write8, "
+         << readTime.toMicroseconds() * 1000 / accesses << " ns/read8, "
+         << copyTime.toMicroseconds() << " us/copy, " << bytes
+         << " bytes\n";
+}
+// Small objects are the common case: a 4-byte object with one symbolic
+// byte must not pay for a whole chunk of the known symbolics table.
+void runSmall(ArrayCache &cache) {
+  const unsigned size = 4, count = 10000;
+  const Array *array = cache.CreateArray("small", size);
+  UpdateList ul(array, 0);
+
+  std::vector<std::unique_ptr<ObjectState> > objects, copies;
+  size_t mallocBefore = util::GetTotalMallocUsage();
+  for (unsigned i = 0; i < count; ++i) {
+    MemoryObject *mo =
+        new MemoryObject(FIRST_ORDINARY_SEGMENT + i,
+                         ConstantExpr::create(size, Expr::Int64), size, false,
+                         false, false, nullptr, nullptr);
+    objects.emplace_back(new ObjectState(mo));
+    objects.back()->initializeToZero();
+    objects.back()->write(
+        1, KValue(ReadExpr::create(ul, ConstantExpr::alloc(1, Expr::Int32))));
+  }
+  size_t bytes = util::GetTotalMallocUsage() - mallocBefore;
+
+  time::Point start = time::getWallTime();
+  for (auto &os : objects) {
+    copies.emplace_back(new ObjectState(*os));
+    copies.back()->write(
+        1, KValue(ReadExpr::create(ul, ConstantExpr::alloc(2, Expr::Int32))));
+  }
+  time::Span copyTime = time::getWallTime() - start;
+
+  outs() << size << "-byte objects, 1 symbolic byte: " << bytes / count
+         << " bytes/object, "
+         << copyTime.toMicroseconds() * 1000 / count
+         << " ns/copy and write\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Known symbolics benchmark\n");
+  Context::initialize(true, Expr::Int64);
+
+  ArrayCache cache;
+  outs() << "object size: " << ObjectSize << " bytes\n";
+  for (unsigned percent : {0, 1, 10, 50, 100})
+    run(cache, percent);
+  runSmall(cache);
+  return 0;
+}
@@ -0,0 +1,118 @@
+//===-- ObjectStateFork.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures the cost of the first write into an object after a fork, i.e.
+// what AddressSpace::getWriteable does: copy the ObjectState and write a
+// single byte into the copy. All copies are kept alive like the states of
+// a fork-heavy run would keep them. Both a large object and a small one,
+// like most locals, are measured.
+//
+// The "flat" rows model the previous representation where both planes'
+// stores and masks were contiguous buffers copied as a whole.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Context.h"
+#include "Memory.h"
+
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> ObjectSize("object-size",
+                             cl::desc("Size of the object in bytes "
+                                      "(default=4194304)"),
+                             cl::init(4 * 1024 * 1024));
+
+cl::opt<unsigned> SmallObjectSize("small-object-size",
+                                  cl::desc("Size of the small object in bytes "
+                                           "(default=16)"),
+                                  cl::init(16));
+
+cl::opt<unsigned> Forks("forks",
+                        cl::desc("Number of copies to make (default=1000)"),
+                        cl::init(1000));
+
+/// The concrete store, concrete mask and flush mask of a plane as they
+/// were laid out before the stores became chunked.
+struct FlatPlane {
+  std::vector<uint8_t> concreteStore;
+  std::vector<uint32_t> concreteMask;
+  std::vector<uint32_t> flushMask;
+
+  explicit FlatPlane(unsigned size)
+      : concreteStore(size), concreteMask((size + 31) / 32, ~0u),
+        flushMask((size + 31) / 32) {}
+};
+
+void report(const char *name, unsigned size, time::Span elapsed,
+            size_t bytes) {
+  outs() << name << " (" << size << " bytes): "
+         << elapsed.toMicroseconds() / Forks << " us/fork, " << bytes / Forks
+         << " bytes/fork\n";
+}
+
+void runFlat(unsigned size) {
+  FlatPlane original(size);
+  std::vector<std::unique_ptr<FlatPlane>> copies;
+  copies.reserve(Forks);
+
+  size_t mallocBefore = util::GetTotalMallocUsage();
+  time::Point start = time::getWallTime();
+  for (unsigned i = 0; i < Forks; ++i) {
+    copies.emplace_back(new FlatPlane(original));
+    copies.back()->concreteStore[(i * 4099u) % size] = 1;
+  }
+  time::Span elapsed = time::getWallTime() - start;
+  report("flat", size, elapsed, util::GetTotalMallocUsage() - mallocBefore);
+}
+
+void runChunked(unsigned size) {
+  MemoryObject *mo =
+      new MemoryObject(1, ConstantExpr::create(size, Expr::Int64), size,
+                       false, true, false, nullptr, nullptr);
+  ObjectState original(mo);
+  original.initializeToZero();
+  for (unsigned i = 0; i < size; ++i)
+    original.write8(i, 0, i);
+
+  std::vector<std::unique_ptr<ObjectState>> copies;
+  copies.reserve(Forks);
+
+  size_t mallocBefore = util::GetTotalMallocUsage();
+  time::Point start = time::getWallTime();
+  for (unsigned i = 0; i < Forks; ++i) {
+    copies.emplace_back(new ObjectState(original));
+    copies.back()->write8((i * 4099u) % size, 0, 1);
+  }
+  time::Span elapsed = time::getWallTime() - start;
+  report("chunked", size, elapsed, util::GetTotalMallocUsage() - mallocBefore);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "ObjectState fork benchmark\n");
+  Context::initialize(true, Expr::Int64);
+
+  outs() << "forks: " << Forks << "\n";
+  runFlat(ObjectSize);
+  runChunked(ObjectSize);
+  runFlat(SmallObjectSize);
+  runChunked(SmallObjectSize);
+  return 0;
+}
@@ -0,0 +1,83 @@
+//===-- SegmentPlane.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reports the memory taken by an ObjectState that only ever held values
+// compared to one a pointer was stored into, i.e. what an object saves by
+// not having a segment plane, and the cost of reads from both kinds.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Context.h"
+#include "Memory.h"
+
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <vector>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> ObjectSize("object-size",
+                             cl::desc("Size of the objects in bytes "
+                                      "(default=64)"),
+                             cl::init(64));
+
+cl::opt<unsigned> Objects("objects",
+                          cl::desc("Number of objects (default=100000)"),
+                          cl::init(100000));
+
+cl::opt<unsigned> Reads("reads",
+                        cl::desc("Number of reads per object (default=100)"),
+                        cl::init(100));
+
+void run(const char *name, bool storePointer) {
+  std::vector<std::unique_ptr<ObjectState>> objects;
+  objects.reserve(Objects);
+
+  size_t mallocBefore = util::GetTotalMallocUsage();
+  for (unsigned i = 0; i < Objects; ++i) {
+    MemoryObject *mo =
+        new MemoryObject(FIRST_ORDINARY_SEGMENT + i,
+                         ConstantExpr::create(ObjectSize, Expr::Int64),
+                         ObjectSize, false, false, false, nullptr, nullptr);
+    objects.emplace_back(new ObjectState(mo));
+    ObjectState *os = objects.back().get();
+    os->initializeToZero();
+    os->write64(0, storePointer ? FIRST_ORDINARY_SEGMENT : VALUES_SEGMENT, i);
+  }
+  size_t bytes = util::GetTotalMallocUsage() - mallocBefore;
+
+  time::Point start = time::getWallTime();
+  for (unsigned r = 0; r < Reads; ++r)
+    for (auto &os : objects)
+      os->read(0, Expr::Int64);
+  time::Span elapsed = time::getWallTime() - start;
+
+  outs() << name << ": " << bytes / Objects << " bytes/object, "
+         << elapsed.toMicroseconds() * 1000 / ((uint64_t)Objects * Reads)
+         << " ns/read\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Segment plane benchmark\n");
+  Context::initialize(true, Expr::Int64);
+
+  outs() << "object size: " << ObjectSize << " bytes, objects: " << Objects
+         << "\n";
+  run("values only", false);
+  run("with pointer", true);
+  return 0;
+}
@@ -0,0 +1,164 @@
+//===-- WitnessParser.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures how long it takes to load a violation witness and how much memory
+// the loaded automaton takes. The witnesses are read from GraphML files, or
+// generated if none are given: a path from the entry to the violation node
+// whose edges follow branches and calls and provide nondet values, with
+// edges into sink nodes along the way, as verifiers produce them.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ConcreteValue.h"
+#include "klee/Internal/System/MemoryUsage.h"
+#include "klee/Internal/System/Time.h"
+#include "witnessChecking/WitnessParser.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::list<std::string> InputFiles(cl::Positional,
+                                 cl::desc("<.graphml files>"));
+
+cl::opt<unsigned> Nodes("nodes",
+                        cl::desc("Number of nodes of a generated witness "
+                                 "(default=200000)"),
+                        cl::init(200000));
+
+cl::opt<unsigned> Rounds("rounds",
+                         cl::desc("Number of times each witness is loaded "
+                                  "(default=3)"),
+                         cl::init(3));
+
+void generate(raw_ostream &os) {
+  std::mt19937 rng(42);
+  os << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+     << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+     << " <key attr.name=\"isEntryNode\" attr.type=\"boolean\" for=\"node\" "
+        "id=\"entry\">\n  <default>false</default>\n </key>\n"
+     << " <graph edgedefault=\"directed\">\n"
+     << "  <data key=\"witness-type\">violation_witness</data>\n"
+     << "  <data key=\"sourcecodelang\">C</data>\n"
+     << "  <data key=\"producer\">generated</data>\n"
+     << "  <data key=\"specification\">CHECK( init(main()), "
+        "LTL(G ! call(reach_error())) )</data>\n"
+     << "  <data key=\"architecture\">64bit</data>\n";
+
+  os << "  <node id=\"N0\">\n   <data key=\"entry\">true</data>\n  </node>\n";
+  for (unsigned n = 1; n + 1 < Nodes; ++n) {
+    if (n % 16 == 0)
+      os << "  <node id=\"N" << n << "\">\n   <data key=\"sink\">true</data>\n"
+         << "  </node>\n";
+    else
+      os << "  <node id=\"N" << n << "\"/>\n";
+  }
+  os << "  <node id=\"N" << Nodes - 1 << "\">\n"
+     << "   <data key=\"violation\">true</data>\n  </node>\n";
+
+  unsigned line = 10;
+  for (unsigned n = 0; n + 1 < Nodes; ++n) {
+    // sinks are entered from the node before them
+    unsigned target = n + 1;
+    if (target % 16 == 0 && target + 1 < Nodes) {
+      os << "  <edge source=\"N" << n << "\" target=\"N" << target << "\">\n"
+         << "   <data key=\"startline\">" << line << "</data>\n"
+         << "   <data key=\"control\">condition-false</data>\n  </edge>\n";
+      ++target;
+    }
+    line += rng() % 4;
+    os << "  <edge source=\"N" << n << "\" target=\"N" << target << "\">\n"
+       << "   <data key=\"startline\">" << line << "</data>\n"
+       << "   <data key=\"endline\">" << line << "</data>\n";
+    switch (rng() % 4) {
+    case 0:
+      os << "   <data key=\"control\">condition-true</data>\n";
+      break;
+    case 1:
+      os << "   <data key=\"enterFunction\">f" << rng() % 64 << "</data>\n";
+      break;
+    case 2:
+      os << "   <data key=\"assumption\">\\result == " << int(rng() % 256) - 128
+         << ";</data>\n"
+         << "   <data key=\"assumption.scope\">main</data>\n"
+         << "   <data key=\"assumption.resultfunction\">"
+            "__VERIFIER_nondet_int</data>\n";
+      break;
+    default:
+      os << "   <data key=\"assumption\">x &gt;= 0 &amp;&amp; y &lt; "
+         << rng() % 100 << ";</data>\n";
+      break;
+    }
+    os << "  </edge>\n";
+    // skip the node entered through the sink
+    n = target - 1;
+  }
+  os << " </graph>\n</graphml>\n";
+}
+
+void run(const std::string &name) {
+  WitnessAutomaton witness;
+  size_t mallocBefore = util::GetTotalMallocUsage();
+  time::Point start = time::getWallTime();
+  witness.load(name.c_str());
+  time::Span first = time::getWallTime() - start;
+  size_t bytes = util::GetTotalMallocUsage() - mallocBefore;
+
+  time::Span total = first;
+  for (unsigned r = 1; r < Rounds; ++r) {
+    WitnessAutomaton again;
+    start = time::getWallTime();
+    again.load(name.c_str());
+    total += time::getWallTime() - start;
+  }
+
+  uint64_t fileSize = 0;
+  sys::fs::file_size(name, fileSize);
+  double seconds = total.toSeconds() / std::max(1u, unsigned(Rounds));
+  outs() << name << ": " << (fileSize >> 10) << " KiB, "
+         << witness.get_nodes_number() << " nodes\n";
+  outs() << "  load:   " << format("%.3f", seconds) << " s ("
+         << format("%.1f", fileSize / seconds / (1 << 20)) << " MiB/s)\n";
+  outs() << "  memory: " << (bytes >> 10) << " KiB allocated\n";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "Witness parser benchmark\n");
+
+  if (InputFiles.empty()) {
+    int fd;
+    SmallString<128> path;
+    if (std::error_code ec =
+            sys::fs::createTemporaryFile("witness", "graphml", fd, path)) {
+      errs() << "cannot create witness: " << ec.message() << "\n";
+      return 1;
+    }
+    {
+      raw_fd_ostream os(fd, /*shouldClose=*/true);
+      generate(os);
+    }
+    run(std::string(path.str()));
+    sys::fs::remove(path);
+  }
+
+  for (const std::string &file : InputFiles)
+    run(file);
+  return 0;
+}
@@ -0,0 +1,61 @@
+#!/usr/bin/env bash
+
+# ===-- compare-z3-incremental.sh ----------------------------------------===##
+#
+#                      The KLEE Symbolic Virtual Machine
+#
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+#
+# ===----------------------------------------------------------------------===##
+#
+# Compares the wall time kleaver needs to solve logged queries with a fresh
+# Z3 solver per query and with -z3-incremental.
+#
+# Usage: compare-z3-incremental.sh [-k kleaver] [-n runs] file.kquery...
+#
+# The query logs can be recorded by running klee with
+# --use-query-log=solver:kquery --solver-backend=z3; they are found in
+# solver-queries.kquery in the output directory.
+#
+# ===----------------------------------------------------------------------===##
+
+KLEAVER=kleaver
+RUNS=3
+
+while getopts "k:n:" opt; do
+	case $opt in
+		k) KLEAVER=$OPTARG ;;
+		n) RUNS=$OPTARG ;;
+		*) exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ -z "$1" ] ; then
+	echo "No query log given"
+	exit 1
+fi
+
+# prints the fastest wall time in seconds over $RUNS runs of kleaver
+best_time() {
+	local best=""
+	for i in `seq 1 $RUNS`; do
+		local start=`date +%s.%N`
+		"$KLEAVER" --solver-backend=z3 "$@" > /dev/null || return 1
+		local end=`date +%s.%N`
+		local t=`echo "$end - $start" | bc`
+		if [ -z "$best" ] || [ `echo "$t < $best" | bc` -eq 1 ]; then
+			best=$t
+		fi
+	done
+	echo $best
+}
+
+printf "%-40s %12s %12s %8s\n" "Query log" "Fresh(s)" "Incr.(s)" "Speedup"
+for f in "$@"; do
+	fresh=`best_time "$f"` || { echo "$f: kleaver failed"; exit 1; }
+	incr=`best_time -z3-incremental "$f"` || { echo "$f: kleaver failed"; exit 1; }
+	speedup=`echo "scale=2; $fresh / $incr" | bc`
+	printf "%-40s %12.3f %12.3f %7sx\n" "`basename $f`" $fresh $incr $speedup
+done
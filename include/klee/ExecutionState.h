@@ -229,13 +229,13 @@ public:
   std::uint64_t steppedInstructions;
 
   /// @brief Set of possible nodes
-  std::set<WitnessNode> witnessNode;
+  WitnessIndexSet witnessNode;
 
   /// @brief Set of next possible nodes
-  std::set<WitnessNode> witnessNodeNext;
+  WitnessIndexSet witnessNodeNext;
 
   /// @brief Edges with possible replay values
-  std::set<edge_ptr> replayEdges;
+  WitnessIndexSet replayEdges;
 
   NondetValue& addNondetValue(const KValue& val, bool isSigned, const std::string& name);
 
@@ -265,8 +265,10 @@ public:
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
 
-  void setNode(const WitnessNode &node) { witnessNode.clear(); witnessNode.insert(node); };
-  bool inViolationNode();
+  void setNode(unsigned node) { witnessNode.clear(); witnessNode.insert(node); };
+  bool inViolationNode(const WitnessAutomaton &witness);
+  /// Whether all the possible nodes are sinks.
+  bool inSinkNode(const WitnessAutomaton &witness) const;
 };
 }
 
@@ -0,0 +1,138 @@
+//===-- CompiledExpr.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COMPILEDEXPR_H
+#define KLEE_COMPILEDEXPR_H
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include "llvm/ADT/APInt.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+
+  /// CompiledExpr - An expression flattened into a straight-line program
+  /// over registers, for evaluating it under many assignments. Every node of
+  /// the expression DAG is computed once, in a 64-bit register if it and its
+  /// operands fit, and in an APInt register otherwise. Evaluation agrees with
+  /// Assignment::evaluate.
+  class CompiledExpr {
+    struct Instruction {
+      Expr::Kind kind;
+      Expr::Width width;
+      unsigned dst;
+      // operand registers, unused ones are 0
+      unsigned ops[3];
+      // for reads the range of their updates, for extracts the offset
+      unsigned extra[2];
+      // the array for reads, the expression node for wide instructions
+      const void *data;
+      bool wide;
+    };
+
+    // the update list of a read, from the most recent update
+    struct Update {
+      unsigned index;
+      unsigned value;
+    };
+
+    ref<Expr> root;
+    std::vector<Instruction> code;
+    std::vector<Update> updates;
+    // the width of each register
+    std::vector<Expr::Width> widths;
+    unsigned result;
+
+    // Registers of constants are set on compilation, as no instruction
+    // writes them. The wide registers are only allocated if needed.
+    mutable std::vector<uint64_t> registers;
+    mutable std::vector<llvm::APInt> wideRegisters;
+
+    unsigned compile(const ref<Expr> &e,
+                     std::unordered_map<const Expr *, unsigned> &regs);
+    unsigned addRegister(Expr::Width width);
+    bool run(const Assignment &a) const;
+    bool runWide(const Instruction &inst) const;
+    ref<ConstantExpr> getRegister(unsigned reg) const;
+
+  public:
+    explicit CompiledExpr(const ref<Expr> &e);
+
+    CompiledExpr(const CompiledExpr &) = delete;
+    CompiledExpr &operator=(const CompiledExpr &) = delete;
+
+    /// Evaluates the expression under \a a. Returns false if it divides by
+    /// zero, in which case Assignment::evaluate leaves the division
+    /// unevaluated.
+    bool evaluate(const Assignment &a, ref<ConstantExpr> &result) const;
+
+    /// Like evaluate, for boolean expressions.
+    bool isTrue(const Assignment &a, bool &result) const;
+
+    /// The number of instructions.
+    size_t size() const { return code.size(); }
+  };
+
+  /// CompiledExprCache - Compiles expressions on first use and memoizes
+  /// their values under each assignment they are evaluated with. Values are
+  /// dropped once their assignment is freed, and expressions once all their
+  /// values are, so the cache lives only as long as the assignments it was
+  /// used with.
+  class CompiledExprCache {
+    struct Entry {
+      std::unique_ptr<CompiledExpr> code;
+      std::unordered_map<const Assignment *,
+                         std::pair<std::weak_ptr<const Assignment>,
+                                   ref<ConstantExpr> > > values;
+      // the number of values at which the freed ones are swept
+      size_t sweepAt = 16;
+    };
+
+    std::unordered_map<ref<Expr>, Entry, util::ExprHash, util::ExprCmp>
+        entries;
+    // the number of entries at which the unused ones are swept
+    size_t sweepAt = 1024;
+
+    /// Drops the values of freed assignments, and the entries left without
+    /// values.
+    void sweep();
+
+  public:
+    CompiledExprCache() = default;
+    CompiledExprCache(const CompiledExprCache &) = delete;
+    CompiledExprCache &operator=(const CompiledExprCache &) = delete;
+
+    /// Evaluates \a e under \a a, falling back to Assignment::evaluate.
+    ref<Expr> evaluate(const ref<Expr> &e,
+                       const std::shared_ptr<const Assignment> &a);
+
+    template<typename InputIterator>
+    bool satisfies(InputIterator begin, InputIterator end,
+                   const std::shared_ptr<const Assignment> &a) {
+      for (; begin != end; ++begin)
+        if (!evaluate(*begin, a)->isTrue())
+          return false;
+      return true;
+    }
+
+    size_t size() const { return entries.size(); }
+    void clear() {
+      entries.clear();
+      sweepAt = 1024;
+    }
+  };
+}
+
+#endif /* KLEE_COMPILEDEXPR_H */
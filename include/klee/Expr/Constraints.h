@@ -12,6 +12,8 @@
 
 #include "klee/Expr/Expr.h"
 
+#include <memory>
+
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
 // move the first usage into a separate data structure
@@ -44,6 +46,13 @@ public:
 
   void addConstraint(ref<Expr> e);
 
+  /// Appends to \a result the constraints which \a e depends on, in the
+  /// order in which they were added. These are the constraints which
+  /// transitively read an array element that \a e reads, or any element of
+  /// an array that one of them reads at a symbolic index.
+  void getRelatedConstraints(ref<Expr> e,
+                             std::vector<ref<Expr>> &result) const;
+
   bool empty() const noexcept { return constraints.empty(); }
   ref<Expr> back() const { return constraints.back(); }
   const_iterator begin() const { return constraints.cbegin(); }
@@ -59,12 +68,21 @@ public:
   }
 
 private:
+  class Clusters;
+
   std::vector<ref<Expr>> constraints;
 
+  /// Union-find of the constraints by the array elements they read. It is
+  /// built on the first call to getRelatedConstraints, kept up to date as
+  /// constraints are added and shared copy-on-write between copies.
+  mutable std::shared_ptr<Clusters> clusters;
+
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
 
   void addConstraintInternal(ref<Expr> e);
+
+  void pushConstraint(ref<Expr> e);
 };
 
 } // namespace klee
@@ -0,0 +1,273 @@
+//===-- SetTrie.h -----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SETTRIE_H
+#define KLEE_SETTRIE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace klee {
+
+  /// Default element traits for SetTrie.
+  template<class K>
+  struct SetTrieInfo {
+    static unsigned getHash(const K &k) { return std::hash<K>()(k); }
+    static bool isEqual(const K &a, const K &b) { return a == b; }
+    static bool isLess(const K &a, const K &b) { return a < b; }
+  };
+
+  /** A map from sets to values which can be searched for subsets and
+      supersets of a set (see Hoffmann and Koehler, "A New Method to Index
+      and Query Sets", IJCAI 1999). Sets are stored as vectors sorted
+      by the hashes of their elements, and the trie branches on the hashes
+      only, so elements are only compared when a candidate set is checked.
+      Paths are shared between sets with a common prefix.
+
+      The number of entries can be bounded, in which case the least recently
+      used entries are evicted. */
+  template<class K, class V, class Info = SetTrieInfo<K> >
+  class SetTrie {
+  public:
+    typedef std::vector<K> key_ty;
+
+    /// Orders elements by hash first. Keys must be sorted by this order and
+    /// free of duplicates, see normalize().
+    struct ElementLess {
+      bool operator()(const K &a, const K &b) const {
+        unsigned ha = Info::getHash(a), hb = Info::getHash(b);
+        if (ha != hb)
+          return ha < hb;
+        return Info::isLess(a, b);
+      }
+    };
+
+    static void normalize(key_ty &key) {
+      std::sort(key.begin(), key.end(), ElementLess());
+      key.erase(std::unique(key.begin(), key.end(),
+                            [](const K &a, const K &b) {
+                              return Info::getHash(a) == Info::getHash(b) &&
+                                     Info::isEqual(a, b);
+                            }),
+                key.end());
+    }
+
+  private:
+    struct Node;
+
+    struct Entry {
+      key_ty key;
+      V value;
+      Node *node;
+
+      Entry(const key_ty &_key, const V &_value, Node *_node)
+        : key(_key), value(_value), node(_node) {}
+    };
+
+    typedef std::list<Entry> entries_ty;
+
+    struct Node {
+      Node *parent;
+      unsigned hash;
+      // sorted by hash
+      std::vector<std::unique_ptr<Node> > children;
+      std::vector<typename entries_ty::iterator> entries;
+
+      Node(Node *_parent, unsigned _hash) : parent(_parent), hash(_hash) {}
+
+      typename std::vector<std::unique_ptr<Node> >::iterator
+      lowerBound(unsigned h) {
+        return std::lower_bound(children.begin(), children.end(), h,
+                                [](const std::unique_ptr<Node> &n,
+                                   unsigned h) { return n->hash < h; });
+      }
+    };
+
+    Node root;
+    // least recently used first
+    entries_ty entries;
+    size_t maxSize;
+
+    static std::vector<unsigned> getHashes(const key_ty &key) {
+      std::vector<unsigned> hashes;
+      hashes.reserve(key.size());
+      for (const K &k : key)
+        hashes.push_back(Info::getHash(k));
+      return hashes;
+    }
+
+    static bool isEqual(const key_ty &a, const key_ty &b) {
+      return a.size() == b.size() &&
+             std::equal(a.begin(), a.end(), b.begin(), Info::isEqual);
+    }
+
+    static bool includes(const key_ty &a, const key_ty &b) {
+      return a.size() >= b.size() &&
+             std::includes(a.begin(), a.end(), b.begin(), b.end(),
+                           ElementLess());
+    }
+
+    V *use(typename entries_ty::iterator it) {
+      entries.splice(entries.end(), entries, it);
+      return &it->value;
+    }
+
+    void erase(typename entries_ty::iterator it) {
+      Node *n = it->node;
+      n->entries.erase(std::find(n->entries.begin(), n->entries.end(), it));
+      entries.erase(it);
+      while (n != &root && n->entries.empty() && n->children.empty()) {
+        Node *parent = n->parent;
+        parent->children.erase(parent->lowerBound(n->hash));
+        n = parent;
+      }
+    }
+
+    template<class Predicate>
+    V *findSubset(Node *n, const std::vector<unsigned> &hashes, size_t i,
+                  const key_ty &key, Predicate &p) {
+      for (auto it : n->entries)
+        if (includes(key, it->key) && p(it->key, it->value))
+          return use(it);
+
+      auto cit = n->children.begin(), cie = n->children.end();
+      while (i < hashes.size() && cit != cie) {
+        unsigned h = (*cit)->hash;
+        if (h < hashes[i]) {
+          cit = n->lowerBound(hashes[i]);
+        } else if (hashes[i] < h) {
+          ++i;
+        } else {
+          if (V *res = findSubset(cit->get(), hashes, i + 1, key, p))
+            return res;
+          ++cit;
+        }
+      }
+      return 0;
+    }
+
+    template<class Predicate>
+    V *findSuperset(Node *n, const std::vector<unsigned> &hashes, size_t i,
+                    const key_ty &key, Predicate &p) {
+      if (i == hashes.size()) {
+        for (auto it : n->entries)
+          if (includes(it->key, key) && p(it->key, it->value))
+            return use(it);
+      }
+
+      for (auto &child : n->children) {
+        if (i == hashes.size() || child->hash < hashes[i]) {
+          if (V *res = findSuperset(child.get(), hashes, i, key, p))
+            return res;
+        } else if (child->hash == hashes[i]) {
+          return findSuperset(child.get(), hashes, i + 1, key, p);
+        } else {
+          break;
+        }
+      }
+      return 0;
+    }
+
+  public:
+    SetTrie() : root(0, 0), maxSize(0) {}
+    SetTrie(const SetTrie &) = delete;
+    SetTrie &operator=(const SetTrie &) = delete;
+
+    /// Bounds the number of entries, 0 meaning unbounded.
+    void setMaxSize(size_t size) {
+      maxSize = size;
+      while (maxSize && entries.size() > maxSize)
+        erase(entries.begin());
+    }
+
+    size_t size() const { return entries.size(); }
+
+    void clear() {
+      entries.clear();
+      root.children.clear();
+      root.entries.clear();
+    }
+
+    /// Maps the normalized \a key to \a value. Returns the number of entries
+    /// which were evicted to make room for it.
+    size_t insert(const key_ty &key, const V &value) {
+      Node *n = &root;
+      for (const K &k : key) {
+        unsigned h = Info::getHash(k);
+        auto cit = n->lowerBound(h);
+        if (cit == n->children.end() || (*cit)->hash != h)
+          cit = n->children.emplace(cit, new Node(n, h));
+        n = cit->get();
+      }
+
+      for (auto it : n->entries) {
+        if (isEqual(it->key, key)) {
+          it->value = value;
+          use(it);
+          return 0;
+        }
+      }
+      n->entries.push_back(entries.emplace(entries.end(), key, value, n));
+
+      size_t evicted = 0;
+      for (; maxSize && entries.size() > maxSize; ++evicted)
+        erase(entries.begin());
+      return evicted;
+    }
+
+    /// Returns the value mapped to the normalized \a key, or null.
+    V *lookup(const key_ty &key) {
+      Node *n = &root;
+      for (const K &k : key) {
+        unsigned h = Info::getHash(k);
+        auto cit = n->lowerBound(h);
+        if (cit == n->children.end() || (*cit)->hash != h)
+          return 0;
+        n = cit->get();
+      }
+      for (auto it : n->entries)
+        if (isEqual(it->key, key))
+          return use(it);
+      return 0;
+    }
+
+    /// Returns the value of some subset of the normalized \a key for which
+    /// p(subset, value) holds, or null.
+    template<class Predicate>
+    V *findSubset(const key_ty &key, Predicate p) {
+      return findSubset(&root, getHashes(key), 0, key, p);
+    }
+
+    /// Returns the value of some superset of the normalized \a key for which
+    /// p(superset, value) holds, or null.
+    template<class Predicate>
+    V *findSuperset(const key_ty &key, Predicate p) {
+      return findSuperset(&root, getHashes(key), 0, key, p);
+    }
+
+    /// Returns the value of the most recently used entry for which
+    /// p(key, value) holds, or null.
+    template<class Predicate>
+    V *findRecent(Predicate p) {
+      for (auto it = entries.end(); it != entries.begin();) {
+        --it;
+        if (p(it->key, it->value))
+          return use(it);
+      }
+      return 0;
+    }
+  };
+
+}
+
+#endif /* KLEE_SETTRIE_H */
@@ -41,6 +41,10 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// Whether the instruction can match an edge of the witness, or is a
+    /// call which may take its return value from one. Others are skipped
+    /// by the witness automaton.
+    bool witnessRelevant = false;
 
   public:
     virtual ~KInstruction();
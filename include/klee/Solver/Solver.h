@@ -15,6 +15,7 @@
 #include "klee/Solver/SolverCmdLine.h"
 #include "klee/Expr/Assignment.h"
 
+#include <functional>
 #include <vector>
 
 namespace klee {
@@ -229,6 +230,16 @@ namespace klee {
   /// \param s - The underlying solver to use.
   Solver *createCexCachingSolver(Solver *s);
 
+  /// createPersistentCachingSolver - Create a solver which caches query
+  /// results in a memory-mapped file, so that they can be reused by later
+  /// runs and by other processes using the same file.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The cache file, created if it does not exist.
+  /// \param size - The size in bytes of a newly created cache file.
+  Solver *createPersistentCachingSolver(Solver *s, std::string path,
+                                        uint64_t size);
+
   /// createFastCexSolver - Create a "fast counterexample solver", which tries
   /// to quickly compute a satisfying assignment for a constraint set using
   /// value propogation and range analysis.
@@ -256,10 +267,32 @@ namespace klee {
                                     bool logTimedOut);
 
 
+  /// createQueryProfilingSolver - Create a solver which aggregates the number
+  /// and time of queries by issuing location and query shape. On destruction
+  /// it writes a report ranking them by time to the given path, and the
+  /// slowest queries in .kquery format to \a queryPathPrefix followed by
+  /// their rank.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param numHotQueries - The number of slowest queries to write.
+  /// \param getLocationName - Names the locations, which are the indices of
+  /// the statistic manager when the queries are issued.
+  Solver *createQueryProfilingSolver(
+      Solver *s, std::string reportPath, std::string queryPathPrefix,
+      unsigned numHotQueries,
+      std::function<std::string(unsigned)> getLocationName);
+
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   Solver *createDummySolver();
 
+  /// createPortfolioSolver - Create a solver which runs each query on all of
+  /// the given core solvers in forked workers and takes the first answer.
+  /// Once a solver wins most races on queries of some shape, it is run alone
+  /// for later queries of that shape.
+  Solver *createPortfolioSolver(
+      const std::vector<std::pair<CoreSolverType, Solver *>> &solvers);
+
   // Create a solver based on the supplied ``CoreSolverType``.
   Solver *createCoreSolver(CoreSolverType cst);
 }
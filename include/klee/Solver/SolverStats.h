@@ -15,17 +15,28 @@
 namespace klee {
 namespace stats {
 
+  extern Statistic cexCacheLookupTime;
   extern Statistic cexCacheTime;
+  extern Statistic portfolioDummyWins;
+  extern Statistic portfolioMetaSMTWins;
+  extern Statistic portfolioRaces;
+  extern Statistic portfolioShortcuts;
+  extern Statistic portfolioSTPWins;
+  extern Statistic portfolioZ3Wins;
   extern Statistic queries;
   extern Statistic queriesInvalid;
   extern Statistic queriesValid;
   extern Statistic queryCacheHits;
   extern Statistic queryCacheMisses;
+  extern Statistic queryCexCacheEvictions;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
   extern Statistic queryConstructTime;
   extern Statistic queryConstructs;
+  extern Statistic queryConstraintsReused;
   extern Statistic queryCounterexamples;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPersistentCacheMisses;
   extern Statistic queryTime;
   
 #ifdef KLEE_ARRAY_DEBUG
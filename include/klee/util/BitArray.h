@@ -10,53 +10,140 @@
 #ifndef KLEE_BITARRAY_H
 #define KLEE_BITARRAY_H
 
+#include "klee/util/ChunkedArray.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <cstdint>
+
 namespace klee {
 
-  // XXX would be nice not to have
-  // two allocations here for allocated
-  // BitArrays
+/// An array of bits. The underlying words are kept in a ChunkedArray, so
+/// copies of a BitArray share their storage until one of them is modified.
+/// Range operations work a 64-bit word at a time.
 class BitArray {
 private:
-  uint32_t *bits;
+  typedef uint64_t Word;
+  static const unsigned WordBits = 64;
+
+  ChunkedArray<Word, 64> bits;
   unsigned _size;
   
 protected:
-  static uint32_t length(unsigned size) { return (size+31)/32; }
+  static uint32_t length(unsigned size) { return (size+WordBits-1)/WordBits; }
 
-public:
-  BitArray() : bits(0), _size(0) {}
-  explicit BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]), _size(size) {
-    memset(bits, value?0xFF:0, sizeof(*bits)*length(size));
+private:
+  // mask of the bits in [begin, end) of a single word, 0 <= begin < end <= 64
+  static Word mask(unsigned begin, unsigned end) {
+    Word high = end == WordBits ? ~Word(0) : (Word(1) << end) - 1;
+    return high & ~((Word(1) << begin) - 1);
   }
-  BitArray(const BitArray &b)
-  : bits(b.bits ? new uint32_t[length(b._size)] : 0),
-    _size(b._size) {
-    if (b.bits)
-      memcpy(bits, b.bits, sizeof(*bits)*length(_size));
+
+  // index of the first bit in [begin, end) for which the bit XOR flip is
+  // set, end if there is none; only the words overlapping the range are read
+  unsigned findFirst(unsigned begin, unsigned end, Word flip) const {
+    if (begin >= end)
+      return end;
+    unsigned first = begin / WordBits, last = (end - 1) / WordBits;
+    for (unsigned w = first; w <= last; ++w) {
+      Word word = bits[w] ^ flip;
+      if (w == first)
+        word &= mask(begin % WordBits, WordBits);
+      if (w == last)
+        word &= mask(0, end - last * WordBits);
+      if (word)
+        return w * WordBits + llvm::countTrailingZeros(word);
+    }
+    return end;
   }
-  ~BitArray() { delete[] bits; }
+
+public:
+  BitArray() : _size(0) {}
+  explicit BitArray(unsigned size, bool value = false)
+    : bits(length(size), value ? ~Word(0) : 0), _size(size) {}
 
   unsigned size() const {
     return _size;
   }
 
   void resize(unsigned newSize, bool value = false) {
-    uint32_t *oldBits = bits;
-    if (newSize)
-      bits = new uint32_t[length(newSize)];
-    if (oldBits) {
-      memcpy(bits, oldBits, sizeof(*bits)*length(std::min(_size, newSize)));
-      delete[] oldBits;
-    }
-    for (unsigned i = _size; i < newSize; i++)
-      set(i, value);
+    unsigned oldSize = std::min(_size, newSize);
+    bits.resize(length(newSize), value ? ~Word(0) : 0);
     _size = newSize;
+    // the bits past the old size in its last word are stale
+    if (oldSize % WordBits && oldSize < newSize)
+      setRange(oldSize, std::min(newSize, (oldSize / WordBits + 1) * WordBits),
+               value);
   }
 
-  bool get(unsigned idx) const { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
-  void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
-  void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
+  bool get(unsigned idx) const { return (bool) ((bits[idx/WordBits]>>(idx%WordBits))&1); }
+  void set(unsigned idx) { bits.getWriteable(idx/WordBits) |= Word(1)<<(idx%WordBits); }
+  void unset(unsigned idx) { bits.getWriteable(idx/WordBits) &= ~(Word(1)<<(idx%WordBits)); }
   void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
+
+  /// Sets the bits in [begin, end) to \a value.
+  void setRange(unsigned begin, unsigned end, bool value) {
+    assert(begin <= end && end <= _size && "range out of bounds");
+    if (begin == end)
+      return;
+    unsigned first = begin / WordBits, last = (end - 1) / WordBits;
+    if (first == last) {
+      Word m = mask(begin % WordBits, end - first * WordBits);
+      Word &word = bits.getWriteable(first);
+      word = value ? (word | m) : (word & ~m);
+      return;
+    }
+    if (begin % WordBits) {
+      Word m = mask(begin % WordBits, WordBits);
+      Word &word = bits.getWriteable(first);
+      word = value ? (word | m) : (word & ~m);
+      ++first;
+    }
+    if (end % WordBits) {
+      Word m = mask(0, end % WordBits);
+      Word &word = bits.getWriteable(last);
+      word = value ? (word | m) : (word & ~m);
+    } else {
+      ++last;
+    }
+    bits.fill(first, last, value ? ~Word(0) : 0);
+  }
+
+  /// Returns whether all bits in [begin, end) are set.
+  bool allSet(unsigned begin, unsigned end) const {
+    assert(begin <= end && end <= _size && "range out of bounds");
+    return findFirst(begin, end, ~Word(0)) == end;
+  }
+
+  /// Returns whether no bit in [begin, end) is set.
+  bool noneSet(unsigned begin, unsigned end) const {
+    assert(begin <= end && end <= _size && "range out of bounds");
+    return findFirst(begin, end, 0) == end;
+  }
+
+  /// Returns the index of the first set bit at or after \a begin, size()
+  /// if there is none.
+  unsigned findFirstSet(unsigned begin = 0) const {
+    return findFirst(begin, _size, 0);
+  }
+
+  /// Returns the index of the first unset bit at or after \a begin, size()
+  /// if there is none.
+  unsigned findFirstUnset(unsigned begin = 0) const {
+    return findFirst(begin, _size, ~Word(0));
+  }
+
+  /// Returns the number of set bits.
+  unsigned count() const {
+    unsigned result = 0;
+    for (unsigned w = 0, e = length(_size); w < e; ++w) {
+      Word word = bits[w];
+      if (w == e - 1 && _size % WordBits)
+        word &= mask(0, _size % WordBits);
+      result += llvm::countPopulation(word);
+    }
+    return result;
+  }
 };
 
 } // End klee namespace
@@ -0,0 +1,253 @@
+//===-- ChunkedArray.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHUNKEDARRAY_H
+#define KLEE_CHUNKEDARRAY_H
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace klee {
+
+/// An array split into fixed-size chunks that are shared between copies of
+/// the array. A chunk is cloned only on the first write into it after a
+/// copy, so copying an array costs O(size / ChunkSize) instead of O(size),
+/// and writing into a copy costs at most one chunk.
+///
+/// Chunks that were never written to are not allocated at all; their
+/// elements read as the value the array was filled with when they were
+/// added. The last chunk holds only the elements up to the size of the
+/// array, and a chunk is a single allocation, so an array smaller than a
+/// chunk costs about as much as a flat buffer.
+template <typename T, size_t ChunkSize = 4096> class ChunkedArray {
+  static_assert(std::is_trivial<T>::value,
+                "chunk elements are not constructed or destroyed");
+
+  /// A reference counted header followed by the elements of the chunk.
+  struct Chunk {
+    size_t refCount;
+    size_t length;
+
+    T *elements() { return reinterpret_cast<T *>(this + 1); }
+    const T *elements() const { return reinterpret_cast<const T *>(this + 1); }
+
+    static Chunk *create(size_t length) {
+      Chunk *chunk = static_cast<Chunk *>(
+          ::operator new(sizeof(Chunk) + length * sizeof(T)));
+      chunk->refCount = 1;
+      chunk->length = length;
+      return chunk;
+    }
+
+    static void release(Chunk *chunk) {
+      if (chunk && --chunk->refCount == 0)
+        ::operator delete(chunk);
+    }
+  };
+
+  // most objects fit in one chunk, whose pointer is then kept inline
+  llvm::SmallVector<Chunk *, 1> chunks;
+  size_t _size;
+  T fillValue;
+
+  static size_t numChunks(size_t size) {
+    return (size + ChunkSize - 1) / ChunkSize;
+  }
+
+  // the number of elements of chunk c
+  size_t chunkLength(size_t c) const {
+    return std::min(ChunkSize, _size - c * ChunkSize);
+  }
+
+  void setNumChunks(size_t n) {
+    for (size_t c = n; c < chunks.size(); ++c)
+      Chunk::release(chunks[c]);
+    chunks.resize(n, nullptr);
+  }
+
+  T *getWriteableChunk(size_t c) {
+    Chunk *&chunk = chunks[c];
+    if (!chunk) {
+      chunk = Chunk::create(chunkLength(c));
+      std::fill_n(chunk->elements(), chunk->length, fillValue);
+    } else if (chunk->refCount > 1) {
+      Chunk *copy = Chunk::create(chunk->length);
+      std::copy_n(chunk->elements(), chunk->length, copy->elements());
+      --chunk->refCount;
+      chunk = copy;
+    }
+    return chunk->elements();
+  }
+
+public:
+  ChunkedArray() : _size(0), fillValue() {}
+  explicit ChunkedArray(size_t size, const T &value = T())
+      : chunks(numChunks(size), nullptr), _size(size), fillValue(value) {}
+
+  ChunkedArray(const ChunkedArray &other)
+      : chunks(other.chunks), _size(other._size),
+        fillValue(other.fillValue) {
+    for (Chunk *chunk : chunks)
+      if (chunk)
+        ++chunk->refCount;
+  }
+
+  ChunkedArray(ChunkedArray &&other)
+      : chunks(std::move(other.chunks)), _size(other._size),
+        fillValue(other.fillValue) {
+    other.chunks.clear();
+    other._size = 0;
+  }
+
+  ChunkedArray &operator=(ChunkedArray other) {
+    std::swap(chunks, other.chunks);
+    std::swap(_size, other._size);
+    std::swap(fillValue, other.fillValue);
+    return *this;
+  }
+
+  ~ChunkedArray() { setNumChunks(0); }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+
+  const T &get(size_t idx) const {
+    assert(idx < _size && "index out of bounds");
+    const Chunk *chunk = chunks[idx / ChunkSize];
+    return chunk ? chunk->elements()[idx % ChunkSize] : fillValue;
+  }
+
+  const T &operator[](size_t idx) const { return get(idx); }
+
+  /// Returns a reference to the element which may be modified, the
+  /// chunk holding it is cloned if it is shared.
+  T &getWriteable(size_t idx) {
+    assert(idx < _size && "index out of bounds");
+    return getWriteableChunk(idx / ChunkSize)[idx % ChunkSize];
+  }
+
+  void set(size_t idx, const T &value) { getWriteable(idx) = value; }
+
+  /// Resizes the array, the added elements are set to \a value.
+  void resize(size_t newSize, const T &value = T()) {
+    if (newSize > _size) {
+      size_t oldChunks = numChunks(_size);
+      if (!(value == fillValue)) {
+        // untouched chunks read as the fill value, so materialize the old
+        // ones before the fill value changes
+        for (size_t c = 0; c < oldChunks; ++c)
+          if (!chunks[c])
+            getWriteableChunk(c);
+      }
+      // the last chunk grows up to the new size, the rest of it may
+      // contain stale elements
+      size_t c = _size / ChunkSize;
+      if (_size % ChunkSize && chunks[c]) {
+        size_t end = std::min(newSize, (c + 1) * ChunkSize) - c * ChunkSize;
+        T *elements = getWriteableChunk(c);
+        if (chunks[c]->length < end) {
+          Chunk *grown = Chunk::create(end);
+          std::copy_n(elements, chunks[c]->length, grown->elements());
+          Chunk::release(chunks[c]);
+          chunks[c] = grown;
+          elements = grown->elements();
+        }
+        std::fill(elements + _size % ChunkSize, elements + end, value);
+      }
+      fillValue = value;
+    }
+    setNumChunks(numChunks(newSize));
+    _size = newSize;
+  }
+
+  void clear() {
+    setNumChunks(0);
+    _size = 0;
+  }
+
+  /// Sets the elements in [begin, end) to \a value. Whole chunks set to
+  /// the fill value are released instead of being written.
+  void fill(size_t begin, size_t end, const T &value) {
+    assert(begin <= end && end <= _size && "range out of bounds");
+    while (begin < end) {
+      size_t c = begin / ChunkSize;
+      size_t offset = begin % ChunkSize;
+      size_t len = std::min(end - begin, ChunkSize - offset);
+      if (len == chunkLength(c) && value == fillValue) {
+        Chunk::release(chunks[c]);
+        chunks[c] = nullptr;
+      } else {
+        T *elements = getWriteableChunk(c);
+        std::fill(elements + offset, elements + offset + len, value);
+      }
+      begin += len;
+    }
+  }
+
+  /// Copies \a n elements starting at \a begin into \a dst.
+  void copyTo(size_t begin, size_t n, T *dst) const {
+    assert(begin + n <= _size && "range out of bounds");
+    while (n) {
+      size_t offset = begin % ChunkSize;
+      size_t len = std::min(n, ChunkSize - offset);
+      if (const Chunk *chunk = chunks[begin / ChunkSize])
+        std::copy_n(chunk->elements() + offset, len, dst);
+      else
+        std::fill(dst, dst + len, fillValue);
+      begin += len;
+      dst += len;
+      n -= len;
+    }
+  }
+
+  /// Overwrites \a n elements starting at \a begin with the ones at \a src.
+  void copyFrom(size_t begin, size_t n, const T *src) {
+    assert(begin + n <= _size && "range out of bounds");
+    while (n) {
+      size_t offset = begin % ChunkSize;
+      size_t len = std::min(n, ChunkSize - offset);
+      T *elements = getWriteableChunk(begin / ChunkSize);
+      std::copy(src, src + len, elements + offset);
+      begin += len;
+      src += len;
+      n -= len;
+    }
+  }
+
+  /// Checks whether \a n elements starting at \a begin are equal to the
+  /// ones at \a src.
+  bool equals(size_t begin, size_t n, const T *src) const {
+    assert(begin + n <= _size && "range out of bounds");
+    while (n) {
+      size_t offset = begin % ChunkSize;
+      size_t len = std::min(n, ChunkSize - offset);
+      if (const Chunk *chunk = chunks[begin / ChunkSize]) {
+        if (!std::equal(src, src + len, chunk->elements() + offset))
+          return false;
+      } else if (!std::all_of(src, src + len,
+                              [this](const T &v) { return v == fillValue; })) {
+        return false;
+      }
+      begin += len;
+      src += len;
+      n -= len;
+    }
+    return true;
+  }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_CHUNKEDARRAY_H */
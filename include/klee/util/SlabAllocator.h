@@ -0,0 +1,93 @@
+//===-- SlabAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SLABALLOCATOR_H
+#define KLEE_SLABALLOCATOR_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace klee {
+
+/// Allocates objects of a single size class out of large slabs. Freed
+/// objects are kept on a free list and handed out again by later
+/// allocations, so the slabs are returned to the system only when the
+/// allocator itself is destroyed.
+class SlabAllocator {
+  struct FreeObject {
+    FreeObject *next;
+  };
+
+  size_t objectSize;
+  size_t slabSize;
+
+  std::vector<std::unique_ptr<char[]>> slabs;
+  FreeObject *freeList = nullptr;
+  // unused tail of the newest slab
+  char *next = nullptr;
+  char *end = nullptr;
+
+  size_t liveObjects = 0;
+
+  static size_t roundUp(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+public:
+  explicit SlabAllocator(size_t size, size_t slabSize = 64 * 1024)
+      : objectSize(roundUp(std::max(size, sizeof(FreeObject)),
+                           alignof(std::max_align_t))),
+        slabSize(std::max(slabSize, objectSize)) {}
+
+  SlabAllocator(const SlabAllocator &) = delete;
+  SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+  void *allocate() {
+    ++liveObjects;
+    if (freeList) {
+      void *result = freeList;
+      freeList = freeList->next;
+      return result;
+    }
+    if (next == end) {
+      slabs.emplace_back(new char[slabSize]);
+      next = slabs.back().get();
+      end = next + slabSize / objectSize * objectSize;
+    }
+    void *result = next;
+    next += objectSize;
+    return result;
+  }
+
+  void deallocate(void *ptr) {
+    if (!ptr)
+      return;
+    assert(liveObjects > 0 && "deallocating more objects than allocated");
+    --liveObjects;
+    FreeObject *object = static_cast<FreeObject *>(ptr);
+    object->next = freeList;
+    freeList = object;
+  }
+
+  /// Returns the size of the objects handed out by this allocator.
+  size_t getObjectSize() const { return objectSize; }
+
+  /// Returns the number of allocated objects that were not freed yet.
+  size_t getLiveObjects() const { return liveObjects; }
+
+  /// Returns the number of bytes reserved in slabs.
+  size_t getReservedSize() const { return slabs.size() * slabSize; }
+};
+
+} // End klee namespace
+
+#endif /* KLEE_SLABALLOCATOR_H */
@@ -1,6 +1,8 @@
 #ifndef WITNESSPARSER_H
 #define WITNESSPARSER_H
 
+#include <algorithm>
+#include <iterator>
 #include <vector>
 #include <string>
 #include <map>
@@ -8,9 +10,6 @@
 #include <set>
 #include <tuple>
 
-
-#include "../../../rapidxml-1.13/rapidxml.hpp"
-
 enum WitnessSpec {
     valid_free,
     valid_deref,
@@ -21,45 +20,93 @@ enum WitnessSpec {
     unreach_call
 };
 
-struct WitnessNode;
-struct WitnessEdge;
-using node_ptr = std::shared_ptr<WitnessNode>;
-using edge_ptr = std::shared_ptr<WitnessEdge>;
-
+/// A node of the automaton. Its outgoing edges are the range
+/// [edges_begin, replay_begin) of the edges of the automaton, followed by
+/// the edges providing return values of __VERIFIER_nondet functions in
+/// [replay_begin, edges_end).
 struct WitnessNode {
     std::string id;
-    std::set<edge_ptr> edges;
-    std::set<edge_ptr> replayEdges;
-
-    //std::set<edge_ptr> edges_in;
-    bool entry;
-    bool sink;
-    bool violation;
+    unsigned edges_begin = 0;
+    unsigned replay_begin = 0;
+    unsigned edges_end = 0;
 
-    bool operator <(const WitnessNode &b) const {return id < b.id ;};
-    bool operator >(const WitnessNode &b) const {return id > b.id ;};
+    bool entry = false;
+    bool sink = false;
+    bool violation = false;
 
     //string invariant?
     //string inv scope
 };
 
 struct WitnessEdge {
-    std::weak_ptr<WitnessNode> source;
-    std::weak_ptr<WitnessNode> target;
+    unsigned source = 0;
+    unsigned target = 0;
     std::string assumption;
     std::string assumScope;
     std::string assumResFunc;
     int result_index = -1;
     std::string control;
-    long startline;
-    long endline;
-    long startoffset;
-    long endoffset;
-    bool enterLoop;
+    long startline = 0;
+    long endline = 0;
+    long startoffset = 0;
+    long endoffset = 0;
+    bool enterLoop = false;
     std::string enterFunc;
     std::string retFromFunc;
+
+    bool is_replay() const {
+        return assumResFunc.compare(0, 17, "__VERIFIER_nondet") == 0;
+    }
 };
 
+/// A set of node or edge indices of an automaton, kept as a sorted vector.
+/// States track few nodes at a time, so this is cheaper to copy on forks
+/// and to search than a tree of nodes.
+class WitnessIndexSet {
+    std::vector<unsigned> elements;
+
+public:
+    typedef std::vector<unsigned>::const_iterator const_iterator;
+
+    const_iterator begin() const { return elements.begin(); }
+    const_iterator end() const { return elements.end(); }
+    size_t size() const { return elements.size(); }
+    bool empty() const { return elements.empty(); }
+
+    bool contains(unsigned i) const {
+        return std::binary_search(elements.begin(), elements.end(), i);
+    }
+
+    void insert(unsigned i) {
+        auto it = std::lower_bound(elements.begin(), elements.end(), i);
+        if (it == elements.end() || *it != i)
+            elements.insert(it, i);
+    }
+
+    void insert(const WitnessIndexSet &other) {
+        if (other.empty())
+            return;
+        if (elements.empty()) {
+            elements = other.elements;
+            return;
+        }
+        std::vector<unsigned> merged;
+        merged.reserve(elements.size() + other.elements.size());
+        std::set_union(elements.begin(), elements.end(),
+                       other.elements.begin(), other.elements.end(),
+                       std::back_inserter(merged));
+        elements.swap(merged);
+    }
+
+    void erase(unsigned i) {
+        auto it = std::lower_bound(elements.begin(), elements.end(), i);
+        if (it != elements.end() && *it == i)
+            elements.erase(it);
+    }
+
+    void clear() { elements.clear(); }
+    void swap(WitnessIndexSet &other) { elements.swap(other.elements); }
+};
 
 struct WitnessData {
     std::string type;
@@ -73,19 +120,23 @@ struct WitnessData {
     std::string time;
 };
 
+/// The automaton of a witness. load reads the GraphML document in a single
+/// pass over the mapped file, without building a document tree, and
+/// compiles it into arrays of nodes and edges, which are referred to by
+/// their indices and do not change afterwards.
 class WitnessAutomaton {
     WitnessData data;
-    std::map<std::string, node_ptr> nodes;
-    std::set<edge_ptr> edges;
-    node_ptr entry;
-    std::set<node_ptr> violation;
-
-    void fill_edges(rapidxml::xml_node<>* root);
-    void fill_data(rapidxml::xml_node<>* root);
-    void fill_nodes(rapidxml::xml_node<>* node);
-    void fill_node_data (rapidxml::xml_node<>* xml_node, node_ptr node);
-    void fill_edge_data (rapidxml::xml_node<>* xml_node, edge_ptr edge);
+    std::vector<WitnessNode> nodes;
+    std::vector<WitnessEdge> edges;
+    unsigned entry;
+
+    void fill_data(const std::string& key, const std::string& value);
+    void fill_node_data(const std::string& key, const std::string& value,
+                        WitnessNode& node);
+    void fill_edge_data(const std::string& key, const std::string& value,
+                        WitnessEdge& edge);
     void load_spec(const std::string& str);
+    void compile_edges();
 
 
 
@@ -94,15 +145,18 @@ public:
     std::vector<klee::ConcreteValue> replay_nondets;
     void load (const char* filename);
     std::set<WitnessSpec> get_spec() { return data.spec; }
-    WitnessNode get_entry() { return *entry; }
+    unsigned get_entry() const { return entry; }
+    const WitnessNode& get_node(unsigned node) const { return nodes[node]; }
+    const WitnessEdge& get_edge(unsigned edge) const { return edges[edge]; }
     std::string get_err_function() { return data.err_function; }
     bool get_spec(WitnessSpec s);
-    size_t get_nodes_number(){ return nodes.size(); }
+    size_t get_nodes_number() const { return nodes.size(); }
+    size_t get_edges_number() const { return edges.size(); }
 };
 
 klee::ConcreteValue create_concrete_v(std::string function, std::string val, bool& ok);
 std::string parseAssumption(std::string assumption, bool& refute);
-std::pair<bool, klee::ConcreteValue> fill_replay(WitnessEdge e);
+std::pair<bool, klee::ConcreteValue> fill_replay(const WitnessEdge& e);
 
 
 
@@ -16,6 +16,8 @@
 #include "klee/TimerStatIncrementer.h"
 #include "klee/KValue.h"
 
+#include <tuple>
+
 using namespace klee;
 
 ///
@@ -56,15 +58,7 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
 }
 
 bool AddressSpace::resolveInConcreteMap(const uint64_t& segment, uint64_t &address) const {
-  auto found = std::find_if(concreteAddressMap.begin(),concreteAddressMap.end(),
-                            [segment](std::pair<const uint64_t&, const uint64_t&> value) {
-                              return value.second == segment;
-                            });
-  if (found != concreteAddressMap.end()) {
-    address = found->first;
-    return true;
-  }
-  return false;
+  return concreteAddressMap.lookupSegment(segment, address);
 }
 
 bool AddressSpace::resolveOneConstantSegment(const KValue &pointer,
@@ -191,19 +185,99 @@ bool AddressSpace::resolve(ExecutionState &state,
                                           KValue(zeroSegment, pointer.getValue()),
                                           rl, maxResolutions, timeout))
     return true;
-  // TODO inefficient
+  return resolveSymbolicSegment(state, solver, pointer.getSegment(), rl,
+                                maxResolutions, timeout);
+}
+
+bool AddressSpace::resolveSymbolicSegment(ExecutionState &state,
+                                          TimingSolver *solver,
+                                          const ref<Expr> &segment,
+                                          ResolutionList &rl,
+                                          unsigned maxResolutions,
+                                          time::Span timeout) const {
   TimerStatIncrementer timer(stats::resolveTime);
-  for (const SegmentMap::value_type &res : segmentMap) {
-    if (timeout && timeout < timer.delta())
-      return true;
-    ref<Expr> segmentExpr = ConstantExpr::create(res.first, pointer.getWidth());
-    ref<Expr> expr = EqExpr::create(pointer.getSegment(), segmentExpr);
-    if (!solver->mayBeTrue(state, expr, mayBeTrue))
-      return true;
-    if (mayBeTrue)
-      rl.push_back(*objects.lookup(res.second));
+
+  // segmentMap is ordered, so the live segments come out sorted
+  std::vector<uint64_t> segments;
+  segments.reserve(segmentMap.size());
+  for (const SegmentMap::value_type &res : segmentMap)
+    segments.push_back(res.first);
+
+  uint64_t issued = 0;
+  bool incomplete = false;
+  // the caller may pass a list which already holds resolutions
+  size_t initialSize = rl.size();
+
+  // Ranges [lo, hi) of live segments that still may contain the
+  // segment. A range is refined only if the solver cannot rule it out,
+  // so a segment with k feasible values costs O(k log n) queries
+  // instead of one query per live object.
+  std::vector<std::pair<size_t, size_t>> worklist;
+  if (!segments.empty())
+    worklist.emplace_back(0, segments.size());
+
+  while (!worklist.empty()) {
+    size_t lo, hi;
+    std::tie(lo, hi) = worklist.back();
+    worklist.pop_back();
+
+    if (timeout && timeout < timer.delta()) {
+      incomplete = true;
+      break;
+    }
+
+    // checking the segments one by one is not more expensive
+    // than asking for the whole range first
+    if (hi - lo <= 2) {
+      for (size_t i = lo; i < hi; ++i) {
+        ref<Expr> segmentExpr =
+            ConstantExpr::create(segments[i], segment->getWidth());
+        bool mayBeTrue;
+        ++issued;
+        if (!solver->mayBeTrue(state, EqExpr::create(segment, segmentExpr),
+                               mayBeTrue)) {
+          incomplete = true;
+          break;
+        }
+        if (mayBeTrue) {
+          rl.push_back(*objects.lookup(segmentMap.lookup(segments[i])->second));
+          if (maxResolutions && rl.size() - initialSize >= maxResolutions) {
+            incomplete = true;
+            break;
+          }
+        }
+      }
+      if (incomplete)
+        break;
+      continue;
+    }
+
+    ref<Expr> inRange = AndExpr::create(
+        UgeExpr::create(segment,
+                        ConstantExpr::create(segments[lo], segment->getWidth())),
+        UleExpr::create(segment, ConstantExpr::create(segments[hi - 1],
+                                                      segment->getWidth())));
+    bool mayBeTrue;
+    ++issued;
+    if (!solver->mayBeTrue(state, inRange, mayBeTrue)) {
+      incomplete = true;
+      break;
+    }
+    if (!mayBeTrue)
+      continue;
+
+    // push the upper half first so that the objects are found
+    // in the order of their segments
+    size_t mid = lo + (hi - lo) / 2;
+    worklist.emplace_back(mid, hi);
+    worklist.emplace_back(lo, mid);
   }
-  return false;
+
+  stats::resolveQueries += issued;
+  if (!incomplete && issued < segments.size())
+    stats::resolveQueriesSaved += segments.size() - issued;
+
+  return incomplete;
 }
 
 bool AddressSpace::resolveConstantPointer(ExecutionState &state,
@@ -231,25 +305,31 @@ void AddressSpace::resolveAddressWithOffset(const ExecutionState &state,
   if (!value)
     return;
 
-  ObjectPair op;
-  for (const auto pair: concreteAddressMap) {
-    const auto& resolvedAddress = pair.first;
-    const auto& resolvedSegment = pair.second;
-    const auto *res = segmentMap.lookup(resolvedSegment);
+  // objects do not overlap in the process memory, so the only object
+  // that may contain the address is the last one starting below it
+  uint64_t base, segment;
+  if (!concreteAddressMap.findPreceding(value->getZExtValue(), base, segment))
+    return;
 
-    if (!res)
-      continue;
+  const auto *res = segmentMap.lookup(segment);
+  if (!res)
+    return;
 
-    op = *objects.lookup(res->second);
-    auto subexpr = SubExpr::alloc(address, ConstantExpr::alloc(resolvedAddress, Context::get().getPointerWidth()));
-    auto check = op.first->getBoundsCheckOffset(subexpr);
-    bool mayBeTrue = false;
-    if (solver->mayBeTrue(state, check, mayBeTrue)) {
-      if (mayBeTrue) {
-        rl.push_back(op);
-        offset = cast<ConstantExpr>(address)->getZExtValue() - resolvedAddress;
-      }
-    }
+  ObjectPair op = *objects.lookup(res->second);
+  uint64_t objectOffset = value->getZExtValue() - base;
+  ref<Expr> check = op.first->getBoundsCheckOffset(
+      ConstantExpr::alloc(objectOffset, Context::get().getPointerWidth()));
+
+  // only objects of symbolic size need the solver
+  bool mayBeTrue;
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(check))
+    mayBeTrue = CE->isTrue();
+  else if (!solver->mayBeTrue(state, check, mayBeTrue))
+    return;
+
+  if (mayBeTrue) {
+    rl.push_back(op);
+    offset = objectOffset;
   }
 }
 
@@ -283,7 +363,7 @@ void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved, bool igno
           concreteStore.resize(os->offsetPlane->sizeBound,
                                os->offsetPlane->initialValue);
 
-          memcpy(address, concreteStore.data(), concreteStore.size());
+          concreteStore.copyTo(0, concreteStore.size(), address);
         }
       }
     }
@@ -313,7 +393,7 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                                   const uint64_t &resolvedAddress, ExecutionState &state, TimingSolver *solver) {
   auto address = reinterpret_cast<uint8_t*>(resolvedAddress);
   auto &concreteStoreR = os->offsetPlane->concreteStore;
-  if (memcmp(address, concreteStoreR.data(), concreteStoreR.size()) != 0) {
+  if (!concreteStoreR.equals(0, concreteStoreR.size(), address)) {
     if (os->readOnly) {
       return false;
     } else {
@@ -326,7 +406,7 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
 void AddressSpace::writeToWOS(ExecutionState &state, TimingSolver *solver,
                               const uint8_t *address, ObjectState *wos) const {
   auto &concreteStoreW = wos->offsetPlane->concreteStore;
-  memcpy(concreteStoreW.data(), address, concreteStoreW.size());
+  concreteStoreW.copyFrom(0, concreteStoreW.size(), address);
 
   if (concreteStoreW.size() == Context::get().getPointerWidth() / 8) {
     KValue written = wos->read(0, Context::get().getPointerWidth());
@@ -344,6 +424,54 @@ void AddressSpace::writeToWOS(ExecutionState &state, TimingSolver *solver,
 
 /***/
 
+ConcreteAddressMap::Bindings &ConcreteAddressMap::getWriteable() {
+  if (!bindings)
+    bindings = std::make_shared<Bindings>();
+  else if (bindings.use_count() > 1)
+    bindings = std::make_shared<Bindings>(*bindings);
+  return *bindings;
+}
+
+void ConcreteAddressMap::insert(uint64_t address, uint64_t segment) {
+  Bindings &b = getWriteable();
+  // the address may have been reused after its previous object was freed,
+  // whose segment then no longer lives there
+  auto inserted = b.objectStarts.emplace(address, segment);
+  if (!inserted.second && inserted.first->second != segment) {
+    auto previous = b.segmentToAddress.find(inserted.first->second);
+    if (previous != b.segmentToAddress.end() && previous->second == address)
+      b.segmentToAddress.erase(previous);
+    inserted.first->second = segment;
+  }
+  b.segmentToAddress.emplace(segment, address);
+}
+
+bool ConcreteAddressMap::lookupSegment(uint64_t segment,
+                                       uint64_t &address) const {
+  if (!bindings)
+    return false;
+  auto it = bindings->segmentToAddress.find(segment);
+  if (it == bindings->segmentToAddress.end())
+    return false;
+  address = it->second;
+  return true;
+}
+
+bool ConcreteAddressMap::findPreceding(uint64_t address, uint64_t &base,
+                                       uint64_t &segment) const {
+  if (!bindings)
+    return false;
+  auto it = bindings->objectStarts.upper_bound(address);
+  if (it == bindings->objectStarts.begin())
+    return false;
+  --it;
+  base = it->first;
+  segment = it->second;
+  return true;
+}
+
+/***/
+
 bool MemoryObjectLT::operator()(const MemoryObject *a, const MemoryObject *b) const {
   return a->id < b->id;
 }
\ No newline at end of file
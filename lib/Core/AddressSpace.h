@@ -19,6 +19,10 @@
 
 #include "llvm/ADT/Optional.h"
 
+#include <map>
+#include <memory>
+#include <unordered_map>
+
 namespace klee {
 class ExecutionState;
 class MemoryObject;
@@ -37,10 +41,52 @@ struct MemoryObjectLT {
 
 typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
 typedef ImmutableMap<uint64_t, const MemoryObject*> SegmentMap;
-typedef std::map</*address*/ const uint64_t, /*segment*/ const uint64_t> ConcreteAddressMap;
 typedef std::map</*segment*/ const uint64_t, /*address*/ const uint64_t> SegmentAddressMap;
 typedef std::map</*segment*/ const uint64_t, /*symbolic array*/ ref<Expr>> RemovedObjectsMap;
 
+/// Bidirectional index between segments and the concrete addresses of
+/// their counterparts in the real process memory.
+///
+/// The index is shared between the address spaces of forked states and
+/// it is copied only when one of them records a new binding.
+class ConcreteAddressMap {
+  struct Bindings {
+    std::unordered_map</*segment*/ uint64_t, /*address*/ uint64_t>
+        segmentToAddress;
+    /// The segment living at each address, ordered by address to find the
+    /// object containing an address.
+    std::map</*address*/ uint64_t, /*segment*/ uint64_t> objectStarts;
+  };
+
+  std::shared_ptr<Bindings> bindings;
+
+  Bindings &getWriteable();
+
+public:
+  /// Records that \a segment lives at \a address in the process memory.
+  /// A previous binding of \a address is replaced, together with the
+  /// binding of the segment which lived there. A previous binding of
+  /// \a segment is kept.
+  void insert(uint64_t address, uint64_t segment);
+
+  /// \param[out] address the concrete address of \a segment
+  /// \return true iff \a segment has a concrete address
+  bool lookupSegment(uint64_t segment, uint64_t &address) const;
+
+  /// Finds the object with the highest address not above \a address in
+  /// logarithmic time. As objects do not overlap, it is the only object
+  /// that may contain \a address.
+  /// \param[out] base the address of the object
+  /// \param[out] segment the segment of the object
+  /// \return true iff such an object exists
+  bool findPreceding(uint64_t address, uint64_t &base,
+                     uint64_t &segment) const;
+
+  size_t size() const {
+    return bindings ? bindings->objectStarts.size() : 0;
+  }
+};
+
 class AddressSpace {
   friend class ExecutionState;
 
@@ -72,10 +118,11 @@ public:
       : cowKey(++b.cowKey),
         objects(b.objects),
         segmentMap(b.segmentMap),
+        concreteAddressMap(b.concreteAddressMap),
         removedObjectsMap(b.removedObjectsMap) { }
   ~AddressSpace() {}
 
-  /// Looks up constant segment in concreteAddressMap.
+  /// Looks up constant segment in concreteAddressMap in constant time.
   /// \param segment segment to search for
   /// \param[out] address found address for given segment
   /// \return true iff address was found
@@ -120,6 +167,20 @@ public:
                unsigned maxResolutions=0,
                time::Span timeout=time::Span()) const;
 
+  /// Resolve a pointer with a symbolic non-zero segment to the list of
+  /// `ObjectPairs` it can point to. Instead of asking about every live
+  /// object, the sorted live segments are bisected into value ranges and
+  /// only the ranges the segment may fall into are refined further.
+  ///
+  /// \return true iff the resolution is incomplete (`maxResolutions`
+  /// is non-zero and it was reached, or a query timed out).
+  bool resolveSymbolicSegment(ExecutionState &state,
+                              TimingSolver *solver,
+                              const ref<Expr> &segment,
+                              ResolutionList &rl,
+                              unsigned maxResolutions=0,
+                              time::Span timeout=time::Span()) const;
+
   /// Resolve pointer, first checking for constant segment in segmentMap
   /// and then for constant address in concreteAddressMap, Without returning the offset value
   // TODO:: timeout and maxResolutions
@@ -176,7 +237,9 @@ public:
   bool copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                       const uint64_t &resolvedAddress, ExecutionState &state, TimingSolver *solver);
 
-  /// Checks if address can be found within bounds of concrete addresses in AddressSpace::concreteAddressMap
+  /// Checks if address can be found within bounds of concrete addresses in AddressSpace::concreteAddressMap.
+  /// The containing object is looked up by address; the solver is consulted
+  /// only when that object has a symbolic size.
   /// \param state
   /// \param solver
   /// \param address contains constant address which we are looking for
@@ -12,6 +12,9 @@
 using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
+Statistic stats::boundsCheckQueries("BoundsCheckQueries", "BCqueries");
+Statistic stats::boundsCheckQueriesSaved("BoundsCheckQueriesSaved", "BCsaved");
+Statistic stats::boundsChecks("BoundsChecks", "BC");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
@@ -21,9 +24,18 @@ Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
+Statistic stats::objectStateAllocations("ObjectStateAllocations", "OSalloc");
+Statistic stats::segmentPlaneAllocations("SegmentPlaneAllocations",
+                                         "SPalloc");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
+Statistic stats::resolveQueries("ResolveQueries", "Rqueries");
+Statistic stats::resolveQueriesSaved("ResolveQueriesSaved", "Rsaved");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
 Statistic stats::solverTime("SolverTime", "Stime");
+Statistic stats::speculativeCancels("SpeculativeCancels", "SPcancels");
+Statistic stats::speculativeHits("SpeculativeHits", "SPhits");
+Statistic stats::speculativeQueries("SpeculativeQueries", "SPqueries");
 Statistic stats::states("States", "States");
 Statistic stats::trueBranches("TrueBranches", "Bt");
 Statistic stats::uncoveredInstructions("UncoveredInstructions", "Iuncov");
+Statistic stats::witnessBypasses("WitnessBypasses", "Wbypass");
@@ -16,7 +16,37 @@ namespace klee {
 namespace stats {
 
   extern Statistic allocations;
+
+  /// Number of ObjectStates allocated, including the copies made on
+  /// writes to shared objects.
+  extern Statistic objectStateAllocations;
+
+  /// Number of segment planes allocated for ObjectStates. Objects which
+  /// never held a pointer have none, so the planes saved are the object
+  /// state allocations minus this.
+  extern Statistic segmentPlaneAllocations;
+
+  /// Number of bounds checks done on the single-resolution path of
+  /// memory operations.
+  extern Statistic boundsChecks;
+
+  /// Number of solver queries issued by these bounds checks.
+  extern Statistic boundsCheckQueries;
+
+  /// Number of queries saved by checking the segment and the offset
+  /// of an access in one query.
+  extern Statistic boundsCheckQueriesSaved;
+
   extern Statistic resolveTime;
+
+  /// Number of queries issued when resolving pointers with a symbolic
+  /// segment.
+  extern Statistic resolveQueries;
+
+  /// Number of queries the range-based resolution of symbolic segments
+  /// saved compared to asking about every live object.
+  extern Statistic resolveQueriesSaved;
+
   extern Statistic instructions;
   extern Statistic instructionTime;
   extern Statistic instructionRealTime;
@@ -27,6 +57,17 @@ namespace stats {
   extern Statistic forkTime;
   extern Statistic solverTime;
 
+  /// Number of branch conditions evaluated ahead of time by the
+  /// speculative workers.
+  extern Statistic speculativeQueries;
+
+  /// Number of forks which used the result of a speculative evaluation.
+  extern Statistic speculativeHits;
+
+  /// Number of speculative evaluations cancelled because the state was
+  /// terminated or changed before it forked.
+  extern Statistic speculativeCancels;
+
   /// The number of process forks.
   extern Statistic forks;
 
@@ -47,6 +88,10 @@ namespace stats {
   /// distance to a function return.
   extern Statistic minDistToReturn;
 
+  /// Number of executed instructions which can match no witness edge and
+  /// skipped the witness automaton.
+  extern Statistic witnessBypasses;
+
 }
 }
 
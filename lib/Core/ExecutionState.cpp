@@ -420,12 +420,23 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
   }
 }
 
-bool ExecutionState::inViolationNode() {
-  witnessNode.insert(witnessNodeNext.begin(), witnessNodeNext.end());
-  for (auto node : witnessNode){
-    if (node.violation) {
+bool ExecutionState::inViolationNode(const WitnessAutomaton &witness) {
+  witnessNode.insert(witnessNodeNext);
+  for (unsigned node : witnessNode){
+    if (witness.get_node(node).violation) {
       return true;
     }
   }
   return false;
 }
+
+bool ExecutionState::inSinkNode(const WitnessAutomaton &witness) const {
+  if (witnessNode.empty())
+    return false;
+  for (unsigned node : witnessNode){
+    if (!witness.get_node(node).sink) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -20,9 +20,11 @@
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "SpeculativeSolver.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
+#include "WitnessDispatch.h"
 
 #include "klee/Common.h"
 #include "klee/Config/Version.h"
@@ -77,6 +79,7 @@
 #include <fstream>
 #include <iomanip>
 #include <iosfwd>
+#include <iterator>
 #include <sstream>
 #include <string>
 #include <sys/mman.h>
@@ -171,6 +174,13 @@ cl::opt<bool>
                                   "querying the solver (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<unsigned> SpeculativeWorkers(
+    "speculative-workers", cl::init(0),
+    cl::desc("Number of worker processes which evaluate the branch conditions "
+             "of the states the searcher is about to select ahead of time, 0 "
+             "disabling speculation (default=0)"),
+    cl::cat(SolvingCat));
+
 
 /*** External call policy options ***/
 
@@ -431,6 +441,19 @@ cl::opt<bool> DebugCheckForImpliedValues(
     cl::desc("Debug the implied value optimization"),
     cl::cat(DebugCat));
 
+cl::opt<bool> QueryProfile(
+    "query-profile", cl::init(false),
+    cl::desc("Profile the queries reaching the core solver by issuing "
+             "instruction and query shape, and write a report ranking them "
+             "by solver time to query-profile.txt (default=false)"),
+    cl::cat(DebugCat));
+
+cl::opt<unsigned> QueryProfileDump(
+    "query-profile-dump", cl::init(10),
+    cl::desc("Number of slowest queries written to hot-query-<rank>.kquery "
+             "with --query-profile (default=10)"),
+    cl::cat(DebugCat));
+
 } // namespace
 
 namespace klee {
@@ -462,8 +485,9 @@ const char *Executor::TerminateReasonNames[] = {
 Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
                    InterpreterHandler *ih)
     : Interpreter(opts), interpreterHandler(ih), searcher(0),
-      externalDispatcher(new ExternalDispatcher(ctx)), statsTracker(0),
-      pathWriter(0), symPathWriter(0), specialFunctionHandler(0), timers{time::Span(TimerInterval)},
+      externalDispatcher(new ExternalDispatcher(ctx)), speculativeSolver(0),
+      statsTracker(0), pathWriter(0), symPathWriter(0),
+      specialFunctionHandler(0), timers{time::Span(TimerInterval)},
       replayKTest(0), replayPath(0), usingSeeds(0),
       atMemoryLimit(false), inhibitForking(false), haltExecution(false),
       ivcEnabled(false), debugLogBuffer(debugBufferString) {
@@ -483,6 +507,55 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
     klee_error("Failed to create core solver\n");
   }
 
+  if (QueryProfile) {
+    coreSolver = createQueryProfilingSolver(
+        coreSolver, interpreterHandler->getOutputFilename("query-profile.txt"),
+        interpreterHandler->getOutputFilename("hot-query-"), QueryProfileDump,
+        [this, byId = std::vector<std::pair<const KInstruction *,
+                                             const KFunction *> >()](
+            unsigned id) mutable -> std::string {
+          // only called for the report, once the module is set, so the
+          // instructions are indexed on the first call
+          if (byId.empty()) {
+            byId.resize(kmodule->infos->getMaxID());
+            for (auto &kf : kmodule->functions)
+              for (unsigned i = 0; i != kf->numInstructions; ++i)
+                byId[kf->instructions[i]->info->id] = {kf->instructions[i],
+                                                       kf.get()};
+          }
+          if (id >= byId.size() || !byId[id].first)
+            return "[unknown instruction]";
+          return byId[id].first->getSourceLocation() + " (" +
+                 byId[id].second->function->getName().str() + ")";
+        });
+  }
+
+  if (SpeculativeWorkers) {
+    if (QueryLoggingOptions.getBits())
+      klee_error("--speculative-workers cannot be combined with "
+                 "--use-query-log.");
+    // every worker needs a solver chain of its own, see SpeculativeSolver.
+    // The persistent cache is left out: its file lock belongs to the open
+    // file description, which the executor shares with the workers, so a
+    // worker killed while holding it would leave it held forever. Replayed
+    // results still reach the cache through the main chain.
+    std::vector<TimingSolver *> workerSolvers;
+    for (unsigned i = 0; i != SpeculativeWorkers; ++i) {
+      Solver *workerSolver = klee::createCoreSolver(CoreSolverToUse);
+      if (!workerSolver)
+        klee_error("Failed to create core solver\n");
+      workerSolvers.push_back(new TimingSolver(
+          constructSolverChain(workerSolver, "", "", "", "",
+                               /*usePersistentCache=*/false),
+          EqualitySubstitution));
+    }
+    speculativeSolver =
+        new SpeculativeSolver(workerSolvers, coreSolverTimeout);
+    // the results of the workers are replayed through the main chain, see
+    // Executor::fork
+    coreSolver = speculativeSolver->createReplaySolver(coreSolver);
+  }
+
   Solver *solver = constructSolverChain(
       coreSolver,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
@@ -583,14 +656,23 @@ Executor::setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
                       (Expr::Width)TD->getPointerSizeInBits());
   memory->useLowMemory(TD->getPointerSizeInBits() == 32);
 
+  witnessDispatch.build(witness, *kmodule);
+
   return kmodule->module.get();
 }
 
+void Executor::setWitnessAut(WitnessAutomaton &a) {
+  witness = a;
+  if (kmodule)
+    witnessDispatch.build(witness, *kmodule);
+}
+
 Executor::~Executor() {
   delete memory;
   delete externalDispatcher;
   delete specialFunctionHandler;
   delete statsTracker;
+  delete speculativeSolver;
   delete solver;
 }
 
@@ -647,7 +729,7 @@ MemoryObject *Executor::addExternalObject(ExecutionState &state, void *addr,
                                           uint64_t specialSegment) {
   auto mo = memory->allocateFixed(size, nullptr, specialSegment);
   state.addressSpace.concreteAddressMap.insert(
-      {reinterpret_cast<uint64_t>(addr), mo->segment});
+      reinterpret_cast<uint64_t>(addr), mo->segment);
   ObjectState *os = bindObjectInState(state, mo, false);
   for (unsigned i = 0; i < size; i++)
     os->write8(i, (uint8_t)mo->segment, ((uint8_t *)addr)[i]);
@@ -833,7 +915,7 @@ void Executor::initializeGlobals(ExecutionState &state) {
 
       initializedMOs.insert({mo->segment, reinterpret_cast<uint64_t>(address)});
       state.addressSpace.concreteAddressMap.insert(
-          {reinterpret_cast<uint64_t>(address), mo->getSegment()});
+          reinterpret_cast<uint64_t>(address), mo->getSegment());
       state.addressSpace.segmentMap.replace(
           std::make_pair(mo->getSegment(), mo));
 
@@ -977,9 +1059,15 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   time::Span timeout = coreSolverTimeout;
   if (isSeeding)
     timeout *= static_cast<unsigned>(it->second.size());
+  // a result speculated by a worker is replayed through the solver chain,
+  // which fills its caches as if the query was solved here
+  bool replaying = !isSeeding && speculativeSolver &&
+                   speculativeSolver->lookup(current, condition);
   solver->setTimeout(timeout);
   bool success = solver->evaluate(current, condition, res);
   solver->setTimeout(time::Span());
+  if (replaying)
+    speculativeSolver->endReplay();
   if (!success) {
     current.pc = current.prevPC;
     terminateStateEarly(current, "Query timed out (fork).");
@@ -1377,46 +1465,61 @@ void Executor::printDebugInstructions(ExecutionState &state) {
 
 
 void Executor::stepWitness(ExecutionState &state, KInstruction *ki){
+    WitnessDispatchTable::Kind kind = WitnessDispatchTable::getKind(ki->inst);
+    bool atEntry = state.steppedInstructions <= 1;
+    std::vector<unsigned> entryCandidates;
+    const std::vector<unsigned> *candidatesPtr =
+        &witnessDispatch.getCandidates(kind, ki->info->line);
+    const std::vector<unsigned> &entryEdges =
+        witnessDispatch.getEntryEdges(kind);
+    if (atEntry && !entryEdges.empty()) {
+        std::set_union(candidatesPtr->begin(), candidatesPtr->end(),
+                       entryEdges.begin(), entryEdges.end(),
+                       std::back_inserter(entryCandidates));
+        candidatesPtr = &entryCandidates;
+    }
+    const std::vector<unsigned> &candidates = *candidatesPtr;
+
     bool replay = false;
-    std::string fun;
-    if (ki->inst->getOpcode() == Instruction::Call) {
-        // Ignore debug intrinsic calls?
-        // if (isa<DbgInfoIntrinsic>(ki->inst)) {
-        //    state.witnessNodeNext.insert(state.witnessNode.begin(), state.witnessNode.end());
-        //    state.witnessNode.clear();
-        //    return;
-        //}
-
-        fun = getCallFunName(state, ki);
-        if (fun.compare(0, 17, "__VERIFIER_nondet") == 0)
+    const Function *f = nullptr;
+    if (kind == WitnessDispatchTable::Call) {
+        CallSite cs(cast<CallInst>(ki->inst));
+        f = getTargetFunction(cs.getCalledValue(), state);
+        if (f && f->getName().startswith("__VERIFIER_nondet"))
             replay = true;
+    } else if (kind == WitnessDispatchTable::Return) {
+        f = ki->inst->getFunction();
     }
+    unsigned fun = witnessDispatch.getFunctionId(f);
 
     if (state.witnessNode.size() != witness.get_nodes_number()) {
-        for (auto node : state.witnessNode) {
+        for (unsigned n : state.witnessNode) {
+          const WitnessNode &node = witness.get_node(n);
 
+          // the candidates among the outgoing edges of the node
+          auto it = std::lower_bound(candidates.begin(), candidates.end(),
+                                     node.edges_begin);
           bool progress = false;
-          for (auto edge : node.edges) {
-              WitnessNode target = *(edge->target.lock());
-              if (state.witnessNode.find(target) != state.witnessNode.end() ||
-                  state.witnessNodeNext.find(target) != state.witnessNodeNext.end())
-                  continue;
-              if (matchEdge(*edge, ki, state)) {
-                  state.witnessNodeNext.emplace(target);
-                  progress = true;
-              }
-          }
-
-          if (replay)
-              for (auto edge : node.replayEdges) {
-                  if (matchEdge(*edge, ki, state)) {
+          for (; it != candidates.end() && *it < node.edges_end; ++it) {
+              unsigned e = *it;
+              if (e < node.replay_begin) {
+                  const WitnessEdge &edge = witness.get_edge(e);
+                  if (state.witnessNode.contains(edge.target) ||
+                      state.witnessNodeNext.contains(edge.target))
+                      continue;
+                  if (witnessDispatch.matches(e, kind, fun, atEntry)) {
+                      state.witnessNodeNext.insert(edge.target);
                       progress = true;
-                      state.replayEdges.insert(edge);
                   }
+              } else if (replay &&
+                         witnessDispatch.matches(e, kind, fun, atEntry)) {
+                  progress = true;
+                  state.replayEdges.insert(e);
               }
+          }
 
           if (!progress) {
-              state.witnessNodeNext.emplace(node);
+              state.witnessNodeNext.insert(n);
           }
         }
 
@@ -1434,8 +1537,14 @@ void Executor::stepInstruction(ExecutionState &state) {
     statsTracker->stepInstruction(state);
 
   KInstruction *ki = state.pc;
+  // the query profiler charges queries to the index
+  if (QueryProfile)
+    theStatisticManager->setIndex(ki->info->id);
 
-  stepWitness(state, ki);
+  if (isWitnessRelevant(state, ki))
+    stepWitness(state, ki);
+  else
+    ++stats::witnessBypasses;
 
   ++stats::instructions;
   ++state.steppedInstructions;
@@ -1552,7 +1661,7 @@ void Executor::executeCall(ExecutionState &state,
     // fall-through
   } else if (isErrorCall(f->getName())) {
       if (witness.get_spec(WitnessSpec::unreach_call) &&
-          witness.get_err_function() == ErrorFun && state.inViolationNode()) {
+          witness.get_err_function() == ErrorFun && state.inViolationNode(witness)) {
         confirmWitness("Valid violation witness: unreach-call");
       }
       terminateStateOnError(state,
@@ -1940,35 +2049,34 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
         statsTracker->markBranchVisited(branches.first, branches.second);
 
 
-      std::set<WitnessNode> nextTrue;
-      std::set<WitnessNode> nextFalse;
-      nextTrue.insert(state.witnessNode.begin(), state.witnessNode.end());
-      nextFalse.insert(state.witnessNode.begin(), state.witnessNode.end());
+      WitnessIndexSet nextTrue = state.witnessNode;
+      WitnessIndexSet nextFalse = state.witnessNode;
 
-      for (auto node : state.witnessNode) {
+      for (unsigned n : state.witnessNode) {
         if (nextTrue.size() == witness.get_nodes_number())
           break;
-        for (auto edge : node.edges) {
-          WitnessNode target = *(edge->target.lock());
-          if (state.witnessNodeNext.find(target) == state.witnessNodeNext.end())
+        const WitnessNode &node = witness.get_node(n);
+        for (unsigned e = node.edges_begin; e != node.replay_begin; ++e) {
+          const WitnessEdge &edge = witness.get_edge(e);
+          if (!state.witnessNodeNext.contains(edge.target))
             continue;
-          if (state.witnessNode.find(target) != state.witnessNode.end())
+          if (state.witnessNode.contains(edge.target))
             continue;
-          if (branches.first && nextTrue.find(target) == nextTrue.end() &&
-              (edge->control.empty() || edge->control == "condition-true"))
-            (nextTrue).emplace(target);
-          if (branches.second && nextFalse.find(target) == nextFalse.end() &&
-              (edge->control.empty() || edge->control == "condition-false"))
-            (nextFalse).emplace(target);
+          if (branches.first &&
+              (edge.control.empty() || edge.control == "condition-true"))
+            nextTrue.insert(edge.target);
+          if (branches.second &&
+              (edge.control.empty() || edge.control == "condition-false"))
+            nextFalse.insert(edge.target);
         }
       }
 
       if (branches.first){
-        branches.first->witnessNode.insert(nextTrue.begin(), nextTrue.end());
+        branches.first->witnessNode.insert(nextTrue);
         transferToBasicBlock(bi->getSuccessor(0), bi->getParent(), *branches.first);
       }
       if (branches.second){
-        branches.second->witnessNode.insert(nextFalse.begin(), nextFalse.end());
+        branches.second->witnessNode.insert(nextFalse);
         transferToBasicBlock(bi->getSuccessor(1), bi->getParent(), *branches.second);
       }
     }
@@ -3013,6 +3121,8 @@ void Executor::updateStates(ExecutionState *current) {
       seedMap.find(es);
     if (it3 != seedMap.end())
       seedMap.erase(it3);
+    if (speculativeSolver)
+      speculativeSolver->cancel(*es);
     processTree->remove(es->ptreeNode);
     delete es;
   }
@@ -3025,6 +3135,118 @@ void Executor::updateStates(ExecutionState *current) {
   }
 }
 
+ref<Expr> Executor::getUpcomingCondition(const ExecutionState &state) {
+  // the copy would be added to the merge handlers of the state
+  if (!state.openMergeStack.empty() || interpreterOpts.MakeConcreteSymbolic)
+    return ref<Expr>();
+
+  // loops on concrete conditions are only followed for a few iterations
+  ExecutionState copy(state);
+  for (unsigned steps = 0; steps != 64; ++steps) {
+    KInstruction *ki = copy.pc;
+    Instruction *i = ki->inst;
+    copy.prevPC = copy.pc;
+    ++copy.pc;
+
+    switch (i->getOpcode()) {
+    case Instruction::Br: {
+      BranchInst *bi = cast<BranchInst>(i);
+      unsigned successor = 0;
+      if (bi->isConditional()) {
+        // the condition as the Br handler computes it
+        ref<Expr> cond = eval(ki, 0, copy).value;
+        cond = optimizer.optimizeExpr(cond, false);
+        ConstantExpr *ce = dyn_cast<ConstantExpr>(cond);
+        if (!ce)
+          return cond;
+        successor = ce->isTrue() ? 0 : 1;
+      }
+      transferToBasicBlock(bi->getSuccessor(successor), bi->getParent(),
+                           copy);
+      break;
+    }
+
+    case Instruction::Load:
+    case Instruction::Store: {
+      // only accesses in bounds of an object at a constant address, which
+      // can neither fork nor fail
+      bool isWrite = i->getOpcode() == Instruction::Store;
+      const Cell &address = eval(ki, isWrite ? 1 : 0, copy);
+      ConstantExpr *segment = dyn_cast<ConstantExpr>(address.getSegment());
+      ConstantExpr *offset = dyn_cast<ConstantExpr>(address.getOffset());
+      ObjectPair op;
+      if (!segment || segment->isZero() || !offset ||
+          !copy.addressSpace.resolveOneConstantSegment(address, op))
+        return ref<Expr>();
+      Expr::Width type = isWrite ? eval(ki, 0, copy).getWidth()
+                                 : getWidthForLLVMType(i->getType());
+      uint64_t bytes = Expr::getMinBytesForWidth(type);
+      ConstantExpr *size = dyn_cast<ConstantExpr>(op.first->size);
+      if (!size || bytes > size->getZExtValue() ||
+          offset->getZExtValue() > size->getZExtValue() - bytes)
+        return ref<Expr>();
+      if (!isWrite) {
+        bindLocal(ki, copy, op.second->read(offset, type));
+      } else if (op.second->readOnly) {
+        return ref<Expr>();
+      } else {
+        ObjectState *wos = copy.addressSpace.getWriteable(op.first, op.second);
+        wos->write(offset, eval(ki, 0, copy));
+      }
+      break;
+    }
+
+    case Instruction::ICmp:
+      // pointer comparisons may need the solver or fail
+      if (!eval(ki, 0, copy).getSegment()->isZero() ||
+          !eval(ki, 1, copy).getSegment()->isZero())
+        return ref<Expr>();
+      executeInstruction(copy, ki);
+      break;
+
+    case Instruction::PHI:
+    case Instruction::GetElementPtr:
+    case Instruction::Add:
+    case Instruction::Sub:
+    case Instruction::Mul:
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+    case Instruction::Trunc:
+    case Instruction::ZExt:
+    case Instruction::SExt:
+    case Instruction::IntToPtr:
+    case Instruction::PtrToInt:
+    case Instruction::BitCast:
+      executeInstruction(copy, ki);
+      break;
+
+    default:
+      return ref<Expr>();
+    }
+  }
+  return ref<Expr>();
+}
+
+void Executor::speculate(ExecutionState *current) {
+  std::vector<ExecutionState *> upcoming;
+  searcher->getUpcomingStates(upcoming, SpeculativeWorkers + 1);
+  for (ExecutionState *es : upcoming) {
+    if (!speculativeSolver->hasIdleWorker())
+      break;
+    // the current state would reach its branch before a worker is done
+    if (es == current || seedMap.count(es) ||
+        speculativeSolver->isSpeculating(*es))
+      continue;
+    ref<Expr> cond = getUpcomingCondition(*es);
+    if (!cond.isNull())
+      speculativeSolver->speculate(*es, cond);
+  }
+}
+
 template <typename TypeIt>
 void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
   ref<ConstantExpr> constantOffset =
@@ -3236,6 +3458,8 @@ void Executor::run(ExecutionState &initialState) {
   while (!states.empty() && !haltExecution) {
     ExecutionState &state = searcher->selectState();
     KInstruction *ki = state.pc;
+    // a bypassed instruction matches no edge, so that every node stays
+    bool witnessStep = isWitnessRelevant(state, ki);
     stepInstruction(state);
 
     executeInstruction(state, ki);
@@ -3245,17 +3469,31 @@ void Executor::run(ExecutionState &initialState) {
 
 
 
-    state.witnessNode.clear();
-    state.witnessNode.insert(state.witnessNodeNext.begin(), state.witnessNodeNext.end());
-    state.witnessNodeNext.clear();
+    if (witnessStep) {
+      state.witnessNode.swap(state.witnessNodeNext);
+      state.witnessNodeNext.clear();
+    }
 
-    if (state.witnessNode.size() == 0 && state.witnessNode.begin()->sink == true)
+    if (state.inSinkNode(witness))
         terminateStateEarly(state, "Terminating state: Witness exploration reached sink.");
 
 
     checkMemoryUsage();
 
+    // the branches the waiting states reach next only change when states
+    // fork or terminate
+    bool speculationDue = speculativeSolver && (!addedStates.empty() ||
+                                                !removedStates.empty());
+    ExecutionState *current =
+        std::find(removedStates.begin(), removedStates.end(), &state) ==
+                removedStates.end()
+            ? &state
+            : nullptr;
+
     updateStates(&state);
+
+    if (speculationDue)
+      speculate(current);
   }
 
   delete searcher;
@@ -3642,7 +3880,7 @@ void Executor::terminateStateOnError(ExecutionState &state,
                                      enum TerminateReason termReason,
                                      const char *suffix,
                                      const llvm::Twine &info) {
-  if (state.inViolationNode()) {
+  if (state.inViolationNode(witness)) {
     if (termReason == Free && witness.get_spec(WitnessSpec::valid_free)) {
       confirmWitness("Valid violation witness: valid-free");
     }
@@ -3683,7 +3921,7 @@ void Executor::terminateStateOnError(ExecutionState &state,
         reportError(message.c_str(), state, info, suffix, termReason);
       }
 
-      if (state.inViolationNode() && witness.get_spec(WitnessSpec::valid_memcleanup)) {
+      if (state.inViolationNode(witness) && witness.get_spec(WitnessSpec::valid_memcleanup)) {
               confirmWitness("Valid violation witness: valid-memcleanup");
       }
       if (shouldExitOn(Executor::Leak))
@@ -3890,47 +4128,81 @@ void Executor::callExternalFunction(ExecutionState &state,
   memset(args, 0, 2 * sizeof(*args) * (arguments.size() + 1));
   unsigned wordIndex = 2;
   SegmentAddressMap resolvedMOs;
-  for (std::vector<Cell>::const_iterator ai = arguments.begin(),
-       ae = arguments.end(); ai!=ae; ++ai) {
-    uint64_t address = 0;
-    if (ExternalCalls == ExternalCallPolicy::All) { // don't bother checking uniqueness
-      auto value = optimizer.optimizeExpr(ai->getValue(), true);
-      ref<ConstantExpr> ce;
+  if (ExternalCalls == ExternalCallPolicy::All) { // don't bother checking uniqueness
+    // The arguments and the symbolic bytes of the objects they point to are
+    // concretized together, from a single model of the constraints.
+    std::vector<ref<Expr> > values;
+    std::vector<const ObjectState *> flushed;
+    for (const Cell &arg : arguments) {
       // TODO segment
-      bool success = solver->getValue(state, value, ce);
-      assert(success && "FIXME: Unhandled solver failure");
-      ce->toMemory(&args[wordIndex]);
-      ObjectPair op;
+      values.push_back(optimizer.optimizeExpr(arg.getValue(), true));
       // Checking to see if the argument is a pointer to something
-      if (ce->getWidth() == Context::get().getPointerWidth()) {
-        Optional<uint64_t> temp;
-        state.addressSpace.resolveOne(state, solver, *ai, op, success, temp);
-        if (success) {
-          auto found = state.addressSpace.resolveInConcreteMap(
-              op.first->segment, address);
-          if (!found) {
-            void *addr = memory->allocateMemory(
-                op.first->allocatedSize,
-                getAllocationAlignment(op.first->allocSite));
-            if (!addr)
-              klee_error("Couldn't allocate memory for external function");
-            address = reinterpret_cast<uint64_t>(addr);
-          }
-          resolvedMOs.insert({op.first->segment, address});
+      if (values.back()->getWidth() != Context::get().getPointerWidth())
+        continue;
+      ObjectPair op;
+      bool success;
+      Optional<uint64_t> temp;
+      state.addressSpace.resolveOne(state, solver, arg, op, success, temp);
+      if (!success)
+        continue;
+      uint64_t address = 0;
+      auto found = state.addressSpace.resolveInConcreteMap(
+          op.first->segment, address);
+      if (!found) {
+        void *addr = memory->allocateMemory(
+            op.first->allocatedSize,
+            getAllocationAlignment(op.first->allocSite));
+        if (!addr)
+          klee_error("Couldn't allocate memory for external function");
+        address = reinterpret_cast<uint64_t>(addr);
+        state.addressSpace.concreteAddressMap.insert(address,
+                                                     op.first->segment);
+      }
+      resolvedMOs.insert({op.first->segment, address});
 
-          if (op.second->getSizeBound() == 0 ||
-              (op.second->getSizeBound() > op.first->allocatedSize)) {
-            terminateStateOnExecError(
-                state, "external call with symbolic-sized object that "
-                       "has no real virtual process memory: " +
-                           function->getName());
-            return;
-          }
-          op.second->flushToConcreteStore(solver, state);
-        }
+      if (op.second->getSizeBound() == 0 ||
+          (op.second->getSizeBound() > op.first->allocatedSize)) {
+        terminateStateOnExecError(
+            state, "external call with symbolic-sized object that "
+                   "has no real virtual process memory: " +
+                       function->getName());
+        return;
       }
-      wordIndex += (ce->getWidth() + 63) / 64;
-    } else {
+      if (std::find(flushed.begin(), flushed.end(), op.second) ==
+          flushed.end())
+        flushed.push_back(op.second);
+    }
+
+    std::vector<unsigned> offsets;
+    // the number of symbolic bytes of each flushed object
+    std::vector<size_t> counts;
+    for (const ObjectState *os : flushed) {
+      size_t n = values.size();
+      os->getSymbolicBytes(offsets, values);
+      counts.push_back(values.size() - n);
+    }
+
+    std::vector<ref<ConstantExpr> > results;
+    if (!solver->getValues(state, values, results)) {
+      terminateStateEarly(state, "Query timed out (external call).");
+      return;
+    }
+
+    for (unsigned i = 0; i != arguments.size(); ++i) {
+      results[i]->toMemory(&args[wordIndex]);
+      wordIndex += (results[i]->getWidth() + 63) / 64;
+    }
+    const unsigned *offset = offsets.data();
+    const ref<ConstantExpr> *value = results.data() + arguments.size();
+    for (unsigned i = 0; i != flushed.size(); ++i) {
+      flushed[i]->flushToConcreteStore(offset, value, counts[i]);
+      offset += counts[i];
+      value += counts[i];
+    }
+  } else {
+    for (std::vector<Cell>::const_iterator ai = arguments.begin(),
+         ae = arguments.end(); ai != ae; ++ai) {
+      uint64_t address = 0;
       // we are allowed external calls with concrete arguments only
       auto segmentExpr = toUnique(state, ai->getSegment());
       if (!isa<ConstantExpr>(segmentExpr)) {
@@ -3956,6 +4228,8 @@ void Executor::callExternalFunction(ExecutionState &state,
             if (!addr)
               klee_error("Couldn't allocate memory for external function");
             address = reinterpret_cast<uint64_t>(addr);
+            state.addressSpace.concreteAddressMap.insert(address,
+                                                         op.first->segment);
           }
 
           resolvedMOs.insert({op.first->segment, address});
@@ -4317,20 +4591,29 @@ void Executor::executeMemoryOperation(ExecutionState &state,
     ref<Expr> isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
     isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
 
-    bool inBoundsOffset;
-    bool inBoundsSegment;
+    // Both checks must hold, so ask a single query for the conjunction.
+    // A constant segment (or one settled by offsetVal) folds away here
+    // and a segment that cannot match settles the check without a query.
+    ref<Expr> inBoundsCheck = AndExpr::create(isEqualSegment, isOffsetInBounds);
+
+    ++stats::boundsChecks;
+    unsigned separateQueries = !isa<ConstantExpr>(isEqualSegment) +
+                               !isa<ConstantExpr>(isOffsetInBounds);
+    unsigned fusedQueries = !isa<ConstantExpr>(inBoundsCheck);
+    stats::boundsCheckQueries += fusedQueries;
+    stats::boundsCheckQueriesSaved += separateQueries - fusedQueries;
+
+    bool inBounds;
     solver->setTimeout(coreSolverTimeout);
-    bool successSegment =
-        solver->mustBeTrue(state, isEqualSegment, inBoundsSegment);
-    bool success = solver->mustBeTrue(state, isOffsetInBounds, inBoundsOffset);
+    bool success = solver->mustBeTrue(state, inBoundsCheck, inBounds);
     solver->setTimeout(time::Span());
-    if (!success || !successSegment) {
+    if (!success) {
       state.pc = state.prevPC;
       terminateStateEarly(state, "Query timed out (bounds check).");
       return;
     }
 
-    if (inBoundsSegment && inBoundsOffset) {
+    if (inBounds) {
       const ObjectState *os = op.second;
       if (isWrite) {
         if (os->readOnly) {
@@ -5189,53 +5472,6 @@ Interpreter *Interpreter::create(LLVMContext &ctx, const InterpreterOptions &opt
   return new Executor(ctx, opts, ih);
 }
 
-bool Executor::matchEdge(const WitnessEdge& edge, KInstruction *ki, ExecutionState& state) {
-  int line = ki->info->line;
-  int startline = edge.startline;
-
-  if (ki->inst->getOpcode() != Instruction::Ret && startline != 0 &&
-      !(line == startline || (line > edge.startline && line <= edge.endline)))
-    return false;
-
-  if (!edge.control.empty() && ki->inst->getOpcode() != Instruction::Br)
-    return false;
-
-  std::string fun = "";
-  if (ki->inst->getOpcode() == Instruction::Ret) {
-      ReturnInst *ri = cast<ReturnInst>(ki->inst);
-      fun = ri->getFunction()->getName();
-  }
-
-  if (ki->inst->getOpcode() == Instruction::Call) {
-      CallInst *ci = cast<CallInst>(ki->inst);
-      CallSite cs(ci);
-      Value *fp = cs.getCalledValue();
-      Function *f = getTargetFunction(fp, state);
-      if (f != nullptr)
-          fun = f->getName();
-  }
-
-  if (!edge.retFromFunc.empty()) {
-    if (ki->inst->getOpcode() != Instruction::Ret || fun != edge.retFromFunc)
-      return false;
-  }
-
-  if (!edge.enterFunc.empty()) {
-    if (edge.enterFunc != "main" || state.steppedInstructions > 1) {
-      if (ki->inst->getOpcode() != Instruction::Call ||
-              fun != edge.enterFunc)
-        return false;
-    }
-  }
-
-  if (!edge.assumResFunc.empty()){
-    if (fun != edge.assumResFunc)
-      return false;
-  }
-  return true;
-}
-
-
 void Executor::prepare_witness_replay(ExecutionState& state){
     assert(!state.replayEdges.empty());
 
@@ -5260,13 +5496,13 @@ void Executor::prepare_witness_replay(ExecutionState& state){
         return;
     }
 
-    auto succ = *(state.replayEdges.begin());
+    unsigned succ = *(state.replayEdges.begin());
 
-    state.replayEdges.erase(state.replayEdges.begin());
+    state.replayEdges.erase(succ);
 
 
 
-    for (auto edge : state.replayEdges) {
+    for (unsigned edge : state.replayEdges) {
         ExecutionState *newState = new ExecutionState(state);
         newState->coveredNew = false;
         newState->coveredLines.clear();
@@ -5282,19 +5518,6 @@ void Executor::prepare_witness_replay(ExecutionState& state){
 
 }
 
-std::string Executor::getCallFunName(ExecutionState state, KInstruction *ki) {
-    assert(ki->inst->getOpcode() == Instruction::Call);
-    std::string fun = "";
-    CallInst *ci = cast<CallInst>(ki->inst);
-    CallSite cs(ci);
-    Value *fp = cs.getCalledValue();
-    Function *f = getTargetFunction(fp, state);
-    if (f != nullptr)
-        fun = f->getName();
-    return fun;
-}
-
-
 void Executor::confirmWitness(const char* message) {
     klee_message("Valid violation witness: %s", message);
     haltExecution=true;
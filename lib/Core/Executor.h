@@ -27,6 +27,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include "../Expr/ArrayExprOptimizer.h"
+#include "WitnessDispatch.h"
 
 #include <map>
 #include <memory>
@@ -69,6 +70,7 @@ namespace klee {
   class Searcher;
   class SeedInfo;
   class SpecialFunctionHandler;
+  class SpeculativeSolver;
   struct StackFrame;
   class StatsTracker;
   class TimingSolver;
@@ -86,6 +88,7 @@ class Executor : public Interpreter {
   friend class RandomPathSearcher;
   friend class OwningSearcher;
   friend class WeightedRandomSearcher;
+  friend class WitnessSearcher;
   friend class SpecialFunctionHandler;
   friend class StatsTracker;
   friend class MergeHandler;
@@ -120,6 +123,7 @@ private:
 
   ExternalDispatcher *externalDispatcher;
   TimingSolver *solver;
+  SpeculativeSolver *speculativeSolver;
   MemoryManager *memory;
   std::set<ExecutionState*> states;
   StatsTracker *statsTracker;
@@ -128,6 +132,8 @@ private:
   TimerGroup timers;
   std::unique_ptr<PTree> processTree;
   WitnessAutomaton witness;
+  /// The edges of the witness by the lines of the module.
+  WitnessDispatchTable witnessDispatch;
 
   /// Keeps track of all currently ongoing merges.
   /// An ongoing merge is a set of states which branched from a single state
@@ -254,6 +260,18 @@ private:
 
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
+
+  /// Executes a copy of \a state up to its next branch on a symbolic
+  /// condition, as long as only instructions which can neither fork nor
+  /// fail are on the way, i.e. no calls and only memory accesses at
+  /// constant addresses.
+  /// \return the condition of the branch, or null if it is not reached
+  ref<Expr> getUpcomingCondition(const ExecutionState &state);
+
+  /// Starts evaluating, in the speculative workers, the conditions of the
+  /// branches the states the searcher is about to select reach next,
+  /// except for \a current.
+  void speculate(ExecutionState *current);
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
@@ -528,7 +546,7 @@ public:
 
   void setReplayNondet(const struct KTest *out) override;
 
-  void setWitnessAut(WitnessAutomaton &a){ witness = a; };
+  void setWitnessAut(WitnessAutomaton &a) override;
 
   llvm::Module *setModule(std::vector<std::unique_ptr<llvm::Module>> &modules,
                           const ModuleOptions &opts) override;
@@ -577,10 +595,17 @@ public:
   /// Returns the errno location in memory of the state
   int *getErrnoLocation(const ExecutionState &state) const;
 
-  bool matchEdge(const WitnessEdge& edge, KInstruction *ki, ExecutionState& state);
   void prepare_witness_replay(klee::ExecutionState&);
   void stepWitness(ExecutionState& state, KInstruction *ki);
-  std::string getCallFunName(ExecutionState state, KInstruction *ki);
+
+  /// Returns true if \a ki may match an edge of the witness when \a state
+  /// executes it, otherwise the witness nodes of the state are left as
+  /// they are.
+  bool isWitnessRelevant(const ExecutionState &state,
+                         const KInstruction *ki) const {
+    // edges entering main are matched by the first instructions
+    return ki->witnessRelevant || state.steppedInstructions <= 1;
+  }
   void confirmWitness(const char* message);
 
 };
@@ -10,6 +10,7 @@
 #include "Memory.h"
 
 #include "Context.h"
+#include "CoreStats.h"
 #include "MemoryManager.h"
 #include "ObjectHolder.h"
 
@@ -19,6 +20,7 @@
 #include "klee/OptionCategories.h"
 #include "klee/Solver/Solver.h"
 #include "klee/util/BitArray.h"
+#include "klee/util/SlabAllocator.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
@@ -26,6 +28,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
@@ -42,6 +45,61 @@ namespace {
 
 /***/
 
+namespace {
+// The pools are never destroyed, as objects may still be released while
+// static destructors run.
+SlabAllocator &getMemoryObjectPool() {
+  static SlabAllocator *pool = new SlabAllocator(sizeof(MemoryObject));
+  return *pool;
+}
+
+SlabAllocator &getObjectStatePool() {
+  static SlabAllocator *pool = new SlabAllocator(sizeof(ObjectState));
+  return *pool;
+}
+
+SlabAllocator &getObjectStatePlanePool() {
+  static SlabAllocator *pool = new SlabAllocator(sizeof(ObjectStatePlane));
+  return *pool;
+}
+}
+
+size_t klee::getObjectPoolUsage() {
+  return getMemoryObjectPool().getReservedSize() +
+         getObjectStatePool().getReservedSize() +
+         getObjectStatePlanePool().getReservedSize();
+}
+
+void *MemoryObject::operator new(size_t size) {
+  assert(size == sizeof(MemoryObject) && "unexpected allocation size");
+  return getMemoryObjectPool().allocate();
+}
+
+void MemoryObject::operator delete(void *ptr) {
+  getMemoryObjectPool().deallocate(ptr);
+}
+
+void *ObjectState::operator new(size_t size) {
+  assert(size == sizeof(ObjectState) && "unexpected allocation size");
+  ++stats::objectStateAllocations;
+  return getObjectStatePool().allocate();
+}
+
+void ObjectState::operator delete(void *ptr) {
+  getObjectStatePool().deallocate(ptr);
+}
+
+void *ObjectStatePlane::operator new(size_t size) {
+  assert(size == sizeof(ObjectStatePlane) && "unexpected allocation size");
+  return getObjectStatePlanePool().allocate();
+}
+
+void ObjectStatePlane::operator delete(void *ptr) {
+  getObjectStatePlanePool().deallocate(ptr);
+}
+
+/***/
+
 ObjectHolder::ObjectHolder(const ObjectHolder &b) : os(b.os) { 
   if (os) ++os->refCount; 
 }
@@ -127,6 +185,7 @@ ObjectStatePlane::ObjectStatePlane(const ObjectState *parent)
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(parent->getObject()->size)) {
     sizeBound = CE->getZExtValue();
   }
+  knownSymbolics = SparseVector<ref<Expr> >(sizeBound);
 }
 
 
@@ -140,6 +199,7 @@ ObjectStatePlane::ObjectStatePlane(const ObjectState *parent, const Array *array
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(parent->getObject()->size)) {
     sizeBound = CE->getZExtValue();
   }
+  knownSymbolics = SparseVector<ref<Expr> >(sizeBound);
 }
 
 ObjectStatePlane::ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os)
@@ -214,20 +274,37 @@ const UpdateList &ObjectStatePlane::getUpdates() const {
 
 void ObjectStatePlane::flushToConcreteStore(TimingSolver *solver,
                                        const ExecutionState &state) {
-  for (unsigned i = 0; i < concreteStore.size(); i++) {
-    if (isByteKnownSymbolic(i)) {
-      ref<ConstantExpr> ce;
-      bool success = solver->getValue(state, read8(i), ce);
-      if (!success) {
-        klee_warning("Solver timed out when getting a value for external call, "
-                     "segment + offset %lu+%u will have random value",
-                     parent->getObject()->segment, i);
-      } else {
-        uint8_t value;
-        ce->toMemory(&value);
-        concreteStore[i] = value;
-      }
-    }
+  std::vector<unsigned> offsets;
+  std::vector<ref<Expr> > bytes;
+  getSymbolicBytes(offsets, bytes);
+  std::vector<ref<ConstantExpr> > values;
+  bool success = solver->getValues(state, bytes, values);
+  if (!success) {
+    klee_warning("Solver timed out when getting values for external call, "
+                 "symbolic bytes of segment %lu will have random values",
+                 parent->getObject()->segment);
+  } else {
+    flushToConcreteStore(offsets.data(), values.data(), offsets.size());
+  }
+}
+
+void ObjectStatePlane::getSymbolicBytes(std::vector<unsigned> &offsets,
+                                        std::vector<ref<Expr> > &bytes) const {
+  knownSymbolics.forEach([&](size_t i, const ref<Expr> &) {
+    if (i >= concreteStore.size())
+      return;
+    offsets.push_back(i);
+    bytes.push_back(read8(i));
+  });
+}
+
+void ObjectStatePlane::flushToConcreteStore(const unsigned *offsets,
+                                            const ref<ConstantExpr> *values,
+                                            size_t count) {
+  for (size_t i = 0; i != count; ++i) {
+    uint8_t value;
+    values[i]->toMemory(&value);
+    concreteStore.set(offsets[i], value);
   }
 }
 
@@ -256,46 +333,50 @@ isByteConcrete(i) => !isByteKnownSymbolic(i)
 !isByteFlushed(i) => (isByteConcrete(i) || isByteKnownSymbolic(i))
  */
 
-void ObjectStatePlane::flushForRead() const {
-  // TODO: iterate only over the offsets for which we have information
-  // (SparseVector may be, well, sparse...)
-  for (unsigned offset = 0; offset < sizeBound; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-      }
+unsigned ObjectStatePlane::findNextUnflushed(unsigned offset) const {
+  if (offset < flushMask.size()) {
+    offset = flushMask.findFirstSet(offset);
+    if (offset < flushMask.size())
+      return offset;
+  }
+  // the bytes not covered by the mask are all flushed or all unflushed
+  return initialized ? std::min(offset, sizeBound) : sizeBound;
+}
 
-      markByteFlushed(offset);
+void ObjectStatePlane::flushForRead() const {
+  for (unsigned offset = findNextUnflushed(0); offset < sizeBound;
+       offset = findNextUnflushed(offset + 1)) {
+    if (isByteConcrete(offset)) {
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
+    } else {
+      assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     knownSymbolics[offset]);
     }
-  } 
+
+    markByteFlushed(offset);
+  }
 }
 
 void ObjectStatePlane::flushForWrite() {
-  for (unsigned offset = 0; offset < sizeBound; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
-        markByteSymbolic(offset);
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-        setKnownSymbolic(offset, 0);
-      }
-
-      markByteFlushed(offset);
+  for (unsigned offset = findNextUnflushed(0); offset < sizeBound;
+       offset = findNextUnflushed(offset + 1)) {
+    if (isByteConcrete(offset)) {
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     ConstantExpr::create(getConcreteValue(offset), Expr::Int8));
     } else {
-      // flushed bytes that are written over still need to be marked out
-      markByteSymbolic(offset);
-      setKnownSymbolic(offset, 0);
+      assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     knownSymbolics[offset]);
     }
   }
+
+  // Every byte is now symbolic and flushed, which is what empty masks of an
+  // uninitialized plane say.
+  concreteMask.resize(0);
+  flushMask.resize(0);
+  knownSymbolics.clear();
   initialized = false;
 }
 
@@ -362,6 +443,35 @@ uint8_t ObjectStatePlane::getConcreteValue(unsigned offset) const {
   return initialValue;
 }
 
+void ObjectStatePlane::getConcreteValues(unsigned offset, unsigned count,
+                                         uint8_t *dst) const {
+  unsigned stored = 0;
+  if (offset < concreteStore.size()) {
+    stored = std::min<size_t>(count, concreteStore.size() - offset);
+    concreteStore.copyTo(offset, stored, dst);
+  }
+  std::fill(dst + stored, dst + count, initialValue);
+}
+
+bool ObjectStatePlane::isRangeConcrete(unsigned offset, unsigned count) const {
+  unsigned end = offset + count;
+  unsigned masked = std::min(end, concreteMask.size());
+  if (masked < end && !initialized)
+    return false;
+  return offset >= masked || concreteMask.allSet(offset, masked);
+}
+
+bool ObjectStatePlane::isRangeConcreteUnflushed(unsigned offset,
+                                                unsigned count) const {
+  if (!isRangeConcrete(offset, count))
+    return false;
+  unsigned end = offset + count;
+  unsigned masked = std::min(end, flushMask.size());
+  if (masked < end && !initialized)
+    return false;
+  return offset >= masked || flushMask.allSet(offset, masked);
+}
+
 /***/
 
 ref<Expr> ObjectStatePlane::read8(unsigned offset) const {
@@ -412,7 +522,7 @@ void ObjectStatePlane::write8(unsigned offset, uint8_t value) {
     sizeBound = offset + 1;
   if (concreteStore.size() <= offset)
     concreteStore.resize(sizeBound, initialValue);
-  concreteStore[offset] = value;
+  concreteStore.set(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -482,9 +592,23 @@ ref<Expr> ObjectStatePlane::read(unsigned offset, Expr::Width width) const {
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid width for read size!");
+
+  // Fast path: all the bytes are concrete, build the constant directly.
+  if (NumBytes > 1 && NumBytes <= 16 && isRangeConcrete(offset, NumBytes)) {
+    uint8_t bytes[16];
+    getConcreteValues(offset, NumBytes, bytes);
+    uint64_t words[2] = {0, 0};
+    for (unsigned i = 0; i != NumBytes; ++i) {
+      unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+      words[i / 8] |= (uint64_t) bytes[idx] << (8 * (i % 8));
+    }
+    return ConstantExpr::alloc(
+        llvm::APInt(width, llvm::makeArrayRef(words, (NumBytes + 7) / 8)));
+  }
+
+  // Otherwise, follow the slow general case.
   ref<Expr> Res(0);
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
@@ -537,6 +661,17 @@ void ObjectStatePlane::write(unsigned offset, ref<Expr> value) {
       case Expr::Int64: write64(offset, val); return;
       }
     }
+    unsigned NumBytes = w / 8;
+    if (w == NumBytes * 8 && NumBytes <= 16) {
+      const llvm::APInt &val = CE->getAPValue();
+      uint8_t bytes[16];
+      for (unsigned i = 0; i != NumBytes; ++i) {
+        unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
+        bytes[idx] = (uint8_t) val.extractBits(8, 8 * i).getZExtValue();
+      }
+      writeConcrete(offset, bytes, NumBytes);
+      return;
+    }
   }
 
   // Treat bool specially, it is the only non-byte sized write we allow.
@@ -555,28 +690,49 @@ void ObjectStatePlane::write(unsigned offset, ref<Expr> value) {
   }
 } 
 
+void ObjectStatePlane::writeConcrete(unsigned offset, const uint8_t *bytes,
+                                     unsigned count) {
+  // Fast path: the bytes are concrete and not flushed yet, so neither the
+  // masks nor the known symbolics need to change.
+  if (offset + count <= sizeBound && isRangeConcreteUnflushed(offset, count)) {
+    if (concreteStore.size() < offset + count)
+      concreteStore.resize(sizeBound, initialValue);
+    concreteStore.copyFrom(offset, count, bytes);
+    return;
+  }
+
+  for (unsigned i = 0; i != count; ++i)
+    write8(offset + i, bytes[i]);
+}
+
 void ObjectStatePlane::write16(unsigned offset, uint16_t value) {
   unsigned NumBytes = 2;
+  uint8_t bytes[2];
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+    bytes[idx] = (uint8_t) (value >> (8 * i));
   }
+  writeConcrete(offset, bytes, NumBytes);
 }
 
 void ObjectStatePlane::write32(unsigned offset, uint32_t value) {
   unsigned NumBytes = 4;
+  uint8_t bytes[4];
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+    bytes[idx] = (uint8_t) (value >> (8 * i));
   }
+  writeConcrete(offset, bytes, NumBytes);
 }
 
 void ObjectStatePlane::write64(unsigned offset, uint64_t value) {
   unsigned NumBytes = 8;
+  uint8_t bytes[8];
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
-    write8(offset + idx, (uint8_t) (value >> (8 * i)));
+    bytes[idx] = (uint8_t) (value >> (8 * i));
   }
+  writeConcrete(offset, bytes, NumBytes);
 }
 
 void ObjectStatePlane::print() const {
@@ -633,8 +789,10 @@ ObjectState::ObjectState(const ObjectState &os)
     segmentPlane(0),
     offsetPlane(new ObjectStatePlane(this, *os.offsetPlane)) {
   object->refCount++;
-  if (os.segmentPlane)
+  if (os.segmentPlane) {
     segmentPlane = new ObjectStatePlane(this, *os.segmentPlane);
+    ++stats::segmentPlaneAllocations;
+  }
 }
 
 ObjectState::ObjectState(const ObjectState &os, const MemoryObject *mo)
@@ -659,43 +817,44 @@ ObjectState::~ObjectState() {
   }
 }
 
+ref<Expr> ObjectState::getValuesSegment(Expr::Width width) {
+  // Most objects never hold a pointer, so share the segment constants
+  // returned for them instead of allocating a new one on every read.
+  static ref<Expr> segments[Expr::Int64 + 1];
+  if (width > Expr::Int64)
+    return ConstantExpr::alloc(VALUES_SEGMENT, width);
+  ref<Expr> &segment = segments[width];
+  if (segment.isNull())
+    segment = ConstantExpr::alloc(VALUES_SEGMENT, width);
+  return segment;
+}
+
 KValue ObjectState::read8(unsigned offset) const {
-  ref<Expr> segment;
-  if (segmentPlane) {
-    segment = segmentPlane->read8(offset);
-  } else {
-    segment = ConstantExpr::alloc(0, Expr::Int8);
-  }
   ref<Expr> value = offsetPlane->read8(offset);
-  return KValue(segment, value);
+  if (!segmentPlane)
+    return KValue(getValuesSegment(Expr::Int8), value);
+  return KValue(segmentPlane->read8(offset), value);
 }
 
 KValue ObjectState::read(unsigned offset, Expr::Width width) const {
-  ref<Expr> segment;
-  if (segmentPlane) {
-    segment = segmentPlane->read(offset, width);
-  } else {
-    segment = ConstantExpr::alloc(0, width);
-  }
   ref<Expr> value = offsetPlane->read(offset, width);
-  return KValue(segment, value);
+  if (!segmentPlane)
+    return KValue(getValuesSegment(width), value);
+  return KValue(segmentPlane->read(offset, width), value);
 }
 
 KValue ObjectState::read(ref<Expr> offset, Expr::Width width) const {
-  ref<Expr> segment;
-  if (segmentPlane) {
-    segment = segmentPlane->read(offset, width);
-  } else {
-    segment = ConstantExpr::alloc(0, width);
-  }
   ref<Expr> value = offsetPlane->read(offset, width);
-  return KValue(segment, value);
+  if (!segmentPlane)
+    return KValue(getValuesSegment(width), value);
+  return KValue(segmentPlane->read(offset, width), value);
 }
 
 bool ObjectState::prepareSegmentPlane(bool nonzero) {
   if (!segmentPlane) {
     if (nonzero) {
       segmentPlane = new ObjectStatePlane(this);
+      ++stats::segmentPlaneAllocations;
       return true;
     }
     return false;
@@ -15,12 +15,15 @@
 
 #include "klee/KValue.h"
 #include "klee/util/BitArray.h"
+#include "klee/util/ChunkedArray.h"
 
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringExtras.h"
 
+#include <algorithm>
+#include <new>
+#include <memory>
 #include <vector>
-#include <unordered_map>
 #include <string>
 #include <vector>
 
@@ -39,11 +42,16 @@ class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend class MemoryManager;
 
 private:
   static int counter;
   mutable unsigned refCount;
 
+  // neighbours in the list of objects owned by the MemoryManager
+  MemoryObject *prevAllocated = nullptr;
+  MemoryObject *nextAllocated = nullptr;
+
 public:
   unsigned id;
   uint64_t segment;
@@ -132,6 +140,10 @@ public:
 
   ~MemoryObject();
 
+  // allocated from a pool, see getObjectPoolUsage()
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -211,62 +223,171 @@ private:
   }
 };
 
-// up to some offset this container is implemented
-// as a vector and from some offset as a map
-// (leveraging the assumption that large offsets will
-// be sparse). Threshold is the maximal number of elements
-// in the vector.
+// A two-level radix table: the index is split into the index of a chunk
+// of ChunkSize elements and the position in that chunk. Only the chunks
+// that hold some element are allocated and they are shared between copies
+// of the table until one of the copies modifies them, so copying the
+// table is cheap. Unset elements are null.
+// A chunk is a single allocation which ends at the size the table was
+// created for, so the table of a small object costs a few elements rather
+// than a whole chunk.
 // This class is specialized for our needs, it is not generic...
-template <typename T, const size_t Threshold = (1 << 18)>
+template <typename T, const size_t ChunkSize = 256>
 class SparseVector {
-    std::vector<T> _vector;
-    std::unordered_map<size_t, T> _map;
+    /// A reference counted header followed by the elements of the chunk.
+    struct Chunk {
+        size_t refCount;
+        size_t length;
+        // number of non-null elements
+        size_t count;
+
+        T *elements() { return reinterpret_cast<T *>(this + 1); }
+        const T *elements() const {
+            return reinterpret_cast<const T *>(this + 1);
+        }
+
+        // copies the elements of from, if any, the rest are null
+        static Chunk *create(size_t length, const Chunk *from = nullptr) {
+            static_assert(alignof(T) <= alignof(Chunk),
+                          "elements are not aligned");
+            Chunk *chunk = static_cast<Chunk *>(
+                ::operator new(sizeof(Chunk) + length * sizeof(T)));
+            chunk->refCount = 1;
+            chunk->length = length;
+            chunk->count = from ? from->count : 0;
+            size_t i = 0;
+            if (from)
+                for (; i < from->length; ++i)
+                    new (&chunk->elements()[i]) T(from->elements()[i]);
+            for (; i < length; ++i)
+                new (&chunk->elements()[i]) T();
+            return chunk;
+        }
+
+        static void release(Chunk *chunk) {
+            if (!chunk || --chunk->refCount != 0)
+                return;
+            for (size_t i = 0; i < chunk->length; ++i)
+                chunk->elements()[i].~T();
+            ::operator delete(chunk);
+        }
+    };
+
+    std::vector<Chunk *> _chunks;
+    // number of non-null elements
+    size_t _count = 0;
+    // the size the table was created for, 0 if unknown
+    size_t _size;
+
+    // the length of chunk c when it is created
+    size_t chunkLength(size_t c) const {
+        if (_size <= c * ChunkSize)
+            return ChunkSize;
+        return std::min(ChunkSize, _size - c * ChunkSize);
+    }
+
+    // returns chunk c, owned by this table and holding position i
+    Chunk &getWriteableChunk(size_t c, size_t i) {
+        Chunk *&chunk = _chunks[c];
+        if (!chunk) {
+            chunk = Chunk::create(std::max(chunkLength(c), i + 1));
+        } else if (chunk->refCount > 1 || chunk->length <= i) {
+            // an index past the size the table was created for grows the
+            // chunk to its full length
+            Chunk *copy = Chunk::create(
+                chunk->length <= i ? ChunkSize : chunk->length, chunk);
+            Chunk::release(chunk);
+            chunk = copy;
+        }
+        return *chunk;
+    }
 
 public:
+    /// Creates a table for the indices below \a size, which may still
+    /// grow beyond it.
+    explicit SparseVector(size_t size = 0) : _size(size) {}
+
+    SparseVector(const SparseVector &other)
+        : _chunks(other._chunks), _count(other._count), _size(other._size) {
+        for (Chunk *chunk : _chunks)
+            if (chunk)
+                ++chunk->refCount;
+    }
+
+    SparseVector &operator=(SparseVector other) {
+        std::swap(_chunks, other._chunks);
+        std::swap(_count, other._count);
+        std::swap(_size, other._size);
+        return *this;
+    }
+
+    ~SparseVector() { clear(); }
+
     const T& operator[](size_t n) const {
-        if (n < Threshold) {
-            assert(n < _vector.size());
-            assert(_vector[n].get() != nullptr && "Use has() before");
-            return _vector[n];
-        } else {
-            auto it = _map.find(n);
-            if (it == _map.end()) {
-                assert(false && "Cannot happen, must use has() before");
-                abort();
-            }
-            assert(it->second.get() != nullptr);
-            return it->second;
-        }
+        assert(has(n) && "Use has() before");
+        return _chunks[n / ChunkSize]->elements()[n % ChunkSize];
     }
 
     void set(size_t n, const T& val) {
-        if (n < Threshold) {
-            if (_vector.size() <= n) {
-              if (val.get() == nullptr) {
+        size_t c = n / ChunkSize;
+        if (val.get() == nullptr) {
+            // clearing an element that is already null must not clone a
+            // shared chunk, nor must dropping the last element of one
+            if (!has(n))
+                return;
+            if (_chunks[c]->count == 1) {
+                Chunk::release(_chunks[c]);
+                _chunks[c] = nullptr;
+                --_count;
                 return;
-              }
-              // make sure the access will be valid
-              _vector.resize(n + 1);
             }
+        } else if (_chunks.size() <= c) {
+            // make sure the access will be valid
+            _chunks.resize(c + 1, nullptr);
+        }
 
-            assert(_vector.size() > n);
-            _vector[n] = val;
-        } else {
-            if (val.get() == nullptr) {
-                _map.erase(n);
-            } else
-                _map[n] = val;
+        Chunk &chunk = getWriteableChunk(c, n % ChunkSize);
+        T &elem = chunk.elements()[n % ChunkSize];
+        if (elem.get() == nullptr) {
+            ++chunk.count;
+            ++_count;
+        } else if (val.get() == nullptr) {
+            --chunk.count;
+            --_count;
         }
+        elem = val;
     }
 
     void clear() {
-        _vector.clear();
-        _map.clear();
+        for (Chunk *chunk : _chunks)
+            Chunk::release(chunk);
+        _chunks.clear();
+        _count = 0;
     }
 
     bool has(size_t n) const {
-        return (_vector.size() > n && _vector[n].get())
-               || (_map.find(n) != _map.end());
+        size_t c = n / ChunkSize;
+        if (_chunks.size() <= c || !_chunks[c])
+            return false;
+        const Chunk *chunk = _chunks[c];
+        return n % ChunkSize < chunk->length &&
+               chunk->elements()[n % ChunkSize].get();
+    }
+
+    size_t size() const { return _count; }
+    bool empty() const { return _count == 0; }
+
+    /// Calls \a f(n, element) for every non-null element in the order of
+    /// increasing indices, skipping the chunks that hold no elements.
+    template <typename F> void forEach(F f) const {
+        for (size_t c = 0; c < _chunks.size(); ++c) {
+            const Chunk *chunk = _chunks[c];
+            if (!chunk)
+                continue;
+            for (size_t i = 0; i < chunk->length; ++i)
+                if (chunk->elements()[i].get())
+                    f(c * ChunkSize + i, chunk->elements()[i]);
+        }
     }
 };
 
@@ -276,7 +397,7 @@ private:
 
   const ObjectState *parent;
 
-  std::vector<uint8_t> concreteStore;
+  ChunkedArray<uint8_t> concreteStore;
 
   // XXX cleanup name of flushMask (its backwards or something)
   BitArray concreteMask;
@@ -310,6 +431,9 @@ public:
   ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os);
   ~ObjectStatePlane();
 
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
+
   // make contents all concrete and zero
   void initializeToZero();
   // make contents all concrete and random
@@ -336,6 +460,21 @@ public:
   void flushToConcreteStore(TimingSolver *solver,
                             const ExecutionState &state);
 
+  /*
+    Appends the offsets of the symbolic bytes of this object and their
+    values to offsets and bytes, for flushing them together with other
+    expressions.
+  */
+  void getSymbolicBytes(std::vector<unsigned> &offsets,
+                        std::vector<ref<Expr> > &bytes) const;
+
+  /*
+    Puts the values of count symbolic bytes at the given offsets, as
+    returned by getSymbolicBytes, in the concreteStore.
+  */
+  void flushToConcreteStore(const unsigned *offsets,
+                            const ref<ConstantExpr> *values, size_t count);
+
 private:
   const UpdateList &getUpdates() const;
 
@@ -345,6 +484,8 @@ private:
   void write8(unsigned offset, ref<Expr> value);
   void write8(ref<Expr> offset, ref<Expr> value);
 
+  // first unflushed byte at or after offset, sizeBound if there is none
+  unsigned findNextUnflushed(unsigned offset) const;
   void flushForRead() const;
   void flushForWrite();
 
@@ -358,6 +499,15 @@ private:
   void markByteUnflushed(unsigned offset) const;
   void setKnownSymbolic(unsigned offset, Expr *value);
   uint8_t getConcreteValue(unsigned offset) const;
+  void getConcreteValues(unsigned offset, unsigned count, uint8_t *dst) const;
+
+  // whether all bytes in [offset, offset + count) are concrete
+  bool isRangeConcrete(unsigned offset, unsigned count) const;
+  // whether all bytes in [offset, offset + count) are concrete and unflushed,
+  // i.e. they can be overwritten in the concrete store only
+  bool isRangeConcreteUnflushed(unsigned offset, unsigned count) const;
+
+  void writeConcrete(unsigned offset, const uint8_t *bytes, unsigned count);
 };
 
 class ObjectState {
@@ -375,6 +525,10 @@ public:
   bool readOnly;
 
 private:
+  /// Segments of the stored bytes. Null as long as only values (bytes of
+  /// VALUES_SEGMENT) were stored into the object, in which case reads
+  /// return the VALUES_SEGMENT constant without consulting any plane. The
+  /// plane is created on the first store of a non-zero or symbolic segment.
   ObjectStatePlane *segmentPlane;
   ObjectStatePlane *offsetPlane;
 
@@ -393,6 +547,9 @@ public:
   ObjectState(const ObjectState &os, const MemoryObject *mo);
   ~ObjectState();
 
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
+
   const MemoryObject *getObject() const { return object; }
 
   void setReadOnly(bool ro) {
@@ -414,6 +571,17 @@ public:
     offsetPlane->flushToConcreteStore(solver, state);
   }
 
+  void getSymbolicBytes(std::vector<unsigned> &offsets,
+                        std::vector<ref<Expr> > &bytes) const {
+    offsetPlane->getSymbolicBytes(offsets, bytes);
+  }
+
+  void flushToConcreteStore(const unsigned *offsets,
+                            const ref<ConstantExpr> *values,
+                            size_t count) const {
+    offsetPlane->flushToConcreteStore(offsets, values, count);
+  }
+
   KValue read(ref<Expr> offset, Expr::Width width) const;
   KValue read(unsigned offset, Expr::Width width) const;
   KValue read8(unsigned offset) const;
@@ -430,10 +598,16 @@ public:
   ArrayCache *getArrayCache() const;
 
 private:
+  static ref<Expr> getValuesSegment(Expr::Width width);
+
   bool prepareSegmentPlane(bool nonzero);
   bool prepareSegmentPlane(ref<Expr> value);
 };
   
+/// Returns the number of bytes reserved by the pools that MemoryObjects,
+/// ObjectStates and ObjectStatePlanes are allocated from.
+size_t getObjectPoolUsage();
+
 } // End klee namespace
 
 #endif /* KLEE_MEMORY_H */
@@ -236,9 +236,9 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache, unsigned pointerWidth)
       lastSegment(FIRST_ORDINARY_SEGMENT) {}
 
 MemoryManager::~MemoryManager() {
-  while (!objects.empty()) {
-    MemoryObject *mo = *objects.begin();
-    objects.erase(mo);
+  while (objects) {
+    MemoryObject *mo = objects;
+    markFreed(mo);
     delete mo;
   }
 }
@@ -291,7 +291,7 @@ MemoryObject *MemoryManager::allocate(ref<Expr> size, bool isLocal,
   MemoryObject *res = new MemoryObject(++lastSegment,
                                        size, concreteSize,
                                        isLocal, isGlobal, false, allocSite, this);
-  objects.insert(res);
+  markAllocated(res);
   return res;
 }
 
@@ -310,14 +310,30 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t size,
         new MemoryObject(specialSegment, sizeExpr, size,
                          false, true, true, allocSite, this);
   }
-  objects.insert(res);
+  markAllocated(res);
   return res;
 }
 
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
+void MemoryManager::markAllocated(MemoryObject *mo) {
+  mo->prevAllocated = nullptr;
+  mo->nextAllocated = objects;
+  if (objects)
+    objects->prevAllocated = mo;
+  objects = mo;
+}
+
 void MemoryManager::markFreed(MemoryObject *mo) {
-  objects.erase(mo);
+  if (mo->prevAllocated)
+    mo->prevAllocated->nextAllocated = mo->nextAllocated;
+  else if (objects == mo)
+    objects = mo->nextAllocated;
+  else
+    return; // not in the list
+  if (mo->nextAllocated)
+    mo->nextAllocated->prevAllocated = mo->prevAllocated;
+  mo->prevAllocated = mo->nextAllocated = nullptr;
 }
 
 size_t MemoryManager::getUsedDeterministicSize() const {
@@ -11,7 +11,6 @@
 #define KLEE_MEMORYMANAGER_H
 
 #include <cstddef>
-#include <set>
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
@@ -100,12 +99,14 @@ public:
 
 class MemoryManager {
 private:
-  typedef std::set<MemoryObject *> objects_ty;
-  objects_ty objects;
+  // intrusive list of the objects that were not freed yet
+  MemoryObject *objects = nullptr;
   ArrayCache *const arrayCache;
 
   MemoryAllocator allocator;
   uint64_t lastSegment;
+  void markAllocated(MemoryObject *mo);
+
 public:
   MemoryManager(ArrayCache *arrayCache,
                 unsigned pointerWidth = 64);
@@ -25,13 +25,16 @@
 #include "klee/Internal/Support/ModuleUtil.h"
 #include "klee/Internal/System/Time.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
 #include <cassert>
+#include <deque>
 #include <fstream>
 #include <climits>
 
@@ -52,6 +55,12 @@ ExecutionState &DFSSearcher::selectState() {
   return *states.back();
 }
 
+void DFSSearcher::getUpcomingStates(std::vector<ExecutionState *> &result,
+                                    unsigned n) {
+  for (auto it = states.rbegin(), ie = states.rend(); it != ie && n; ++it, --n)
+    result.push_back(*it);
+}
+
 void DFSSearcher::update(ExecutionState *current,
                          const std::vector<ExecutionState *> &addedStates,
                          const std::vector<ExecutionState *> &removedStates) {
@@ -88,6 +97,12 @@ ExecutionState &BFSSearcher::selectState() {
   return *states.front();
 }
 
+void BFSSearcher::getUpcomingStates(std::vector<ExecutionState *> &result,
+                                    unsigned n) {
+  for (auto it = states.begin(), ie = states.end(); it != ie && n; ++it, --n)
+    result.push_back(*it);
+}
+
 void BFSSearcher::update(ExecutionState *current,
                          const std::vector<ExecutionState *> &addedStates,
                          const std::vector<ExecutionState *> &removedStates) {
@@ -135,6 +150,13 @@ ExecutionState &RandomSearcher::selectState() {
   return *states[theRNG.getInt32()%states.size()];
 }
 
+void RandomSearcher::getUpcomingStates(std::vector<ExecutionState *> &result,
+                                       unsigned n) {
+  // every state is as likely to be selected as any other
+  for (auto it = states.begin(), ie = states.end(); it != ie && n; ++it, --n)
+    result.push_back(*it);
+}
+
 void
 RandomSearcher::update(ExecutionState *current,
                        const std::vector<ExecutionState *> &addedStates,
@@ -254,6 +276,21 @@ bool WeightedRandomSearcher::empty() {
   return states->empty(); 
 }
 
+void WeightedRandomSearcher::getUpcomingStates(
+    std::vector<ExecutionState *> &result, unsigned n) {
+  if (states->empty())
+    return;
+  // the states at evenly spaced points of the distribution, so heavier
+  // states are more likely among them. Drawing from theRNG instead would
+  // change which states are selected.
+  size_t begin = result.size();
+  for (unsigned i = 0; i != n; ++i) {
+    ExecutionState *es = states->choose((i + .5) / n);
+    if (std::find(result.begin() + begin, result.end(), es) == result.end())
+      result.push_back(es);
+  }
+}
+
 ///
 RandomPathSearcher::RandomPathSearcher(Executor &_executor)
   : executor(_executor) {
@@ -293,6 +330,249 @@ bool RandomPathSearcher::empty() {
   return executor.states.empty(); 
 }
 
+void RandomPathSearcher::getUpcomingStates(
+    std::vector<ExecutionState *> &result, unsigned n) {
+  // a state is selected with probability 2^-k, k being the number of nodes
+  // with two children on its path, so the states are collected breadth-first
+  // by k
+  std::deque<PTreeNode *> queue(1, executor.processTree->root.get());
+  while (!queue.empty() && n) {
+    PTreeNode *node = queue.front();
+    queue.pop_front();
+    if (node->state) {
+      result.push_back(node->state);
+      --n;
+    } else if (!node->left) {
+      queue.push_front(node->right.get());
+    } else if (!node->right) {
+      queue.push_front(node->left.get());
+    } else {
+      queue.push_back(node->left.get());
+      queue.push_back(node->right.get());
+    }
+  }
+}
+
+///
+
+// the distance of states which can not reach a violation node, or their
+// next edges
+static const unsigned Unreachable = UINT_MAX;
+
+// the target set of nodes without edges leading closer
+static const unsigned NoTargets = UINT_MAX;
+
+// the number of CFG distance tables the witness searcher keeps
+static const unsigned MaxCFGDistanceTables = 32;
+
+WitnessSearcher::WitnessSearcher(Executor &_executor)
+    : executor(_executor), cfgDistanceUses(0), nextOrder(0) {
+  const WitnessAutomaton &witness = executor.witness;
+  unsigned numNodes = witness.get_nodes_number();
+  distances.assign(numNodes, Unreachable);
+
+  // breadth-first from the violation nodes back over the edges, which do
+  // not leave sinks
+  std::vector<std::vector<unsigned> > predecessors(numNodes);
+  std::deque<unsigned> queue;
+  for (unsigned n = 0; n != numNodes; ++n) {
+    const WitnessNode &node = witness.get_node(n);
+    if (node.violation) {
+      distances[n] = 0;
+      queue.push_back(n);
+    }
+    if (node.sink)
+      continue;
+    for (unsigned e = node.edges_begin; e != node.edges_end; ++e)
+      predecessors[witness.get_edge(e).target].push_back(n);
+  }
+  while (!queue.empty()) {
+    unsigned n = queue.front();
+    queue.pop_front();
+    for (unsigned p : predecessors[n]) {
+      if (distances[p] != Unreachable)
+        continue;
+      distances[p] = distances[n] + 1;
+      queue.push_back(p);
+    }
+  }
+
+  // nodes whose edges leading closer match the same code share a table
+  std::map<std::vector<Target>, unsigned> targetSetIds;
+  nodeTargets.assign(numNodes, NoTargets);
+  for (unsigned n = 0; n != numNodes; ++n) {
+    const WitnessNode &node = witness.get_node(n);
+    std::vector<Target> targets;
+    for (unsigned e = node.edges_begin; e != node.edges_end; ++e) {
+      const WitnessEdge &edge = witness.get_edge(e);
+      if (distances[edge.target] + 1 != distances[n])
+        continue;
+      if (!edge.retFromFunc.empty())
+        targets.emplace_back(edge.retFromFunc, 0, 0);
+      else
+        targets.emplace_back("", edge.startline,
+                             std::max(edge.startline, edge.endline));
+    }
+    if (targets.empty())
+      continue;
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    auto inserted = targetSetIds.emplace(targets, targetSets.size());
+    if (inserted.second)
+      targetSets.push_back(std::move(targets));
+    nodeTargets[n] = inserted.first->second;
+  }
+
+  // the interprocedural CFG of the module: into the functions called
+  // directly and, as the stack is not known, from a return back to every
+  // direct call of the function
+  const InstructionInfoTable &infos = *executor.kmodule->infos;
+  instructions.assign(infos.getMaxID(), nullptr);
+  for (auto &kf : executor.kmodule->functions)
+    for (unsigned i = 0; i != kf->numInstructions; ++i)
+      instructions[kf->instructions[i]->info->id] = kf->instructions[i]->inst;
+  cfgPredecessors.resize(instructions.size());
+  for (unsigned id = 0, e = instructions.size(); id != e; ++id) {
+    const llvm::Instruction *i = instructions[id];
+    if (!i)
+      continue;
+    auto addEdge = [&](const llvm::Instruction *succ) {
+      cfgPredecessors[infos.getInfo(*succ).id].push_back(id);
+    };
+    const BasicBlock *bb = i->getParent();
+    if (isa<ReturnInst>(i)) {
+      const Function *f = bb->getParent();
+      for (const llvm::User *user : f->users())
+        if (const CallInst *ci = dyn_cast<CallInst>(user))
+          if (ci->getCalledFunction() == f)
+            addEdge(&*std::next(ci->getIterator()));
+    } else if (i == bb->getTerminator()) {
+      for (const BasicBlock *succ : successors(bb))
+        addEdge(&succ->front());
+    } else {
+      if (const CallInst *ci = dyn_cast<CallInst>(i))
+        if (const Function *f = ci->getCalledFunction())
+          if (!f->isDeclaration())
+            addEdge(&f->getEntryBlock().front());
+      addEdge(&*std::next(i->getIterator()));
+    }
+  }
+}
+
+unsigned WitnessSearcher::getCFGDistance(unsigned node, unsigned id) {
+  if (nodeTargets[node] == NoTargets)
+    return Unreachable;
+  CFGDistances &table = cfgDistances[nodeTargets[node]];
+  table.lastUse = ++cfgDistanceUses;
+  std::vector<unsigned> &result = table.distances;
+  if (!result.empty())
+    return result[id];
+  result.assign(instructions.size(), Unreachable);
+
+  const std::vector<Target> &targets = targetSets[nodeTargets[node]];
+  auto isNext = [&](const llvm::Instruction *i) {
+    long line = executor.kmodule->infos->getInfo(*i).line;
+    for (const Target &target : targets) {
+      const std::string &retFromFunc = std::get<0>(target);
+      if (!retFromFunc.empty()) {
+        if (isa<ReturnInst>(i) &&
+            i->getParent()->getParent()->getName() == retFromFunc)
+          return true;
+      } else if (std::get<1>(target) == 0 ||
+                 (line >= std::get<1>(target) && line <= std::get<2>(target))) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // breadth-first from the instructions matching the edges back over the
+  // reversed CFG
+  std::deque<unsigned> queue;
+  for (unsigned i = 0, e = instructions.size(); i != e; ++i)
+    if (instructions[i] && isNext(instructions[i])) {
+      result[i] = 0;
+      queue.push_back(i);
+    }
+  while (!queue.empty()) {
+    unsigned i = queue.front();
+    queue.pop_front();
+    for (unsigned pred : cfgPredecessors[i]) {
+      if (result[pred] != Unreachable)
+        continue;
+      result[pred] = result[i] + 1;
+      queue.push_back(pred);
+    }
+  }
+  unsigned distance = result[id];
+
+  // a table takes as much memory as the module has instructions, so the
+  // ones used least recently are dropped
+  if (cfgDistances.size() > MaxCFGDistanceTables) {
+    auto oldest = std::min_element(
+        cfgDistances.begin(), cfgDistances.end(),
+        [](const std::pair<const unsigned, CFGDistances> &a,
+           const std::pair<const unsigned, CFGDistances> &b) {
+          return a.second.lastUse < b.second.lastUse;
+        });
+    cfgDistances.erase(oldest);
+  }
+  return distance;
+}
+
+void WitnessSearcher::rank(ExecutionState *es, uint64_t order) {
+  Rank r;
+  r.witnessDistance = Unreachable;
+  r.cfgDistance = Unreachable;
+  r.order = order;
+  for (unsigned n : es->witnessNode)
+    r.witnessDistance = std::min(r.witnessDistance, distances[n]);
+  if (r.witnessDistance != Unreachable && r.witnessDistance != 0)
+    for (unsigned n : es->witnessNode)
+      if (distances[n] == r.witnessDistance)
+        r.cfgDistance =
+            std::min(r.cfgDistance, getCFGDistance(n, es->pc->info->id));
+
+  auto it = ranks.find(es);
+  if (it != ranks.end()) {
+    states.erase(it->second);
+    it->second = r;
+  } else {
+    ranks.insert(std::make_pair(es, r));
+  }
+  states.insert(std::make_pair(r, es));
+}
+
+ExecutionState &WitnessSearcher::selectState() {
+  return *states.begin()->second;
+}
+
+void WitnessSearcher::getUpcomingStates(std::vector<ExecutionState *> &result,
+                                        unsigned n) {
+  for (auto it = states.begin(), ie = states.end(); it != ie && n; ++it, --n)
+    result.push_back(it->second);
+}
+
+void WitnessSearcher::update(ExecutionState *current,
+                             const std::vector<ExecutionState *> &addedStates,
+                             const std::vector<ExecutionState *> &removedStates) {
+  // the current state has moved, its nodes may have changed
+  if (current && ranks.count(current) &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+          removedStates.end())
+    rank(current, ranks[current].order);
+
+  for (ExecutionState *es : addedStates)
+    rank(es, nextOrder++);
+
+  for (ExecutionState *es : removedStates) {
+    auto it = ranks.find(es);
+    assert(it != ranks.end() && "invalid state removed");
+    states.erase(it->second);
+    ranks.erase(it);
+  }
+}
+
 ///
 
 MergingSearcher::MergingSearcher(Executor &_executor, Searcher *_baseSearcher)
@@ -456,6 +736,33 @@ ExecutionState &InterleavedSearcher::selectState() {
   return s->selectState();
 }
 
+void InterleavedSearcher::getUpcomingStates(
+    std::vector<ExecutionState *> &result, unsigned n) {
+  // the searchers take turns, so their upcoming states are interleaved
+  // starting with the searcher whose turn is next
+  std::vector<std::vector<ExecutionState *> > upcoming(searchers.size());
+  for (unsigned i = 0; i != searchers.size(); ++i)
+    searchers[(index + searchers.size() - 1 - i) % searchers.size()]
+        ->getUpcomingStates(upcoming[i], n);
+
+  size_t begin = result.size();
+  for (unsigned j = 0; n; ++j) {
+    bool more = false;
+    for (unsigned i = 0; i != upcoming.size() && n; ++i) {
+      if (j >= upcoming[i].size())
+        continue;
+      more = true;
+      ExecutionState *es = upcoming[i][j];
+      if (std::find(result.begin() + begin, result.end(), es) != result.end())
+        continue;
+      result.push_back(es);
+      --n;
+    }
+    if (!more)
+      break;
+  }
+}
+
 void InterleavedSearcher::update(
     ExecutionState *current, const std::vector<ExecutionState *> &addedStates,
     const std::vector<ExecutionState *> &removedStates) {
@@ -17,6 +17,8 @@
 #include <map>
 #include <queue>
 #include <set>
+#include <string>
+#include <tuple>
 #include <vector>
 
 namespace llvm {
@@ -43,6 +45,13 @@ namespace klee {
 
     virtual bool empty() = 0;
 
+    /// Appends to \a result up to \a n states in the order in which they
+    /// are likely to be selected, assuming no states are added or removed.
+    /// Randomized searchers add the states most likely to be selected.
+    /// Searchers which can't tell add none.
+    virtual void getUpcomingStates(std::vector<ExecutionState *> &result,
+                                   unsigned n) {}
+
     // prints name of searcher as a klee_message()
     // TODO: could probably make prettier or more flexible
     virtual void printName(llvm::raw_ostream &os) {
@@ -79,7 +88,8 @@ namespace klee {
       NURS_Depth,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      Witness
     };
   };
 
@@ -92,6 +102,8 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return states.empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n);
     void printName(llvm::raw_ostream &os) {
       os << "DFSSearcher\n";
     }
@@ -106,6 +118,8 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return states.empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n);
     void printName(llvm::raw_ostream &os) {
       os << "BFSSearcher\n";
     }
@@ -120,6 +134,8 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return states.empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n);
     void printName(llvm::raw_ostream &os) {
       os << "RandomSearcher\n";
     }
@@ -152,6 +168,8 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty();
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n);
     void printName(llvm::raw_ostream &os) {
       os << "WeightedRandomSearcher::";
       switch(type) {
@@ -178,11 +196,79 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty();
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n);
     void printName(llvm::raw_ostream &os) {
       os << "RandomPathSearcher\n";
     }
   };
 
+  /// WitnessSearcher - Selects the state closest to confirming the witness:
+  /// first by the least number of witness edges between its nodes and a
+  /// violation node, then by the number of instructions from its pc, also
+  /// through calls and returns, to an instruction which can match an edge
+  /// leading closer. States which can
+  /// not reach a violation node, such as those only in sinks or in nodes
+  /// whose paths all end in sinks, come last. Ties go to the state added
+  /// last.
+  class WitnessSearcher : public Searcher {
+    struct Rank {
+      unsigned witnessDistance;
+      unsigned cfgDistance;
+      uint64_t order;
+
+      bool operator<(const Rank &other) const {
+        if (witnessDistance != other.witnessDistance)
+          return witnessDistance < other.witnessDistance;
+        if (cfgDistance != other.cfgDistance)
+          return cfgDistance < other.cfgDistance;
+        return order > other.order;
+      }
+    };
+
+    Executor &executor;
+    // the distance of each witness node to a violation node
+    std::vector<unsigned> distances;
+    std::map<Rank, ExecutionState *> states;
+    std::map<ExecutionState *, Rank> ranks;
+    // the instructions of the module by their id, and the instructions
+    // each one can be reached from in one step
+    std::vector<const llvm::Instruction *> instructions;
+    std::vector<std::vector<unsigned> > cfgPredecessors;
+    // what an edge must match: the function it returns from, or its lines
+    typedef std::tuple<std::string, long, long> Target;
+    // the distinct sets of targets of the edges leading closer, and the
+    // index of the set of each node
+    std::vector<std::vector<Target> > targetSets;
+    std::vector<unsigned> nodeTargets;
+    // the CFG distance from each instruction to a set of targets, computed
+    // when first needed. Only the tables used last are kept.
+    struct CFGDistances {
+      std::vector<unsigned> distances;
+      uint64_t lastUse;
+    };
+    std::map<unsigned, CFGDistances> cfgDistances;
+    uint64_t cfgDistanceUses;
+    uint64_t nextOrder;
+
+    unsigned getCFGDistance(unsigned node, unsigned id);
+    void rank(ExecutionState *es, uint64_t order);
+
+  public:
+    explicit WitnessSearcher(Executor &executor);
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const std::vector<ExecutionState *> &addedStates,
+                const std::vector<ExecutionState *> &removedStates);
+    bool empty() { return states.empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n);
+    void printName(llvm::raw_ostream &os) {
+      os << "WitnessSearcher\n";
+    }
+  };
+
   class MergeHandler;
   class MergingSearcher : public Searcher {
     friend class MergeHandler;
@@ -204,6 +290,10 @@ namespace klee {
       baseSearcher->update(current, addedStates, removedStates);
     }
     bool empty() { return baseSearcher->empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n) {
+      baseSearcher->getUpcomingStates(result, n);
+    }
     void printName(llvm::raw_ostream &os) {
       os << "MergingSearcher\n";
     }
@@ -229,6 +319,10 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n) {
+      baseSearcher->getUpcomingStates(result, n);
+    }
     void printName(llvm::raw_ostream &os) {
       os << "<BatchingSearcher> timeBudget: " << timeBudget
          << ", instructionBudget: " << instructionBudget
@@ -253,6 +347,10 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return baseSearcher->empty() && pausedStates.empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n) {
+      baseSearcher->getUpcomingStates(result, n);
+    }
     void printName(llvm::raw_ostream &os) {
       os << "IterativeDeepeningTimeSearcher\n";
     }
@@ -273,6 +371,8 @@ namespace klee {
                 const std::vector<ExecutionState *> &addedStates,
                 const std::vector<ExecutionState *> &removedStates);
     bool empty() { return searchers[0]->empty(); }
+    void getUpcomingStates(std::vector<ExecutionState *> &result,
+                           unsigned n);
     void printName(llvm::raw_ostream &os) {
       os << "<InterleavedSearcher> containing "
          << searchers.size() << " searchers:\n";
@@ -892,7 +892,7 @@ void SpecialFunctionHandler::handleDefineFixedObject(ExecutionState &state,
 
   MemoryObject *mo = executor.memory->allocateFixed(size, state.prevPC->inst);
   executor.bindObjectInState(state, mo, false);
-  state.addressSpace.concreteAddressMap.insert({address, mo->segment});
+  state.addressSpace.concreteAddressMap.insert(address, mo->segment);
   state.addressSpace.segmentMap.insert(std::make_pair(mo->segment, mo));
   mo->isUserSpecified = true; // XXX hack;
 }
@@ -1017,7 +1017,7 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
 
   if (!state.replayEdges.empty()) {
 
-    WitnessEdge edge = **(state.replayEdges.begin());
+    const WitnessEdge &edge = executor.witness.get_edge(*state.replayEdges.begin());
     auto *info = target->info;
 
     if (edge.assumResFunc == name &&
@@ -1049,7 +1049,7 @@ void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
           }
       }
       state.replayEdges.clear();
-      state.witnessNodeNext.emplace(*(edge.target.lock()));
+      state.witnessNodeNext.insert(edge.target);
     } else {
       klee_warning("Did not match nondet value for: %s:%lu, using using nondet value",
                    edge.assumResFunc.c_str(),edge.startline);
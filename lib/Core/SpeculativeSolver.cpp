@@ -0,0 +1,420 @@
+//===-- SpeculativeSolver.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "SpeculativeSolver.h"
+
+#include "CoreStats.h"
+#include "TimingSolver.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace klee {
+/// Answers the queries of a speculated evaluation replayed through the main
+/// solver chain from the models the worker found, and passes all other
+/// queries on to the core solver.
+///
+/// While a result is replayed, every query reaching the core solver is
+/// derived from the branch condition and the constraints of the state: it
+/// is a subset of the constraints, possibly with the condition or its
+/// negation. Such a query is satisfiable iff one of the models satisfies
+/// it, unless the worker could not tell which side is infeasible.
+class SpeculationReplaySolver : public SolverImpl {
+  Solver *solver;
+
+  std::shared_ptr<const Assignment> findModel(const Query &query) const {
+    for (const auto &model : replay->models)
+      if (model->satisfies(query.constraints.begin(),
+                           query.constraints.end()) &&
+          !model->evaluate(query.expr)->isTrue())
+        return model;
+    return nullptr;
+  }
+
+public:
+  const SpeculativeSolver::Result *replay;
+
+  explicit SpeculationReplaySolver(Solver *_solver)
+      : solver(_solver), replay(0) {}
+  ~SpeculationReplaySolver() { delete solver; }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    if (!replay)
+      return solver->impl->computeValidity(query, result);
+    return SolverImpl::computeValidity(query, result);
+  }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    if (!replay)
+      return solver->impl->computeTruth(query, isValid);
+    if (!replay->success)
+      return false;
+    if (findModel(query)) {
+      isValid = false;
+      return true;
+    }
+    if (replay->validity != Solver::Unknown) {
+      isValid = true;
+      return true;
+    }
+    return solver->impl->computeTruth(query, isValid);
+  }
+
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    if (!replay)
+      return solver->impl->computeValue(query, result);
+    if (!replay->success)
+      return false;
+    if (auto model = findModel(query.withFalse())) {
+      result = model->evaluate(query.expr);
+      return true;
+    }
+    return solver->impl->computeValue(query, result);
+  }
+
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    if (!replay)
+      return solver->impl->computeInitialValues(query, result, hasSolution);
+    if (!replay->success)
+      return false;
+    if (auto model = findModel(query)) {
+      result = model;
+      hasSolution = true;
+      return true;
+    }
+    if (replay->validity != Solver::Unknown) {
+      hasSolution = false;
+      return true;
+    }
+    return solver->impl->computeInitialValues(query, result, hasSolution);
+  }
+
+  SolverRunStatus getOperationStatusCode() {
+    if (!replay)
+      return solver->impl->getOperationStatusCode();
+    return replay->success ? SOLVER_RUN_STATUS_SUCCESS_SOLVABLE
+                           : SOLVER_RUN_STATUS_TIMEOUT;
+  }
+
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+}
+
+namespace {
+// A report is the success and validity of the evaluation, followed by the
+// models as the number of arrays and, for each array, its address, the
+// number of its bytes and the bytes as index and value.
+template <typename T> void append(std::vector<char> &message, T value) {
+  const char *p = reinterpret_cast<const char *>(&value);
+  message.insert(message.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+bool consume(const std::vector<char> &message, size_t &pos, T &value) {
+  if (message.size() - pos < sizeof(T))
+    return false;
+  std::memcpy(&value, message.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+void appendModel(std::vector<char> &message, const Assignment &model,
+                 const std::vector<const Array *> &arrays) {
+  append<uint32_t>(message, arrays.size());
+  for (const Array *array : arrays) {
+    std::map<uint32_t, uint8_t> bytes;
+    if (const CompactArrayModel *m = model.getBindingsOrNull(array))
+      bytes = m->asMap();
+    append<uint64_t>(message, reinterpret_cast<uintptr_t>(array));
+    append<uint32_t>(message, bytes.size());
+    for (const auto &b : bytes) {
+      append<uint32_t>(message, b.first);
+      append<uint8_t>(message, b.second);
+    }
+  }
+}
+
+bool parseReport(const std::vector<char> &message,
+                 std::vector<std::shared_ptr<const Assignment> > &models,
+                 int32_t &success, int32_t &validity) {
+  size_t pos = 0;
+  uint32_t numModels;
+  if (!consume(message, pos, success) || !consume(message, pos, validity) ||
+      !consume(message, pos, numModels))
+    return false;
+  for (uint32_t i = 0; i != numModels; ++i) {
+    Assignment::map_bindings_ty bindings;
+    uint32_t numArrays;
+    if (!consume(message, pos, numArrays))
+      return false;
+    for (uint32_t a = 0; a != numArrays; ++a) {
+      uint64_t array;
+      uint32_t numBytes;
+      if (!consume(message, pos, array) || !consume(message, pos, numBytes))
+        return false;
+      // workers are forks of this process, so the arrays are the same
+      MapArrayModel &bytes =
+          bindings[reinterpret_cast<const Array *>(uintptr_t(array))];
+      for (uint32_t b = 0; b != numBytes; ++b) {
+        uint32_t index;
+        uint8_t value;
+        if (!consume(message, pos, index) || !consume(message, pos, value))
+          return false;
+        bytes.add(index, value);
+      }
+    }
+    models.push_back(std::make_shared<const Assignment>(bindings));
+  }
+  return pos == message.size();
+}
+}
+
+static void reap(pid_t pid) {
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+}
+
+SpeculativeSolver::SpeculativeSolver(const std::vector<TimingSolver *> &_solvers,
+                                     time::Span _timeout)
+    : solvers(_solvers), timeout(_timeout), replaySolver(0) {
+  for (unsigned i = solvers.size(); i != 0; --i)
+    idleWorkers.push_back(i - 1);
+}
+
+SpeculativeSolver::~SpeculativeSolver() {
+  for (auto &it : speculations)
+    kill(it.second);
+  for (TimingSolver *solver : solvers)
+    delete solver;
+}
+
+Solver *SpeculativeSolver::createReplaySolver(Solver *coreSolver) {
+  assert(!replaySolver && "replay solver already created");
+  replaySolver = new SpeculationReplaySolver(coreSolver);
+  return new Solver(replaySolver);
+}
+
+void SpeculativeSolver::read(Speculation &s) {
+  char buffer[4096];
+  ssize_t n;
+  while ((n = ::read(s.fd, buffer, sizeof(buffer))) != 0) {
+    if (n > 0) {
+      s.message.insert(s.message.end(), buffer, buffer + n);
+      continue;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return;
+    break;
+  }
+
+  // the worker has closed its end, by exiting
+  close(s.fd);
+  s.fd = -1;
+  reap(s.pid);
+  s.pid = 0;
+  idleWorkers.push_back(s.worker);
+
+  int32_t success = 0, validity = Solver::Unknown;
+  s.reported = parseReport(s.message, s.result.models, success, validity);
+  s.result.success = success;
+  s.result.validity = static_cast<Solver::Validity>(validity);
+  s.message.clear();
+}
+
+void SpeculativeSolver::drain() {
+  for (auto &it : speculations)
+    if (it.second.pid)
+      read(it.second);
+}
+
+void SpeculativeSolver::wait(Speculation &s) {
+  while (s.pid) {
+    read(s);
+    if (!s.pid)
+      break;
+    struct pollfd pfd = {s.fd, POLLIN, 0};
+    poll(&pfd, 1, -1);
+  }
+}
+
+void SpeculativeSolver::kill(Speculation &s) {
+  if (!s.pid)
+    return;
+  ::kill(-s.pid, SIGKILL);
+  reap(s.pid);
+  close(s.fd);
+  s.fd = -1;
+  s.pid = 0;
+  idleWorkers.push_back(s.worker);
+}
+
+void SpeculativeSolver::speculate(const ExecutionState &state,
+                                  ref<Expr> condition) {
+  drain();
+  if (idleWorkers.empty() || speculations.count(&state))
+    return;
+
+  int fds[2];
+  if (pipe(fds) == -1) {
+    klee_warning_once(0, "pipe failed (for speculative solver) - %s",
+                      llvm::sys::StrError(errno).c_str());
+    return;
+  }
+
+  unsigned worker = idleWorkers.back();
+
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    klee_warning_once(0, "fork failed (for speculative solver) - %s",
+                      llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return;
+  }
+
+  if (pid == 0) {
+    // own process group, so that processes forked by the solver are killed
+    // with it
+    setpgid(0, 0);
+    close(fds[0]);
+    TimingSolver *solver = solvers[worker];
+    solver->setTimeout(timeout);
+    Solver::Validity validity = Solver::Unknown;
+    bool success = solver->evaluate(state, condition, validity);
+
+    std::vector<std::shared_ptr<const Assignment> > models;
+    if (success) {
+      // the models come from the cache of the worker's chain. Without a
+      // model of each feasible side the replay would take that side to be
+      // infeasible, so the worker reports nothing and the state's query is
+      // solved by the main chain instead.
+      Query query(state.constraints, condition);
+      std::shared_ptr<const Assignment> model;
+      if (validity != Solver::False) {
+        if (!solver->solver->getInitialValues(query.negateExpr(), model))
+          _exit(0);
+        models.push_back(model);
+      }
+      if (validity != Solver::True) {
+        if (!solver->solver->getInitialValues(query, model))
+          _exit(0);
+        models.push_back(model);
+      }
+    }
+
+    std::vector<const Array *> arrays;
+    findSymbolicObjects(state.constraints.begin(), state.constraints.end(),
+                        arrays);
+    findSymbolicObjects(condition, arrays);
+
+    std::vector<char> message;
+    append<int32_t>(message, success);
+    append<int32_t>(message, validity);
+    append<uint32_t>(message, models.size());
+    for (const auto &model : models)
+      appendModel(message, *model, arrays);
+
+    const char *p = message.data();
+    size_t left = message.size();
+    while (left) {
+      ssize_t written = write(fds[1], p, left);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0)
+        break;
+      p += written;
+      left -= written;
+    }
+    _exit(0);
+  }
+  setpgid(pid, pid);
+  close(fds[1]);
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+  idleWorkers.pop_back();
+  Speculation &s = speculations[&state];
+  s.constraints = state.constraints;
+  s.condition = condition;
+  s.worker = worker;
+  s.pid = pid;
+  s.fd = fds[0];
+  s.reported = false;
+  ++stats::speculativeQueries;
+}
+
+bool SpeculativeSolver::lookup(const ExecutionState &state,
+                               ref<Expr> condition) {
+  assert(replaySolver && "speculation without a replay solver");
+  auto it = speculations.find(&state);
+  if (it == speculations.end())
+    return false;
+
+  Speculation &s = it->second;
+  if (s.condition != condition || s.constraints != state.constraints) {
+    kill(s);
+    speculations.erase(it);
+    ++stats::speculativeCancels;
+    return false;
+  }
+
+  wait(s);
+  bool reported = s.reported;
+  if (reported) {
+    replayed = std::move(s.result);
+    replaySolver->replay = &replayed;
+    ++stats::speculativeHits;
+  }
+  speculations.erase(it);
+  return reported;
+}
+
+void SpeculativeSolver::endReplay() {
+  replaySolver->replay = 0;
+  replayed.models.clear();
+}
+
+void SpeculativeSolver::cancel(const ExecutionState &state) {
+  auto it = speculations.find(&state);
+  if (it == speculations.end())
+    return;
+  if (it->second.pid)
+    ++stats::speculativeCancels;
+  kill(it->second);
+  speculations.erase(it);
+}
@@ -0,0 +1,137 @@
+//===-- SpeculativeSolver.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SPECULATIVESOLVER_H
+#define KLEE_SPECULATIVESOLVER_H
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/Solver.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+namespace klee {
+  class ExecutionState;
+  class SpeculationReplaySolver;
+  class TimingSolver;
+
+  /// SpeculativeSolver - Evaluates the branch conditions of states which
+  /// the searcher is about to select in forked worker processes, so that
+  /// the queries are solved while other states execute. Workers run on a
+  /// snapshot of the state's constraints, and a result is only used if the
+  /// state still has the same constraints and condition when it forks.
+  ///
+  /// Workers are processes rather than threads because expressions are
+  /// reference counted and compared without synchronization. Each worker
+  /// slot has a solver chain of its own, as the backends keep state in
+  /// shared memory which forked copies would share. Worker chains do not
+  /// use the persistent query cache, since a killed worker could leave its
+  /// file lock held.
+  ///
+  /// Besides the validity, a worker reports a model of each feasible side
+  /// of the branch. The query is then replayed through the main solver
+  /// chain, whose core solver answers from these models, so that the
+  /// caches of the main chain learn the result as if it had been solved
+  /// there.
+  class SpeculativeSolver {
+    friend class SpeculationReplaySolver;
+
+    struct Result {
+      bool success;
+      Solver::Validity validity;
+      // a model of each feasible side of the branch
+      std::vector<std::shared_ptr<const Assignment> > models;
+    };
+
+    struct Speculation {
+      ConstraintManager constraints;
+      ref<Expr> condition;
+      unsigned worker;
+      // 0 once the worker has finished
+      pid_t pid;
+      // the read end of the pipe the worker reports through
+      int fd;
+      std::vector<char> message;
+      bool reported;
+      Result result;
+    };
+
+    std::vector<TimingSolver *> solvers;
+    std::vector<unsigned> idleWorkers;
+    time::Span timeout;
+    std::map<const ExecutionState *, Speculation> speculations;
+    // the core solver of the main chain, and the result it replays
+    SpeculationReplaySolver *replaySolver;
+    Result replayed;
+
+    /// Reads what the worker of \a s has written so far, and parses its
+    /// report once it has finished.
+    void read(Speculation &s);
+
+    /// Collects the results the workers have reported so far.
+    void drain();
+
+    /// Blocks until the worker of \a s has finished.
+    void wait(Speculation &s);
+
+    void kill(Speculation &s);
+
+  public:
+    /// Takes ownership of \a _solvers, one per worker.
+    SpeculativeSolver(const std::vector<TimingSolver *> &_solvers,
+                      time::Span _timeout);
+    ~SpeculativeSolver();
+
+    SpeculativeSolver(const SpeculativeSolver &) = delete;
+    SpeculativeSolver &operator=(const SpeculativeSolver &) = delete;
+
+    /// Returns a solver which passes queries on to \a coreSolver, except
+    /// while a result is replayed. It must be the core solver of the main
+    /// solver chain.
+    Solver *createReplaySolver(Solver *coreSolver);
+
+    /// Starts evaluating \a condition under the constraints of \a state,
+    /// unless all workers are busy or \a state already has a speculation.
+    void speculate(const ExecutionState &state, ref<Expr> condition);
+
+    /// Returns true if a worker is free to start a speculation.
+    bool hasIdleWorker() {
+      drain();
+      return !idleWorkers.empty();
+    }
+
+    /// Returns true if \a state has a speculation, running or finished.
+    bool isSpeculating(const ExecutionState &state) const {
+      return speculations.count(&state);
+    }
+
+    /// Returns true if the speculation for \a state was made for
+    /// \a condition and the current constraints of the state, waiting for
+    /// it to finish if necessary, and starts replaying its result. Until
+    /// endReplay() the main solver chain must only evaluate \a condition
+    /// for \a state. Any other speculation for the state is cancelled, and
+    /// false is returned if the worker did not report a result, e.g. as it
+    /// found no model for a feasible side of the branch.
+    bool lookup(const ExecutionState &state, ref<Expr> condition);
+
+    /// Stops replaying the result found by lookup().
+    void endReplay();
+
+    /// Cancels the speculation for \a state, if any.
+    void cancel(const ExecutionState &state);
+  };
+}
+
+#endif /* KLEE_SPECULATIVESOLVER_H */
@@ -23,6 +23,7 @@
 #include "CallPathManager.h"
 #include "CoreStats.h"
 #include "Executor.h"
+#include "Memory.h"
 #include "MemoryManager.h"
 #include "UserSearcher.h"
 
@@ -41,6 +42,7 @@
 #include "llvm/Support/FileSystem.h"
 
 #include <fstream>
+#include <vector>
 #include <unistd.h>
 
 using namespace klee;
@@ -450,10 +452,25 @@ void StatsTracker::writeStatsHeader() {
              << "ForkTime INTEGER,"
              << "ResolveTime INTEGER,"
              << "QueryCexCacheMisses INTEGER,"
+             << "QueryCexCacheHits INTEGER,"
+             << "BoundsChecks INTEGER,"
+             << "BoundsCheckQueries INTEGER,"
+             << "BoundsCheckQueriesSaved INTEGER,"
+             << "Allocations INTEGER,"
+             << "ObjectStateAllocations INTEGER,"
+             << "PoolUsage INTEGER,"
+             << "QueryPersistentCacheHits INTEGER,"
+             << "QueryPersistentCacheMisses INTEGER,"
+             << "SpeculativeQueries INTEGER,"
+             << "SpeculativeHits INTEGER,"
+             << "ResolveQueries INTEGER,"
+             << "ResolveQueriesSaved INTEGER,"
 #ifdef KLEE_ARRAY_DEBUG
-	           << "ArrayHashTime INTEGER,"
+             << "SegmentPlaneAllocations INTEGER,"
+             << "ArrayHashTime INTEGER"
+#else
+             << "SegmentPlaneAllocations INTEGER"
 #endif
-             << "QueryCexCacheHits INTEGER"
              << ")";
   char *zErrMsg = nullptr;
   if(sqlite3_exec(statsFile, create.str().c_str(), nullptr, nullptr, &zErrMsg)) {
@@ -486,10 +503,25 @@ void StatsTracker::writeStatsHeader() {
              << "ForkTime ,"
              << "ResolveTime ,"
              << "QueryCexCacheMisses ,"
+             << "QueryCexCacheHits ,"
+             << "BoundsChecks ,"
+             << "BoundsCheckQueries ,"
+             << "BoundsCheckQueriesSaved ,"
+             << "Allocations ,"
+             << "ObjectStateAllocations ,"
+             << "PoolUsage ,"
+             << "QueryPersistentCacheHits ,"
+             << "QueryPersistentCacheMisses ,"
+             << "SpeculativeQueries ,"
+             << "SpeculativeHits ,"
+             << "ResolveQueries ,"
+             << "ResolveQueriesSaved ,"
 #ifdef KLEE_ARRAY_DEBUG
-             << "ArrayHashTime,"
+             << "SegmentPlaneAllocations ,"
+             << "ArrayHashTime "
+#else
+             << "SegmentPlaneAllocations "
 #endif
-             << "QueryCexCacheHits "
              << ") VALUES ( "
              << "?, "
              << "?, "
@@ -510,6 +542,19 @@ void StatsTracker::writeStatsHeader() {
              << "?, "
              << "?, "
              << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
+             << "?, "
 #ifdef KLEE_ARRAY_DEBUG
              << "?, "
 #endif
@@ -546,8 +591,21 @@ void StatsTracker::writeStatsLine() {
   sqlite3_bind_int64(insertStmt, 18, stats::resolveTime);
   sqlite3_bind_int64(insertStmt, 19, stats::queryCexCacheMisses);
   sqlite3_bind_int64(insertStmt, 20, stats::queryCexCacheHits);
+  sqlite3_bind_int64(insertStmt, 21, stats::boundsChecks);
+  sqlite3_bind_int64(insertStmt, 22, stats::boundsCheckQueries);
+  sqlite3_bind_int64(insertStmt, 23, stats::boundsCheckQueriesSaved);
+  sqlite3_bind_int64(insertStmt, 24, stats::allocations);
+  sqlite3_bind_int64(insertStmt, 25, stats::objectStateAllocations);
+  sqlite3_bind_int64(insertStmt, 26, getObjectPoolUsage());
+  sqlite3_bind_int64(insertStmt, 27, stats::queryPersistentCacheHits);
+  sqlite3_bind_int64(insertStmt, 28, stats::queryPersistentCacheMisses);
+  sqlite3_bind_int64(insertStmt, 29, stats::speculativeQueries);
+  sqlite3_bind_int64(insertStmt, 30, stats::speculativeHits);
+  sqlite3_bind_int64(insertStmt, 31, stats::resolveQueries);
+  sqlite3_bind_int64(insertStmt, 32, stats::resolveQueriesSaved);
+  sqlite3_bind_int64(insertStmt, 33, stats::segmentPlaneAllocations);
 #ifdef KLEE_ARRAY_DEBUG
-  sqlite3_bind_int64(insertStmt, 21, stats::arrayHashTime);
+  sqlite3_bind_int64(insertStmt, 34, stats::arrayHashTime);
 #endif
   int errCode = sqlite3_step(insertStmt);
   if(errCode != SQLITE_DONE) klee_error("Error writing stats data: %s", sqlite3_errmsg(statsFile));
@@ -581,7 +639,6 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
 
 void StatsTracker::writeIStats() {
   const auto m = executor.kmodule->module.get();
-  uint64_t istatsMask = 0;
   llvm::raw_fd_ostream &of = *istatsFile;
   
   // We assume that we didn't move the file pointer
@@ -597,26 +654,26 @@ void StatsTracker::writeIStats() {
 
   StatisticManager &sm = *theStatisticManager;
   unsigned nStats = sm.getNumStatistics();
-
-  // Max is 13, sadly
-  istatsMask |= 1<<sm.getStatisticID("Queries");
-  istatsMask |= 1<<sm.getStatisticID("QueriesValid");
-  istatsMask |= 1<<sm.getStatisticID("QueriesInvalid");
-  istatsMask |= 1<<sm.getStatisticID("QueryTime");
-  istatsMask |= 1<<sm.getStatisticID("ResolveTime");
-  istatsMask |= 1<<sm.getStatisticID("Instructions");
-  istatsMask |= 1<<sm.getStatisticID("InstructionTimes");
-  istatsMask |= 1<<sm.getStatisticID("InstructionRealTimes");
-  istatsMask |= 1<<sm.getStatisticID("Forks");
-  istatsMask |= 1<<sm.getStatisticID("CoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("UncoveredInstructions");
-  istatsMask |= 1<<sm.getStatisticID("States");
-  istatsMask |= 1<<sm.getStatisticID("MinDistToUncovered");
+  std::vector<bool> istatsMask(nStats);
+
+  istatsMask[sm.getStatisticID("Queries")] = true;
+  istatsMask[sm.getStatisticID("QueriesValid")] = true;
+  istatsMask[sm.getStatisticID("QueriesInvalid")] = true;
+  istatsMask[sm.getStatisticID("QueryTime")] = true;
+  istatsMask[sm.getStatisticID("ResolveTime")] = true;
+  istatsMask[sm.getStatisticID("Instructions")] = true;
+  istatsMask[sm.getStatisticID("InstructionTimes")] = true;
+  istatsMask[sm.getStatisticID("InstructionRealTimes")] = true;
+  istatsMask[sm.getStatisticID("Forks")] = true;
+  istatsMask[sm.getStatisticID("CoveredInstructions")] = true;
+  istatsMask[sm.getStatisticID("UncoveredInstructions")] = true;
+  istatsMask[sm.getStatisticID("States")] = true;
+  istatsMask[sm.getStatisticID("MinDistToUncovered")] = true;
 
   of << "positions: instr line\n";
 
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i)) {
+    if (istatsMask[i]) {
       Statistic &s = sm.getStatistic(i);
       of << "event: " << s.getShortName() << " : " 
          << s.getName() << "\n";
@@ -625,14 +682,14 @@ void StatsTracker::writeIStats() {
 
   of << "events: ";
   for (unsigned i=0; i<nStats; i++) {
-    if (istatsMask & (1<<i))
+    if (istatsMask[i])
       of << sm.getStatistic(i).getShortName() << " ";
   }
   of << "\n";
   
   // set state counts, decremented after we process so that we don't
   // have to zero all records each time.
-  if (istatsMask & (1<<stats::states.getID()))
+  if (istatsMask[stats::states.getID()])
     updateStateStatistics(1);
 
   std::string sourceFile = "";
@@ -671,7 +728,7 @@ void StatsTracker::writeIStats() {
           of << ii.assemblyLine << " ";
           of << ii.line << " ";
           for (unsigned i=0; i<nStats; i++)
-            if (istatsMask&(1<<i))
+            if (istatsMask[i])
               of << sm.getIndexedValue(sm.getStatistic(i), index) << " ";
           of << "\n";
 
@@ -696,7 +753,7 @@ void StatsTracker::writeIStats() {
                 of << ii.assemblyLine << " ";
                 of << ii.line << " ";
                 for (unsigned i=0; i<nStats; i++) {
-                  if (istatsMask&(1<<i)) {
+                  if (istatsMask[i]) {
                     Statistic &s = sm.getStatistic(i);
                     uint64_t value;
 
@@ -720,7 +777,7 @@ void StatsTracker::writeIStats() {
     }
   }
 
-  if (istatsMask & (1<<stats::states.getID()))
+  if (istatsMask[stats::states.getID()])
     updateStateStatistics((uint64_t)-1);
   
   // Clear then end of the file if necessary (no truncate op?).
@@ -140,6 +140,45 @@ bool TimingSolver::getValue(const ExecutionState& state, KValue value,
   return success;
 }
 
+bool TimingSolver::getValues(const ExecutionState &state,
+                             const std::vector<ref<Expr> > &exprs,
+                             std::vector<ref<ConstantExpr> > &results) {
+  results.assign(exprs.size(), ref<ConstantExpr>());
+
+  // Fast path, to avoid timer and OS overhead.
+  bool allConstant = true;
+  for (unsigned i = 0; i != exprs.size(); ++i) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(exprs[i]))
+      results[i] = CE;
+    else
+      allConstant = false;
+  }
+  if (allConstant)
+    return true;
+
+  TimerStatIncrementer timer(stats::solverTime);
+
+  Query query(state.constraints, ConstantExpr::alloc(0, Expr::Bool));
+  std::shared_ptr<const Assignment> assignment;
+  bool success = solver->getInitialValues(query, assignment);
+  for (unsigned i = 0; success && i != exprs.size(); ++i) {
+    if (!results[i].isNull())
+      continue;
+    ref<Expr> value = assignment->evaluate(exprs[i]);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(value)) {
+      results[i] = CE;
+      continue;
+    }
+    // divisions by zero are left unevaluated, so those expressions are
+    // concretized on their own
+    success = solver->getValue(query.withExpr(exprs[i]), results[i]);
+  }
+
+  state.queryCost += timer.delta();
+
+  return success;
+}
+
 bool 
 TimingSolver::getInitialValues(const ExecutionState& state,
                                std::shared_ptr<const Assignment> &result) {
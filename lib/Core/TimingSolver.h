@@ -64,6 +64,11 @@ namespace klee {
     bool getValue(const ExecutionState &, KValue value,
                   ref<ConstantExpr> &segmentResult, ref<ConstantExpr> &offsetResult);
 
+    /// getValues - Compute values of \a exprs which are consistent with
+    /// each other, from a single model of the constraints of the state.
+    bool getValues(const ExecutionState &, const std::vector<ref<Expr> > &exprs,
+                   std::vector<ref<ConstantExpr> > &results);
+
     bool getInitialValues(const ExecutionState&,
                           std::shared_ptr<const Assignment> &result);
 
@@ -0,0 +1,161 @@
+//===-- WitnessDispatch.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "WitnessDispatch.h"
+
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KInstruction.h"
+#include "klee/Internal/Module/KModule.h"
+#include "witnessChecking/WitnessParser.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <string>
+
+using namespace klee;
+
+WitnessDispatchTable::Kind
+WitnessDispatchTable::getKind(const llvm::Instruction *inst) {
+  switch (inst->getOpcode()) {
+  case llvm::Instruction::Br:
+    return Branch;
+  case llvm::Instruction::Call:
+    return Call;
+  case llvm::Instruction::Ret:
+    return Return;
+  default:
+    return Other;
+  }
+}
+
+/// Returns true if \a edge can match an instruction of \a kind, whatever
+/// its line and function.
+static bool mayMatch(const WitnessEdge &edge, WitnessDispatchTable::Kind kind) {
+  switch (kind) {
+  case WitnessDispatchTable::Return:
+    return edge.control.empty();
+  case WitnessDispatchTable::Call:
+    return edge.control.empty() && edge.retFromFunc.empty();
+  case WitnessDispatchTable::Branch:
+  case WitnessDispatchTable::Other:
+    // only calls and returns have a function
+    return (kind == WitnessDispatchTable::Branch || edge.control.empty()) &&
+           edge.retFromFunc.empty() && edge.assumResFunc.empty() &&
+           (edge.enterFunc.empty() || edge.enterFunc == "main");
+  default:
+    return false;
+  }
+}
+
+/// Returns true unless \a inst calls a known function which does not
+/// return a nondeterministic value.
+static bool mayCallNondet(const llvm::Instruction *inst) {
+  const llvm::CallInst *ci = llvm::cast<llvm::CallInst>(inst);
+  const llvm::Function *f =
+      llvm::dyn_cast<llvm::Function>(ci->getCalledValue()->stripPointerCasts());
+  return !f || f->getName().startswith("__VERIFIER_nondet");
+}
+
+void WitnessDispatchTable::build(const WitnessAutomaton &witness,
+                                 KModule &kmodule) {
+  edgeFunctions.clear();
+  functionIds.clear();
+  byLine.clear();
+  for (auto &edges : anyLine)
+    edges.clear();
+  for (auto &edges : entryEdges)
+    edges.clear();
+
+  std::map<std::string, unsigned> names;
+  auto intern = [&names](const std::string &name) -> unsigned {
+    if (name.empty())
+      return 0;
+    return names.insert(std::make_pair(name, names.size() + 1)).first->second;
+  };
+
+  unsigned numEdges = witness.get_edges_number();
+  edgeFunctions.resize(numEdges);
+  for (unsigned e = 0; e != numEdges; ++e) {
+    const WitnessEdge &edge = witness.get_edge(e);
+    EdgeFunctions &ef = edgeFunctions[e];
+    ef.enterFunc = intern(edge.enterFunc);
+    ef.retFromFunc = intern(edge.retFromFunc);
+    ef.assumResFunc = intern(edge.assumResFunc);
+    ef.enterMain = edge.enterFunc == "main";
+  }
+
+  for (const llvm::Function &f : *kmodule.module) {
+    auto it = names.find(f.getName().str());
+    if (it != names.end())
+      functionIds[&f] = it->second;
+  }
+
+  // the kinds of instructions on each line of the module
+  std::map<long, unsigned> lineKinds;
+  for (auto &kf : kmodule.functions)
+    for (unsigned i = 0; i != kf->numInstructions; ++i) {
+      const KInstruction *ki = kf->instructions[i];
+      lineKinds[ki->info->line] |= 1u << getKind(ki->inst);
+    }
+
+  for (unsigned e = 0; e != numEdges; ++e) {
+    const WitnessEdge &edge = witness.get_edge(e);
+    if (mayMatch(edge, Return))
+      anyLine[Return].push_back(e);
+
+    if (edge.startline == 0) {
+      // but for calls to main, entering main only matches at the entry, so
+      // it must not make every instruction relevant
+      for (unsigned kind = Other; kind != Return; ++kind) {
+        if (!mayMatch(edge, Kind(kind)))
+          continue;
+        if (kind != Call && edgeFunctions[e].enterMain)
+          entryEdges[kind].push_back(e);
+        else
+          anyLine[kind].push_back(e);
+      }
+      continue;
+    }
+
+    // an edge matches its start line and the lines after it up to its end
+    // line
+    auto it = lineKinds.lower_bound(edge.startline);
+    auto ie = lineKinds.upper_bound(std::max(edge.startline, edge.endline));
+    for (; it != ie; ++it)
+      for (unsigned kind = Other; kind != Return; ++kind)
+        if ((it->second & (1u << kind)) && mayMatch(edge, Kind(kind)))
+          byLine[getKey(it->first, Kind(kind))].push_back(e);
+  }
+
+  // edges without a line are candidates on every line
+  for (auto &it : byLine) {
+    const std::vector<unsigned> &any = anyLine[it.first & 3];
+    if (any.empty())
+      continue;
+    std::vector<unsigned> merged;
+    merged.reserve(it.second.size() + any.size());
+    std::merge(it.second.begin(), it.second.end(), any.begin(), any.end(),
+               std::back_inserter(merged));
+    it.second.swap(merged);
+  }
+
+  for (auto &kf : kmodule.functions)
+    for (unsigned i = 0; i != kf->numInstructions; ++i) {
+      KInstruction *ki = kf->instructions[i];
+      Kind kind = getKind(ki->inst);
+      ki->witnessRelevant = !getCandidates(kind, ki->info->line).empty() ||
+                            (kind == Call && mayCallNondet(ki->inst));
+    }
+}
@@ -0,0 +1,111 @@
+//===-- WitnessDispatch.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_WITNESSDISPATCH_H
+#define KLEE_WITNESSDISPATCH_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class WitnessAutomaton;
+
+namespace llvm {
+  class Function;
+  class Instruction;
+}
+
+namespace klee {
+  class KModule;
+
+  /// WitnessDispatchTable - The edges of a witness automaton which an
+  /// instruction can match, looked up by its source line and kind. Edges
+  /// without a line, and all edges which returns can match, are candidates
+  /// on every line, except for those entering main, which are candidates
+  /// of the first instructions executed only. The functions named by the
+  /// edges are interned, so that matching a candidate compares integers
+  /// instead of names.
+  class WitnessDispatchTable {
+  public:
+    enum Kind { Other, Branch, Call, Return, NumKinds };
+
+  private:
+    // the interned functions an edge names, 0 if it names none
+    struct EdgeFunctions {
+      unsigned enterFunc;
+      unsigned retFromFunc;
+      unsigned assumResFunc;
+      // entering main matches the first instruction of any kind
+      bool enterMain;
+    };
+
+    std::vector<EdgeFunctions> edgeFunctions;
+    std::unordered_map<const llvm::Function *, unsigned> functionIds;
+    // sorted candidate edges by line and kind
+    std::unordered_map<uint64_t, std::vector<unsigned> > byLine;
+    std::vector<unsigned> anyLine[NumKinds];
+    // the edges without a line entering main, by kind
+    std::vector<unsigned> entryEdges[NumKinds];
+
+    static uint64_t getKey(unsigned line, Kind kind) {
+      return (uint64_t(line) << 2) | kind;
+    }
+
+  public:
+    static Kind getKind(const llvm::Instruction *inst);
+
+    /// Builds the table for the edges of \a witness and the instructions
+    /// of \a kmodule, and marks the instructions which are relevant to the
+    /// witness.
+    void build(const WitnessAutomaton &witness, KModule &kmodule);
+
+    /// Returns the edges an instruction of \a kind on \a line can match,
+    /// in increasing order.
+    const std::vector<unsigned> &getCandidates(Kind kind,
+                                               unsigned line) const {
+      if (kind != Return) {
+        auto it = byLine.find(getKey(line, kind));
+        if (it != byLine.end())
+          return it->second;
+      }
+      return anyLine[kind];
+    }
+
+    /// Returns the edges without a line entering main which the first
+    /// instructions executed of \a kind can match besides their candidates,
+    /// in increasing order.
+    const std::vector<unsigned> &getEntryEdges(Kind kind) const {
+      return entryEdges[kind];
+    }
+
+    /// Returns the interned id of \a f, or 0 if no edge names it.
+    unsigned getFunctionId(const llvm::Function *f) const {
+      auto it = functionIds.find(f);
+      return it == functionIds.end() ? 0 : it->second;
+    }
+
+    /// Returns true if the candidate \a edge matches an instruction of
+    /// \a kind whose callee (or for returns, whose function) is \a function.
+    /// \a atEntry is whether the instruction is the first one executed.
+    bool matches(unsigned edge, Kind kind, unsigned function,
+                 bool atEntry) const {
+      const EdgeFunctions &ef = edgeFunctions[edge];
+      if (ef.retFromFunc && function != ef.retFromFunc)
+        return false;
+      if (ef.enterFunc && !(ef.enterMain && atEntry) &&
+          (kind != Call || function != ef.enterFunc))
+        return false;
+      if (ef.assumResFunc && function != ef.assumResFunc)
+        return false;
+      return true;
+    }
+  };
+}
+
+#endif /* KLEE_WITNESSDISPATCH_H */
@@ -0,0 +1,348 @@
+//===-- CompiledExpr.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/CompiledExpr.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace klee;
+
+static inline uint64_t mask(Expr::Width w) {
+  return w >= 64 ? ~uint64_t(0) : (uint64_t(1) << w) - 1;
+}
+
+static inline int64_t sext(uint64_t v, Expr::Width w) {
+  if (w >= 64)
+    return static_cast<int64_t>(v);
+  return static_cast<int64_t>(v << (64 - w)) >> (64 - w);
+}
+
+CompiledExpr::CompiledExpr(const ref<Expr> &e) : root(e) {
+  std::unordered_map<const Expr *, unsigned> regs;
+  result = compile(e, regs);
+  if (!wideRegisters.empty())
+    wideRegisters.resize(widths.size());
+}
+
+unsigned CompiledExpr::addRegister(Expr::Width width) {
+  widths.push_back(width);
+  registers.push_back(0);
+  return widths.size() - 1;
+}
+
+unsigned CompiledExpr::compile(const ref<Expr> &e,
+                               std::unordered_map<const Expr *, unsigned> &regs) {
+  auto it = regs.find(e.get());
+  if (it != regs.end())
+    return it->second;
+
+  unsigned reg;
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(e)) {
+    reg = addRegister(CE->getWidth());
+    if (CE->getWidth() > 64) {
+      wideRegisters.resize(reg + 1);
+      wideRegisters[reg] = CE->getAPValue();
+    } else {
+      registers[reg] = CE->getZExtValue();
+    }
+  } else if (e->getKind() == Expr::NotOptimized) {
+    reg = compile(e->getKid(0), regs);
+  } else {
+    Instruction inst;
+    inst.kind = e->getKind();
+    inst.width = e->getWidth();
+    inst.data = 0;
+    inst.wide = inst.width > 64;
+    std::fill(inst.ops, inst.ops + 3, 0);
+    std::fill(inst.extra, inst.extra + 2, 0);
+
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+      inst.ops[0] = compile(re->index, regs);
+      std::vector<Update> reads;
+      for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+        Update u;
+        u.index = compile(un->index, regs);
+        u.value = compile(un->value, regs);
+        reads.push_back(u);
+      }
+      inst.extra[0] = updates.size();
+      inst.extra[1] = reads.size();
+      updates.insert(updates.end(), reads.begin(), reads.end());
+      inst.data = re->updates.root;
+      assert(!inst.wide && widths[inst.ops[0]] <= 64 && "wide array read");
+    } else {
+      for (unsigned i = 0, n = e->getNumKids(); i != n; ++i) {
+        inst.ops[i] = compile(e->getKid(i), regs);
+        if (widths[inst.ops[i]] > 64)
+          inst.wide = true;
+      }
+      if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e))
+        inst.extra[0] = ee->offset;
+      if (inst.wide)
+        inst.data = e.get();
+    }
+
+    reg = addRegister(inst.width);
+    inst.dst = reg;
+    if (inst.width > 64)
+      wideRegisters.resize(reg + 1);
+    code.push_back(inst);
+  }
+
+  regs.insert(std::make_pair(e.get(), reg));
+  return reg;
+}
+
+ref<ConstantExpr> CompiledExpr::getRegister(unsigned reg) const {
+  if (widths[reg] > 64)
+    return ConstantExpr::alloc(wideRegisters[reg]);
+  return ConstantExpr::create(registers[reg], widths[reg]);
+}
+
+/// Evaluates an instruction over APInt registers by rebuilding its node
+/// from constants, which folds it.
+bool CompiledExpr::runWide(const Instruction &inst) const {
+  const Expr *e = static_cast<const Expr *>(inst.data);
+  ref<Expr> kids[3];
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    kids[i] = getRegister(inst.ops[i]);
+
+  switch (inst.kind) {
+  case Expr::UDiv:
+  case Expr::SDiv:
+  case Expr::URem:
+  case Expr::SRem:
+    if (cast<ConstantExpr>(kids[1])->isZero())
+      return false;
+    break;
+  default:
+    break;
+  }
+
+  ref<ConstantExpr> value = cast<ConstantExpr>(e->rebuild(kids));
+  if (inst.width > 64)
+    wideRegisters[inst.dst] = value->getAPValue();
+  else
+    registers[inst.dst] = value->getZExtValue();
+  return true;
+}
+
+bool CompiledExpr::run(const Assignment &a) const {
+  uint64_t *r = registers.data();
+  for (const Instruction &inst : code) {
+    if (inst.wide) {
+      if (!runWide(inst))
+        return false;
+      continue;
+    }
+
+    uint64_t x = r[inst.ops[0]], y = r[inst.ops[1]];
+    // the width of the operands
+    Expr::Width w = widths[inst.ops[0]];
+    uint64_t v;
+    switch (inst.kind) {
+    case Expr::Read: {
+      // the index is truncated like in ExprEvaluator::evalRead
+      unsigned index = x;
+      const Update *u = updates.data() + inst.extra[0];
+      const Update *ue = u + inst.extra[1];
+      while (u != ue && r[u->index] != index)
+        ++u;
+      if (u != ue) {
+        v = r[u->value];
+      } else {
+        const Array *array = static_cast<const Array *>(inst.data);
+        if (array->isConstantArray() && index < array->constantValues.size())
+          v = array->constantValues[index]->getZExtValue();
+        else
+          v = a.getValue(array, index);
+      }
+      break;
+    }
+    case Expr::Select:
+      v = x ? y : r[inst.ops[2]];
+      break;
+    case Expr::Concat:
+      v = (x << widths[inst.ops[1]]) | y;
+      break;
+    case Expr::Extract:
+      v = x >> inst.extra[0];
+      break;
+    case Expr::ZExt:
+      v = x;
+      break;
+    case Expr::SExt:
+      v = sext(x, w);
+      break;
+    case Expr::Not:
+      v = ~x;
+      break;
+
+    case Expr::Add:
+      v = x + y;
+      break;
+    case Expr::Sub:
+      v = x - y;
+      break;
+    case Expr::Mul:
+      v = x * y;
+      break;
+    case Expr::UDiv:
+      if (!y)
+        return false;
+      v = x / y;
+      break;
+    case Expr::URem:
+      if (!y)
+        return false;
+      v = x % y;
+      break;
+    case Expr::SDiv:
+      if (!y)
+        return false;
+      // avoid overflowing on INT64_MIN / -1, which wraps
+      v = sext(y, w) == -1 ? -x : sext(x, w) / sext(y, w);
+      break;
+    case Expr::SRem:
+      if (!y)
+        return false;
+      v = sext(y, w) == -1 ? 0 : sext(x, w) % sext(y, w);
+      break;
+
+    case Expr::And:
+      v = x & y;
+      break;
+    case Expr::Or:
+      v = x | y;
+      break;
+    case Expr::Xor:
+      v = x ^ y;
+      break;
+    case Expr::Shl:
+      v = y >= w ? 0 : x << y;
+      break;
+    case Expr::LShr:
+      v = y >= w ? 0 : x >> y;
+      break;
+    case Expr::AShr:
+      v = sext(x, w) >> (y >= w ? w - 1 : y);
+      break;
+
+    case Expr::Eq:
+      v = x == y;
+      break;
+    case Expr::Ne:
+      v = x != y;
+      break;
+    case Expr::Ult:
+      v = x < y;
+      break;
+    case Expr::Ule:
+      v = x <= y;
+      break;
+    case Expr::Ugt:
+      v = x > y;
+      break;
+    case Expr::Uge:
+      v = x >= y;
+      break;
+    case Expr::Slt:
+      v = sext(x, w) < sext(y, w);
+      break;
+    case Expr::Sle:
+      v = sext(x, w) <= sext(y, w);
+      break;
+    case Expr::Sgt:
+      v = sext(x, w) > sext(y, w);
+      break;
+    case Expr::Sge:
+      v = sext(x, w) >= sext(y, w);
+      break;
+
+    default:
+      assert(0 && "unhandled Expr kind");
+      return false;
+    }
+    r[inst.dst] = v & mask(inst.width);
+  }
+  return true;
+}
+
+bool CompiledExpr::evaluate(const Assignment &a,
+                            ref<ConstantExpr> &value) const {
+  if (!run(a))
+    return false;
+  value = getRegister(result);
+  return true;
+}
+
+bool CompiledExpr::isTrue(const Assignment &a, bool &value) const {
+  assert(widths[result] == Expr::Bool && "expression is not boolean");
+  if (!run(a))
+    return false;
+  value = registers[result];
+  return true;
+}
+
+/***/
+
+void CompiledExprCache::sweep() {
+  for (auto it = entries.begin(); it != entries.end();) {
+    auto &values = it->second.values;
+    for (auto vit = values.begin(); vit != values.end();) {
+      if (vit->second.first.expired())
+        vit = values.erase(vit);
+      else
+        ++vit;
+    }
+    if (values.empty())
+      it = entries.erase(it);
+    else
+      ++it;
+  }
+  sweepAt = std::max<size_t>(1024, 2 * entries.size());
+}
+
+ref<Expr> CompiledExprCache::evaluate(const ref<Expr> &e,
+                                      const std::shared_ptr<const Assignment> &a) {
+  if (isa<ConstantExpr>(e))
+    return e;
+
+  auto eit = entries.find(e);
+  if (eit == entries.end()) {
+    if (entries.size() >= sweepAt)
+      sweep();
+    eit = entries.emplace(e, Entry()).first;
+  }
+  Entry &entry = eit->second;
+  auto it = entry.values.find(a.get());
+  // an expired value was computed for a freed assignment at the same address
+  if (it != entry.values.end() && !it->second.first.expired())
+    return it->second.second;
+
+  if (!entry.code)
+    entry.code.reset(new CompiledExpr(e));
+  ref<ConstantExpr> value;
+  if (!entry.code->evaluate(*a, value))
+    return a->evaluate(e);
+
+  if (entry.values.size() >= entry.sweepAt) {
+    for (auto vit = entry.values.begin(); vit != entry.values.end();) {
+      if (vit->second.first.expired())
+        vit = entry.values.erase(vit);
+      else
+        ++vit;
+    }
+    entry.sweepAt = std::max<size_t>(16, 2 * entry.values.size());
+  }
+  entry.values[a.get()] = std::make_pair(std::weak_ptr<const Assignment>(a),
+                                         value);
+  return value;
+}
@@ -10,14 +10,18 @@
 #include "klee/Expr/Constraints.h"
 
 #include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Internal/Module/KModule.h"
 #include "klee/OptionCategories.h"
+#include "klee/util/ChunkedArray.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
 #include <map>
+#include <unordered_map>
 
 using namespace klee;
 
@@ -74,10 +78,160 @@ public:
   }
 };
 
+/// Groups the constraints into clusters of constraints which transitively
+/// read a common array element, where reading an array at a symbolic index
+/// counts as reading all of its elements. This is the partition the
+/// independent solver splits queries by.
+///
+/// Copies share their storage in chunks, so that a forked state copies
+/// the clusters in O(constraints / ChunkSize + arrays) and adding a
+/// constraint only clones the chunks and arrays it touches.
+class ConstraintManager::Clusters {
+  static const size_t ChunkSize = 256;
+  typedef ChunkedArray<unsigned, ChunkSize> Positions;
+
+  // marks an element which no constraint reads
+  enum : unsigned { None = ~0u };
+
+  struct ArrayReads {
+    // some constraint reading the array
+    unsigned reader;
+    // whether the array is read at a symbolic index
+    bool symbolic = false;
+    // some constraint reading each element, until the array is read at a
+    // symbolic index
+    Positions elements;
+
+    ArrayReads(unsigned _reader, size_t size)
+        : reader(_reader), elements(size, None) {}
+  };
+
+  // the number of constraints, the arrays below grow by whole chunks
+  unsigned size = 0;
+  Positions parent;
+  Positions rank;
+  // links the constraints of each cluster into a circular list
+  Positions next;
+  // shared between copies until the array is read by a new constraint
+  std::unordered_map<const Array *, std::shared_ptr<ArrayReads> > arrays;
+
+  // calls f(array, symbolic, index) for each array element read by e, a
+  // constant index out of the bounds of the array counts as symbolic
+  template <typename F> static void forEachRead(const ref<Expr> &e, F f) {
+    std::vector<ref<ReadExpr> > reads;
+    findReads(e, /* visitUpdates= */ true, reads);
+    for (const ref<ReadExpr> &re : reads) {
+      const Array *array = re->updates.root;
+      // reads of a constant array don't alias
+      if (array->isConstantArray() && !re->updates.head)
+        continue;
+      ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index);
+      if (CE && CE->getZExtValue() < array->size)
+        f(array, false, (unsigned) CE->getZExtValue(32));
+      else
+        f(array, true, 0u);
+    }
+  }
+
+  unsigned find(unsigned i) const {
+    while (parent[i] != i)
+      i = parent[i];
+    return i;
+  }
+
+  void unite(unsigned a, unsigned b) {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+      return;
+    if (rank[a] < rank[b])
+      std::swap(a, b);
+    parent.set(b, a);
+    if (rank[a] == rank[b])
+      rank.set(a, rank[a] + 1);
+    unsigned nextA = next[a];
+    next.set(a, next[b]);
+    next.set(b, nextA);
+  }
+
+public:
+  /// Adds the constraint at the next position.
+  void add(const ref<Expr> &e) {
+    unsigned pos = size++;
+    if (pos == parent.size()) {
+      parent.resize(pos + ChunkSize);
+      rank.resize(pos + ChunkSize);
+      next.resize(pos + ChunkSize);
+    }
+    parent.set(pos, pos);
+    next.set(pos, pos);
+    forEachRead(e, [this, pos](const Array *array, bool symbolic,
+                               unsigned index) {
+      std::shared_ptr<ArrayReads> &shared = arrays[array];
+      if (!shared)
+        shared = std::make_shared<ArrayReads>(pos, array->size);
+      else if (shared.use_count() > 1)
+        shared = std::make_shared<ArrayReads>(*shared);
+      ArrayReads &reads = *shared;
+      if (reads.symbolic) {
+        unite(pos, reads.reader);
+      } else if (symbolic) {
+        unite(pos, reads.reader);
+        for (size_t i = 0, e = reads.elements.size(); i != e; ++i)
+          if (reads.elements[i] != None)
+            unite(pos, reads.elements[i]);
+        reads.elements.clear();
+        reads.symbolic = true;
+      } else if (reads.elements[index] == None) {
+        reads.elements.set(index, pos);
+      } else {
+        unite(pos, reads.elements[index]);
+      }
+    });
+  }
+
+  /// Appends to \a result the positions of the constraints in the clusters
+  /// of the array elements read by \a e, in increasing order.
+  void getRelated(const ref<Expr> &e, std::vector<unsigned> &result) const {
+    std::vector<unsigned> roots;
+    forEachRead(e, [this, &roots](const Array *array, bool symbolic,
+                                  unsigned index) {
+      auto it = arrays.find(array);
+      if (it == arrays.end())
+        return;
+      const ArrayReads &reads = *it->second;
+      if (reads.symbolic) {
+        roots.push_back(find(reads.reader));
+      } else if (symbolic) {
+        for (size_t i = 0, e = reads.elements.size(); i != e; ++i)
+          if (reads.elements[i] != None)
+            roots.push_back(find(reads.elements[i]));
+      } else if (reads.elements[index] != None) {
+        roots.push_back(find(reads.elements[index]));
+      }
+    });
+    std::sort(roots.begin(), roots.end());
+    roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+
+    size_t first = result.size();
+    for (unsigned root : roots) {
+      unsigned i = root;
+      do {
+        result.push_back(i);
+        i = next[i];
+      } while (i != root);
+    }
+    std::sort(result.begin() + first, result.end());
+  }
+};
+
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
   ConstraintManager::constraints_ty old;
   bool changed = false;
 
+  // the clusters are rebuilt on demand if constraints are replaced
+  std::shared_ptr<Clusters> oldClusters;
+  oldClusters.swap(clusters);
   constraints.swap(old);
   for (ConstraintManager::constraints_ty::iterator 
          it = old.begin(), ie = old.end(); it != ie; ++it) {
@@ -92,6 +246,8 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
     }
   }
 
+  if (!changed)
+    clusters.swap(oldClusters);
   return changed;
 }
 
@@ -154,12 +310,12 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
 	rewriteConstraints(visitor);
       }
     }
-    constraints.push_back(e);
+    pushConstraint(e);
     break;
   }
     
   default:
-    constraints.push_back(e);
+    pushConstraint(e);
     break;
   }
 }
@@ -168,3 +324,25 @@ void ConstraintManager::addConstraint(ref<Expr> e) {
   e = simplifyExpr(e);
   addConstraintInternal(e);
 }
+
+void ConstraintManager::pushConstraint(ref<Expr> e) {
+  constraints.push_back(e);
+  if (clusters) {
+    if (clusters.use_count() > 1)
+      clusters = std::make_shared<Clusters>(*clusters);
+    clusters->add(e);
+  }
+}
+
+void ConstraintManager::getRelatedConstraints(
+    ref<Expr> e, std::vector<ref<Expr>> &result) const {
+  if (!clusters) {
+    clusters = std::make_shared<Clusters>();
+    for (const ref<Expr> &constraint : constraints)
+      clusters->add(constraint);
+  }
+  std::vector<unsigned> positions;
+  clusters->getRelated(e, positions);
+  for (unsigned i : positions)
+    result.push_back(constraints[i]);
+}
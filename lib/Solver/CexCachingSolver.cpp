@@ -10,27 +10,24 @@
 #include "klee/Solver/Solver.h"
 
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/CompiledExpr.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
-#include "klee/Internal/ADT/MapOfSets.h"
+#include "klee/Internal/ADT/SetTrie.h"
 #include "klee/Internal/Support/ErrorHandling.h"
 #include "klee/OptionCategories.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Solver/SolverStats.h"
 #include "klee/TimerStatIncrementer.h"
-#include "klee/Expr/Assignment.h"
-#include "klee/Expr/ExprUtil.h"
-#include "klee/Expr/ExprVisitor.h"
-#include "klee/Internal/ADT/MapOfSets.h"
-
-#include "klee/Solver/SolverStats.h"
-
-#include "klee/Internal/Support/ErrorHandling.h"
 
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+#include <iterator>
+#include <unordered_set>
+
 using namespace klee;
 using namespace llvm;
 
@@ -58,21 +55,46 @@ cl::opt<bool> CexCacheExperimental(
     cl::desc("Optimization for validity queries (default=false)"),
     cl::cat(SolvingCat));
 
+cl::opt<unsigned> CexCacheMaxEntries(
+    "cex-cache-max-entries", cl::init(0),
+    cl::desc("Maximum number of cached counterexamples, evicting the least "
+             "recently used ones when exceeded (default=0 (off))"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> CexCacheMaxCandidates(
+    "cex-cache-max-candidates", cl::init(64),
+    cl::desc("Maximum number of cached counterexamples to try on a query "
+             "before asking the SMT solver, 0 meaning no limit (default=64)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> CexCacheCompiledEval(
+    "cex-cache-compiled-eval", cl::init(true),
+    cl::desc("Check cached counterexamples against constraints with compiled "
+             "expressions, memoizing the results (default=true)"),
+    cl::cat(SolvingCat));
+
 } // namespace
 
 ///
 
-typedef std::set< ref<Expr> > KeyType;
+struct ExprKeyInfo {
+  static unsigned getHash(const ref<Expr> &e) { return e->hash(); }
+  static bool isEqual(const ref<Expr> &a, const ref<Expr> &b) { return a == b; }
+  static bool isLess(const ref<Expr> &a, const ref<Expr> &b) { return a < b; }
+};
+
+typedef SetTrie<ref<Expr>, std::shared_ptr<const Assignment>, ExprKeyInfo>
+    CacheType;
+typedef CacheType::key_ty KeyType;
 
 class CexCachingSolver : public SolverImpl {
-  typedef std::set<std::shared_ptr<const Assignment> >
-          assignmentsTable_ty;
-
   Solver *solver;
   
-  MapOfSets<ref<Expr>, std::shared_ptr<const Assignment>> cache;
-  // memo table
-  assignmentsTable_ty assignmentsTable;
+  CacheType cache;
+
+  /// Evaluates constraints under the cached assignments. Its entries are
+  /// swept once their assignments are evicted from the cache.
+  CompiledExprCache evaluator;
 
   bool searchForAssignment(KeyType &key, 
                            std::shared_ptr<const Assignment> &result);
@@ -90,7 +112,9 @@ class CexCachingSolver : public SolverImpl {
                      std::shared_ptr<const Assignment> &result);
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver) : solver(_solver) {
+    cache.setMaxSize(CexCacheMaxEntries);
+  }
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -107,20 +131,59 @@ public:
 ///
 
 struct NullAssignment {
-  bool operator()(const std::shared_ptr<const Assignment>& a) const { return !a; }
+  bool operator()(const KeyType &,
+                  const std::shared_ptr<const Assignment> &a) const {
+    return !a;
+  }
 };
 
 struct NonNullAssignment {
-  bool operator()(const std::shared_ptr<const Assignment>& a) const { return a!=0; }
+  bool operator()(const KeyType &,
+                  const std::shared_ptr<const Assignment> &a) const {
+    return a != 0;
+  }
 };
 
-struct NullOrSatisfyingAssignment {
-  KeyType &key;
-  
-  NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
+/// Accepts the cached assignments which satisfy the key, trying at most
+/// CexCacheMaxCandidates distinct assignments. An assignment is known to
+/// satisfy the constraints it was cached for, so only the constraints of the
+/// key missing from those are evaluated.
+struct SatisfyingAssignment {
+  const KeyType &key;
+  // null to evaluate with Assignment::evaluate
+  CompiledExprCache *evaluator;
+  std::unordered_set<const Assignment *> tried;
+
+  SatisfyingAssignment(const KeyType &_key, CompiledExprCache *_evaluator)
+    : key(_key), evaluator(_evaluator) {}
+
+  bool operator()(const KeyType &cached,
+                  const std::shared_ptr<const Assignment> &a) {
+    if (!a)
+      return false;
+    if (CexCacheMaxCandidates && tried.size() >= CexCacheMaxCandidates)
+      return false;
+    if (!tried.insert(a.get()).second)
+      return false;
 
-  bool operator()(const std::shared_ptr<const Assignment>& a) const {
-    return !a || a->satisfies(key.begin(), key.end()); 
+    KeyType missing;
+    std::set_difference(key.begin(), key.end(), cached.begin(), cached.end(),
+                        std::back_inserter(missing),
+                        CacheType::ElementLess());
+    if (evaluator)
+      return evaluator->satisfies(missing.begin(), missing.end(), a);
+    return a->satisfies(missing.begin(), missing.end());
+  }
+};
+
+struct NullOrSatisfyingAssignment : SatisfyingAssignment {
+  NullOrSatisfyingAssignment(const KeyType &_key,
+                             CompiledExprCache *_evaluator)
+    : SatisfyingAssignment(_key, _evaluator) {}
+
+  bool operator()(const KeyType &cached,
+                  const std::shared_ptr<const Assignment> &a) {
+    return !a || SatisfyingAssignment::operator()(cached, a);
   }
 };
 
@@ -133,6 +196,8 @@ struct NullOrSatisfyingAssignment {
 /// \return - True if a cached result was found.
 bool CexCachingSolver::searchForAssignment(KeyType &key,
                                            std::shared_ptr<const Assignment> &result) {
+  TimerStatIncrementer t(stats::cexCacheLookupTime);
+  CompiledExprCache *eval = CexCacheCompiledEval ? &evaluator : 0;
   std::shared_ptr<const Assignment> *lookup = cache.lookup(key);
   if (lookup) {
     result = *lookup;
@@ -156,15 +221,12 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
       return true;
     }
 
-    // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      std::shared_ptr<const Assignment> a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
-        return true;
-      }
+    // Otherwise, iterate through the current assignments, most recently used
+    // first, to see if one of them satisfies the query.
+    lookup = cache.findRecent(SatisfyingAssignment(key, eval));
+    if (lookup) {
+      result = *lookup;
+      return true;
     }
   } else {
     // FIXME: Which order? one is sure to be better.
@@ -181,7 +243,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
     // satisfiable subsets to see if they solve the current query and return
     // them if so. This is cheap and frequently succeeds.
     if (!lookup) 
-      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key));
+      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key, eval));
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
@@ -213,8 +275,9 @@ bool CexCachingSolver::lookupAssignment(const Query &query,
       return true;
     }
   } else {
-    key.insert(neg);
+    key.push_back(neg);
   }
+  CacheType::normalize(key);
 
   bool found = searchForAssignment(key, result);
   if (found)
@@ -236,14 +299,10 @@ bool CexCachingSolver::getAssignment(const Query& query,
     return false;
 
     
-  if (hasSolution) {
-    // Memoize the result.
-    assignmentsTable.insert(result);
-  } else {
+  if (!hasSolution)
     result = 0;
-  }
   
-  cache.insert(key, result);
+  stats::queryCexCacheEvictions += cache.insert(key, result);
 
   return true;
 }
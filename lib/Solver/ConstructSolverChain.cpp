@@ -24,7 +24,8 @@ Solver *constructSolverChain(Solver *coreSolver,
                              std::string querySMT2LogPath,
                              std::string baseSolverQuerySMT2LogPath,
                              std::string queryKQueryLogPath,
-                             std::string baseSolverQueryKQueryLogPath) {
+                             std::string baseSolverQueryKQueryLogPath,
+                             bool usePersistentCache) {
   Solver *solver = coreSolver;
   const time::Span minQueryTimeToLog(MinQueryTimeToLog);
 
@@ -40,6 +41,14 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (usePersistentCache && !PersistentQueryCache.empty()) {
+    solver = createPersistentCachingSolver(
+        solver, PersistentQueryCache,
+        uint64_t(PersistentQueryCacheSize) * 1024 * 1024);
+    klee_message("Using persistent query cache %s\n",
+                 PersistentQueryCache.c_str());
+  }
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(solver);
 
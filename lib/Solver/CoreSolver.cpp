@@ -19,6 +19,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <string>
+#include <vector>
 
 namespace klee {
 
@@ -50,6 +51,35 @@ Solver *createCoreSolver(CoreSolverType cst) {
     klee_message("Not compiled with Z3 support");
     return NULL;
 #endif
+  case PORTFOLIO_SOLVER: {
+    std::vector<CoreSolverType> types(PortfolioSolvers.begin(),
+                                      PortfolioSolvers.end());
+    if (types.empty()) {
+#ifdef ENABLE_STP
+      types.push_back(STP_SOLVER);
+#endif
+#ifdef ENABLE_METASMT
+      types.push_back(METASMT_SOLVER);
+#endif
+#ifdef ENABLE_Z3
+      types.push_back(Z3_SOLVER);
+#endif
+    }
+
+    std::vector<std::pair<CoreSolverType, Solver *>> solvers;
+    for (CoreSolverType type : types)
+      if (Solver *solver = createCoreSolver(type))
+        solvers.emplace_back(type, solver);
+
+    if (solvers.empty()) {
+      klee_message("No backend available for the portfolio solver");
+      return NULL;
+    }
+    if (solvers.size() == 1)
+      return solvers.front().second;
+    klee_message("Using portfolio solver backend");
+    return createPortfolioSolver(solvers);
+  }
   case NO_SOLVER:
     klee_message("Invalid solver");
     return NULL;
@@ -17,87 +17,146 @@
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Solver/SolverImpl.h"
 
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <list>
 #include <map>
+#include <numeric>
 #include <ostream>
+#include <unordered_map>
 #include <vector>
 
 using namespace klee;
 using namespace llvm;
 
-template<class T>
+/// A set of unsigned integers stored as a compressed bitmap. Only the
+/// non-zero 64-bit words of the bitmap are kept, sorted by their position,
+/// so sets of nearby indices take little memory and set operations work a
+/// word at a time.
 class DenseSet {
-  typedef std::set<T> set_ty;
-  set_ty s;
+  struct Word {
+    unsigned pos;  // index of the first bit of the word divided by 64
+    uint64_t bits;
+  };
+  std::vector<Word> words;
+
+  static bool lessPos(const Word &w, unsigned pos) { return w.pos < pos; }
 
 public:
   DenseSet() {}
 
-  void add(T x) {
-    s.insert(x);
+  void add(unsigned x) {
+    unsigned pos = x / 64;
+    uint64_t bit = uint64_t(1) << (x % 64);
+    auto it = std::lower_bound(words.begin(), words.end(), pos, lessPos);
+    if (it != words.end() && it->pos == pos)
+      it->bits |= bit;
+    else
+      words.insert(it, Word{pos, bit});
   }
-  void add(T start, T end) {
+  void add(unsigned start, unsigned end) {
     for (; start<end; start++)
-      s.insert(start);
+      add(start);
   }
 
   // returns true iff set is changed by addition
   bool add(const DenseSet &b) {
+    std::vector<Word> merged;
+    merged.reserve(words.size() + b.words.size());
     bool modified = false;
-    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end(); 
-         it != ie; ++it) {
-      if (modified || !s.count(*it)) {
+    auto it = words.begin(), ie = words.end();
+    for (const Word &w : b.words) {
+      for (; it != ie && it->pos < w.pos; ++it)
+        merged.push_back(*it);
+      if (it != ie && it->pos == w.pos) {
+        modified |= (w.bits & ~it->bits) != 0;
+        merged.push_back(Word{w.pos, it->bits | w.bits});
+        ++it;
+      } else {
         modified = true;
-        s.insert(*it);
+        merged.push_back(w);
       }
     }
-    return modified;
+    if (!modified)
+      return false;
+    merged.insert(merged.end(), it, ie);
+    words.swap(merged);
+    return true;
   }
 
-  bool intersects(const DenseSet &b) {
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it)
-      if (b.s.count(*it))
-        return true;
+  bool intersects(const DenseSet &b) const {
+    auto it = words.begin(), ie = words.end();
+    auto bit = b.words.begin(), bie = b.words.end();
+    while (it != ie && bit != bie) {
+      if (it->pos < bit->pos) {
+        ++it;
+      } else if (bit->pos < it->pos) {
+        ++bit;
+      } else {
+        if (it->bits & bit->bits)
+          return true;
+        ++it;
+        ++bit;
+      }
+    }
     return false;
   }
 
-  std::set<unsigned>::iterator begin(){
-    return s.begin();
-  }
+  bool empty() const { return words.empty(); }
 
-  std::set<unsigned>::iterator end(){
-    return s.end();
-  }
+  class iterator {
+    std::vector<Word>::const_iterator it, ie;
+    uint64_t bits;
+
+  public:
+    iterator(std::vector<Word>::const_iterator _it,
+             std::vector<Word>::const_iterator _ie)
+      : it(_it), ie(_ie), bits(_it != _ie ? _it->bits : 0) {}
+
+    unsigned operator*() const {
+      return it->pos * 64 + llvm::countTrailingZeros(bits);
+    }
+    iterator &operator++() {
+      bits &= bits - 1;
+      if (!bits && ++it != ie)
+        bits = it->bits;
+      return *this;
+    }
+    bool operator!=(const iterator &b) const {
+      return it != b.it || bits != b.bits;
+    }
+  };
+
+  iterator begin() const { return iterator(words.begin(), words.end()); }
+  iterator end() const { return iterator(words.end(), words.end()); }
 
   void print(llvm::raw_ostream &os) const {
     bool first = true;
     os << "{";
-    for (typename set_ty::iterator it = s.begin(), ie = s.end(); 
-         it != ie; ++it) {
+    for (unsigned x : *this) {
       if (first) {
         first = false;
       } else {
         os << ",";
       }
-      os << *it;
+      os << x;
     }
     os << "}";
   }
 };
 
-template <class T>
 inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
-                                     const ::DenseSet<T> &dis) {
+                                     const ::DenseSet &dis) {
   dis.print(os);
   return os;
 }
 
 class IndependentElementSet {
 public:
-  typedef std::map<const Array*, ::DenseSet<unsigned> > elements_ty;
+  typedef std::map<const Array*, ::DenseSet> elements_ty;
   elements_ty elements;                 // Represents individual elements of array accesses (arr[1])
   std::set<const Array*> wholeObjects;  // Represents symbolically accessed arrays (arr[x])
   std::vector<ref<Expr> > exprs;        // All expressions that are associated with this factor
@@ -128,7 +187,7 @@ public:
         if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
           // if index constant, then add to set of constraints operating
           // on that array (actually, don't add constraint, just set index)
-          ::DenseSet<unsigned> &dis = elements[array];
+          ::DenseSet &dis = elements[array];
           dis.add((unsigned) CE->getZExtValue(32));
         } else {
           elements_ty::iterator it2 = elements.find(array);
@@ -169,7 +228,7 @@ public:
     for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
          it != ie; ++it) {
       const Array *array = it->first;
-      const ::DenseSet<unsigned> &dis = it->second;
+      const ::DenseSet &dis = it->second;
 
       if (first) {
         first = false;
@@ -256,101 +315,118 @@ inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
   return os;
 }
 
+// Groups the given sets into the classes of the transitive closure of
+// IndependentElementSet::intersects, using union-find. Each set is united
+// with every other set accessing one of its array elements, or one of its
+// arrays at all if either side accesses the array symbolically, so the
+// partition is found in a single pass over the accessed elements.
+//
+// Returns for each set the index of the first set in its class.
+static std::vector<unsigned>
+partitionIndependentSets(const std::vector<IndependentElementSet> &sets) {
+  std::vector<unsigned> parent(sets.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find = [&parent](unsigned x) {
+    while (parent[x] != x) {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+    }
+    return x;
+  };
+  auto unite = [&parent, &find](unsigned a, unsigned b) {
+    a = find(a);
+    b = find(b);
+    if (a != b)
+      parent[std::max(a, b)] = std::min(a, b);
+  };
+
+  struct ArrayAccesses {
+    std::vector<unsigned> sets; // sets accessing the array
+    bool symbolic = false;      // whether one of them does so symbolically
+  };
+  std::unordered_map<const Array *, ArrayAccesses> arrays;
+  for (unsigned i = 0; i != sets.size(); ++i) {
+    for (const Array *array : sets[i].wholeObjects) {
+      ArrayAccesses &accesses = arrays[array];
+      accesses.sets.push_back(i);
+      accesses.symbolic = true;
+    }
+    for (auto const &element : sets[i].elements)
+      arrays[element.first].sets.push_back(i);
+  }
+
+  std::unordered_map<unsigned, unsigned> firstAccess;
+  for (auto const &array : arrays) {
+    const ArrayAccesses &accesses = array.second;
+    if (accesses.symbolic) {
+      for (unsigned i : accesses.sets)
+        unite(accesses.sets.front(), i);
+      continue;
+    }
+    firstAccess.clear();
+    for (unsigned i : accesses.sets)
+      for (unsigned index : sets[i].elements.find(array.first)->second) {
+        auto inserted = firstAccess.insert(std::make_pair(index, i));
+        if (!inserted.second)
+          unite(inserted.first->second, i);
+      }
+  }
+
+  for (unsigned i = 0; i != sets.size(); ++i)
+    parent[i] = find(i);
+  return parent;
+}
+
 // Breaks down a constraint into all of it's individual pieces, returning a
 // list of IndependentElementSets or the independent factors.
 //
 // Caller takes ownership of returned std::list.
 static std::list<IndependentElementSet>*
 getAllIndependentConstraintsSets(const Query &query) {
-  std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
+  std::vector<IndependentElementSet> sets;
   ConstantExpr *CE = dyn_cast<ConstantExpr>(query.expr);
   if (CE) {
     assert(CE && CE->isFalse() && "the expr should always be false and "
                                   "therefore not included in factors");
   } else {
     ref<Expr> neg = Expr::createIsZero(query.expr);
-    factors->push_back(IndependentElementSet(neg));
+    sets.push_back(IndependentElementSet(neg));
   }
 
   for (ConstraintManager::const_iterator it = query.constraints.begin(),
                                          ie = query.constraints.end();
-       it != ie; ++it) {
-    // iterate through all the previously separated constraints.  Until we
-    // actually return, factors is treated as a queue of expressions to be
-    // evaluated.  If the queue property isn't maintained, then the exprs
-    // could be returned in an order different from how they came it, negatively
-    // affecting later stages.
-    factors->push_back(IndependentElementSet(*it));
-  }
+       it != ie; ++it)
+    sets.push_back(IndependentElementSet(*it));
 
-  bool doneLoop = false;
-  do {
-    doneLoop = true;
-    std::list<IndependentElementSet> *done =
-        new std::list<IndependentElementSet>;
-    while (factors->size() > 0) {
-      IndependentElementSet current = factors->front();
-      factors->pop_front();
-      // This list represents the set of factors that are separate from current.
-      // Those that are not inserted into this list (queue) intersect with
-      // current.
-      std::list<IndependentElementSet> *keep =
-          new std::list<IndependentElementSet>;
-      while (factors->size() > 0) {
-        IndependentElementSet compare = factors->front();
-        factors->pop_front();
-        if (current.intersects(compare)) {
-          if (current.add(compare)) {
-            // Means that we have added (z=y)added to (x=y)
-            // Now need to see if there are any (z=?)'s
-            doneLoop = false;
-          }
-        } else {
-          keep->push_back(compare);
-        }
-      }
-      done->push_back(current);
-      delete factors;
-      factors = keep;
+  // The factors are ordered by their first expression and keep their
+  // expressions in the original order, as reordering them negatively
+  // affects later stages.
+  std::vector<unsigned> classes = partitionIndependentSets(sets);
+  std::list<IndependentElementSet> *factors = new std::list<IndependentElementSet>();
+  std::vector<IndependentElementSet *> factorOf(sets.size());
+  for (unsigned i = 0; i != sets.size(); ++i) {
+    if (classes[i] == i) {
+      factors->push_back(sets[i]);
+      factorOf[i] = &factors->back();
+    } else {
+      factorOf[classes[i]]->add(sets[i]);
     }
-    delete factors;
-    factors = done;
-  } while (!doneLoop);
+  }
 
   return factors;
 }
 
-static 
-IndependentElementSet getIndependentConstraints(const Query& query,
-                                                std::vector< ref<Expr> > &result) {
-  IndependentElementSet eltsClosure(query.expr);
-  std::vector< std::pair<ref<Expr>, IndependentElementSet> > worklist;
-
-  for (ConstraintManager::const_iterator it = query.constraints.begin(), 
-         ie = query.constraints.end(); it != ie; ++it)
-    worklist.push_back(std::make_pair(*it, IndependentElementSet(*it)));
-
-  // XXX This should be more efficient (in terms of low level copy stuff).
-  bool done = false;
-  do {
-    done = true;
-    std::vector< std::pair<ref<Expr>, IndependentElementSet> > newWorklist;
-    for (std::vector< std::pair<ref<Expr>, IndependentElementSet> >::iterator
-           it = worklist.begin(), ie = worklist.end(); it != ie; ++it) {
-      if (it->second.intersects(eltsClosure)) {
-        if (eltsClosure.add(it->second))
-          done = false;
-        result.push_back(it->first);
-        // Means that we have added (z=y)added to (x=y)
-        // Now need to see if there are any (z=?)'s
-      } else {
-        newWorklist.push_back(*it);
-      }
-    }
-    worklist.swap(newWorklist);
-  } while (!done);
+// The constraints the query expression depends on are kept up to date by
+// the ConstraintManager, so they don't have to be recomputed from the whole
+// path condition for every query.
+static void getIndependentConstraints(const Query& query,
+                                      std::vector< ref<Expr> > &result) {
+  query.constraints.getRelatedConstraints(query.expr, result);
 
   KLEE_DEBUG(
+    IndependentElementSet eltsClosure(query.expr);
+    for (const ref<Expr> &constraint : result)
+      eltsClosure.add(IndependentElementSet(constraint));
     std::set< ref<Expr> > reqset(result.begin(), result.end());
     errs() << "--\n";
     errs() << "Q: " << query.expr << "\n";
@@ -364,9 +440,6 @@ IndependentElementSet getIndependentConstraints(const Query& query,
     }
     errs() << "elts closure: " << eltsClosure << "\n";
  );
-
-
-  return eltsClosure;
 }
 
 
@@ -376,7 +449,7 @@ static
 void calculateArrayReferences(const IndependentElementSet & ie,
                               std::vector<const Array *> &returnVector){
   std::set<const Array*> thisSeen;
-  for(std::map<const Array*, ::DenseSet<unsigned> >::const_iterator it = ie.elements.begin();
+  for(std::map<const Array*, ::DenseSet>::const_iterator it = ie.elements.begin();
       it != ie.elements.end(); it ++){
     thisSeen.insert(it->first);
   }
@@ -413,8 +486,7 @@ public:
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure =
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValidity(Query(tmp, query.expr), 
                                        result);
@@ -422,8 +494,7 @@ bool IndependentSolver::computeValidity(const Query& query,
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeTruth(Query(tmp, query.expr), 
                                     isValid);
@@ -431,8 +502,7 @@ bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
   std::vector< ref<Expr> > required;
-  IndependentElementSet eltsClosure = 
-    getIndependentConstraints(query, required);
+  getIndependentConstraints(query, required);
   ConstraintManager tmp(required);
   return solver->impl->computeValue(Query(tmp, query.expr), result);
 }
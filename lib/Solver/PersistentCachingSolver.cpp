@@ -0,0 +1,636 @@
+//===-- PersistentCachingSolver.cpp - On-disk query cache -----------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A solver layer that caches query results in a memory-mapped file so that
+// they can be reused by later runs and by other KLEE processes running at
+// the same time. Queries are identified by a 128-bit structural hash which
+// only depends on the structure of the expressions and on the names, sizes
+// and contents of the arrays they read, so it is stable across runs.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// A 128-bit hash built from a sequence of 64-bit values.
+struct QueryKey {
+  uint64_t lo = 0x243f6a8885a308d3ULL;
+  uint64_t hi = 0x13198a2e03707344ULL;
+
+  static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+  }
+
+  void add(uint64_t value) {
+    lo = mix(lo ^ value);
+    hi = mix(hi ^ mix(value + 0x9e3779b97f4a7c15ULL));
+  }
+
+  void add(const QueryKey &key) {
+    add(key.lo);
+    add(key.hi);
+  }
+
+  bool operator==(const QueryKey &b) const { return lo == b.lo && hi == b.hi; }
+  bool operator<(const QueryKey &b) const {
+    return lo < b.lo || (lo == b.lo && hi < b.hi);
+  }
+};
+
+/// Computes structural hashes of the expressions of a single query. Arrays
+/// are identified by their name, so a query reading two different arrays
+/// with the same name is marked as ambiguous and must not be cached.
+class QueryHasher {
+  std::unordered_map<const Expr *, QueryKey> exprs;
+  std::unordered_map<const UpdateNode *, QueryKey> updates;
+  std::unordered_map<const Array *, QueryKey> arrays;
+  std::map<std::string, const Array *> arraysByName;
+  bool ambiguous = false;
+
+  const QueryKey &hash(const Array *array);
+  QueryKey hash(const UpdateList &updates);
+
+public:
+  QueryKey hash(const ref<Expr> &e);
+
+  /// Returns whether the hashed expressions read different arrays with the
+  /// same name.
+  bool isAmbiguous() const { return ambiguous; }
+
+  /// Returns the arrays read by the hashed expressions, by name.
+  const std::map<std::string, const Array *> &getArrays() const {
+    return arraysByName;
+  }
+};
+
+const QueryKey &QueryHasher::hash(const Array *array) {
+  auto it = arrays.find(array);
+  if (it != arrays.end())
+    return it->second;
+
+  auto inserted = arraysByName.insert(std::make_pair(array->name, array));
+  if (inserted.first->second != array)
+    ambiguous = true;
+
+  QueryKey key;
+  for (char c : array->name)
+    key.add(static_cast<unsigned char>(c));
+  key.add(array->name.size());
+  key.add(array->size);
+  key.add(array->domain);
+  key.add(array->range);
+  key.add(array->isSymbolicArray());
+  for (const ref<ConstantExpr> &value : array->constantValues)
+    key.add(hash(value));
+  return arrays[array] = key;
+}
+
+QueryKey QueryHasher::hash(const UpdateList &ul) {
+  // the chain is hashed from its root so that shared suffixes of update
+  // lists are only visited once
+  std::vector<const UpdateNode *> pending;
+  const UpdateNode *un = ul.head;
+  for (; un && !updates.count(un); un = un->next)
+    pending.push_back(un);
+
+  QueryKey key = un ? updates[un] : hash(ul.root);
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    key.add(hash((*it)->index));
+    key.add(hash((*it)->value));
+    updates[*it] = key;
+  }
+  return key;
+}
+
+QueryKey QueryHasher::hash(const ref<Expr> &e) {
+  auto it = exprs.find(e.get());
+  if (it != exprs.end())
+    return it->second;
+
+  QueryKey key;
+  key.add(e->getKind());
+  key.add(e->getWidth());
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(e)) {
+    const llvm::APInt &value = ce->getAPValue();
+    const uint64_t *words = value.getRawData();
+    for (unsigned i = 0, n = value.getNumWords(); i != n; ++i)
+      key.add(words[i]);
+  } else if (const ExtractExpr *ee = dyn_cast<ExtractExpr>(e)) {
+    key.add(ee->offset);
+  } else if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    key.add(hash(re->updates));
+  }
+  for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+    key.add(hash(e->getKid(i)));
+  return exprs[e.get()] = key;
+}
+
+/// Serializes values into a byte string.
+class RecordWriter {
+  std::string &out;
+
+public:
+  explicit RecordWriter(std::string &_out) : out(_out) {}
+
+  template <typename T> void write(T value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void write(const std::string &s) {
+    write<uint32_t>(s.size());
+    out.append(s);
+  }
+};
+
+/// Deserializes values written by a RecordWriter, failing on truncated
+/// records.
+class RecordReader {
+  const char *pos, *end;
+
+public:
+  explicit RecordReader(const std::string &in)
+      : pos(in.data()), end(in.data() + in.size()) {}
+
+  template <typename T> bool read(T &value) {
+    if (static_cast<size_t>(end - pos) < sizeof(T))
+      return false;
+    memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+
+  bool read(std::string &s) {
+    uint32_t size;
+    if (!read(size) || static_cast<size_t>(end - pos) < size)
+      return false;
+    s.assign(pos, size);
+    pos += size;
+    return true;
+  }
+};
+
+/// A hash table of records in a memory-mapped file. Lookups hold a shared
+/// lock on the file and insertions an exclusive one, so the file can be
+/// used by several processes at once. Records are never removed; once the
+/// table or the record area is full, insertions are dropped.
+class QueryCacheFile {
+  static const uint32_t Version = 1;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t numBuckets;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    uint64_t dataUsed;
+    uint64_t entries;
+  };
+
+  struct Bucket {
+    uint64_t keyLo, keyHi;
+    uint64_t offset;
+    uint32_t length;
+    uint32_t used;
+  };
+
+  class FileLock {
+    int fd;
+
+  public:
+    FileLock(int _fd, int operation) : fd(_fd) {
+      while (flock(fd, operation) == -1 && errno == EINTR)
+        ;
+    }
+    ~FileLock() { flock(fd, LOCK_UN); }
+  };
+
+  int fd = -1;
+  char *base = nullptr;
+  size_t mappedSize = 0;
+
+  Header *header() const { return reinterpret_cast<Header *>(base); }
+  Bucket *buckets() const {
+    return reinterpret_cast<Bucket *>(base + sizeof(Header));
+  }
+
+  // whether the layout in the header fits the mapping, as another process
+  // may have left the file corrupted or truncated
+  bool isConsistent() const {
+    const Header *h = header();
+    return h->numBuckets != 0 && h->numBuckets <= mappedSize / sizeof(Bucket) &&
+           h->dataOffset >= sizeof(Header) + h->numBuckets * sizeof(Bucket) &&
+           h->dataOffset <= mappedSize &&
+           h->dataSize <= mappedSize - h->dataOffset &&
+           h->dataUsed <= h->dataSize;
+  }
+
+  // returns the bucket holding key or the empty bucket where it belongs,
+  // null if the table has neither
+  Bucket *find(const QueryKey &key) const {
+    uint64_t n = header()->numBuckets;
+    for (uint64_t i = 0, idx = key.lo % n; i != n; ++i, idx = (idx + 1) % n) {
+      Bucket *bucket = &buckets()[idx];
+      if (!bucket->used || (bucket->keyLo == key.lo && bucket->keyHi == key.hi))
+        return bucket;
+    }
+    return nullptr;
+  }
+
+public:
+  QueryCacheFile() = default;
+  QueryCacheFile(const QueryCacheFile &) = delete;
+  QueryCacheFile &operator=(const QueryCacheFile &) = delete;
+  ~QueryCacheFile() {
+    if (base)
+      munmap(base, mappedSize);
+    if (fd != -1)
+      close(fd);
+  }
+
+  /// Opens the cache file at \a path, creating it with \a size bytes if it
+  /// does not exist yet.
+  bool open(const std::string &path, uint64_t size, std::string &error) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+      error = strerror(errno);
+      return false;
+    }
+    FileLock lock(fd, LOCK_EX);
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      error = strerror(errno);
+      return false;
+    }
+    bool created = st.st_size == 0;
+    if (created) {
+      size = std::max<uint64_t>(size, 1024 * 1024);
+      if (ftruncate(fd, size) == -1) {
+        error = strerror(errno);
+        return false;
+      }
+    } else if (static_cast<uint64_t>(st.st_size) < sizeof(Header)) {
+      error = "file is too small";
+      return false;
+    } else {
+      size = st.st_size;
+    }
+
+    void *mapping =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      error = strerror(errno);
+      return false;
+    }
+    base = static_cast<char *>(mapping);
+    mappedSize = size;
+
+    Header *h = header();
+    if (created) {
+      h->numBuckets = size / 256;
+      h->dataOffset = (sizeof(Header) + h->numBuckets * sizeof(Bucket) + 63) /
+                      64 * 64;
+      h->dataSize = size - h->dataOffset;
+      h->dataUsed = 0;
+      h->entries = 0;
+      h->version = Version;
+      memcpy(h->magic, "KLEEQCF", 8);
+    } else if (memcmp(h->magic, "KLEEQCF", 8) != 0 || h->version != Version ||
+               !isConsistent()) {
+      error = "not a query cache file or incompatible version";
+      return false;
+    }
+    return true;
+  }
+
+  bool lookup(const QueryKey &key, std::string &record) const {
+    FileLock lock(fd, LOCK_SH);
+    if (!isConsistent())
+      return false;
+    const Bucket *bucket = find(key);
+    if (!bucket || !bucket->used)
+      return false;
+    // a record outside the used data is treated as a miss
+    if (bucket->offset > header()->dataUsed ||
+        bucket->length > header()->dataUsed - bucket->offset)
+      return false;
+    record.assign(base + header()->dataOffset + bucket->offset,
+                  bucket->length);
+    return true;
+  }
+
+  /// Returns false if the record was dropped because the file is full.
+  bool insert(const QueryKey &key, const std::string &record) {
+    FileLock lock(fd, LOCK_EX);
+    Header *h = header();
+    if (!isConsistent() || h->entries >= h->numBuckets / 4 * 3 ||
+        h->dataSize - h->dataUsed < record.size())
+      return false;
+    Bucket *bucket = find(key);
+    if (!bucket)
+      return false;
+    if (bucket->used)
+      return true; // added by another process in the meantime
+
+    memcpy(base + h->dataOffset + h->dataUsed, record.data(), record.size());
+    bucket->offset = h->dataUsed;
+    bucket->length = record.size();
+    bucket->keyLo = key.lo;
+    bucket->keyHi = key.hi;
+    bucket->used = 1;
+    h->dataUsed += record.size();
+    ++h->entries;
+    return true;
+  }
+};
+
+class PersistentCachingSolver : public SolverImpl {
+  enum RecordKind : uint8_t {
+    TruthRecord = 1,
+    ValidityRecord,
+    ValueRecord,
+    InitialValuesRecord
+  };
+
+  Solver *solver;
+  std::unique_ptr<QueryCacheFile> file;
+
+  bool computeKey(const Query &query, RecordKind kind, QueryHasher &hasher,
+                  QueryKey &key);
+  bool lookup(const QueryKey &key, std::string &record);
+  void insert(const QueryKey &key, const std::string &record);
+
+public:
+  PersistentCachingSolver(Solver *s, const std::string &path, uint64_t size);
+  ~PersistentCachingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+PersistentCachingSolver::PersistentCachingSolver(Solver *s,
+                                                 const std::string &path,
+                                                 uint64_t size)
+    : solver(s), file(new QueryCacheFile()) {
+  std::string error;
+  if (!file->open(path, size, error)) {
+    klee_warning("Cannot use persistent query cache %s: %s", path.c_str(),
+                 error.c_str());
+    file.reset();
+  }
+}
+
+/// Computes the key of a query. The constraints are hashed as a set, as
+/// their order does not matter to the solver.
+bool PersistentCachingSolver::computeKey(const Query &query, RecordKind kind,
+                                         QueryHasher &hasher, QueryKey &key) {
+  if (!file)
+    return false;
+
+  std::vector<QueryKey> constraints;
+  for (const auto &constraint : query.constraints)
+    constraints.push_back(hasher.hash(constraint));
+  std::sort(constraints.begin(), constraints.end());
+  constraints.erase(std::unique(constraints.begin(), constraints.end()),
+                    constraints.end());
+
+  key = QueryKey();
+  key.add(kind);
+  key.add(constraints.size());
+  for (const QueryKey &constraint : constraints)
+    key.add(constraint);
+  key.add(hasher.hash(query.expr));
+  return !hasher.isAmbiguous();
+}
+
+bool PersistentCachingSolver::lookup(const QueryKey &key,
+                                     std::string &record) {
+  if (file->lookup(key, record)) {
+    ++stats::queryPersistentCacheHits;
+    return true;
+  }
+  ++stats::queryPersistentCacheMisses;
+  return false;
+}
+
+void PersistentCachingSolver::insert(const QueryKey &key,
+                                     const std::string &record) {
+  if (!file->insert(key, record))
+    klee_warning_once(file.get(), "Persistent query cache is full, new "
+                                  "results are not cached");
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query, bool &isValid) {
+  QueryHasher hasher;
+  QueryKey key;
+  if (!computeKey(query, TruthRecord, hasher, key))
+    return solver->impl->computeTruth(query, isValid);
+
+  std::string record;
+  uint8_t cached;
+  if (lookup(key, record) && RecordReader(record).read(cached)) {
+    isValid = cached;
+    return true;
+  }
+
+  if (!solver->impl->computeTruth(query, isValid))
+    return false;
+  record.clear();
+  RecordWriter(record).write<uint8_t>(isValid);
+  insert(key, record);
+  return true;
+}
+
+bool PersistentCachingSolver::computeValidity(const Query &query,
+                                              Solver::Validity &result) {
+  QueryHasher hasher;
+  QueryKey key;
+  if (!computeKey(query, ValidityRecord, hasher, key))
+    return solver->impl->computeValidity(query, result);
+
+  // A query and its negation have opposite validities, so both share the
+  // record of the one with the smaller key.
+  QueryKey negatedKey;
+  computeKey(query.negateExpr(), ValidityRecord, hasher, negatedKey);
+  bool negated = negatedKey < key;
+  if (negated)
+    key = negatedKey;
+
+  std::string record;
+  int8_t cached;
+  if (lookup(key, record) && RecordReader(record).read(cached)) {
+    result = static_cast<Solver::Validity>(negated ? -cached : cached);
+    return true;
+  }
+
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+  record.clear();
+  RecordWriter(record).write<int8_t>(negated ? -result : result);
+  insert(key, record);
+  return true;
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  QueryHasher hasher;
+  QueryKey key;
+  if (!computeKey(query, ValueRecord, hasher, key))
+    return solver->impl->computeValue(query, result);
+
+  std::string record;
+  if (lookup(key, record)) {
+    RecordReader reader(record);
+    uint32_t width, numWords;
+    std::vector<uint64_t> words;
+    bool valid = reader.read(width) && reader.read(numWords) &&
+                 width == query.expr->getWidth();
+    for (uint32_t i = 0; valid && i != numWords; ++i) {
+      words.push_back(0);
+      valid = reader.read(words.back());
+    }
+    if (valid) {
+      result = ConstantExpr::alloc(llvm::APInt(width, words));
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeValue(query, result))
+    return false;
+  if (const ConstantExpr *ce = dyn_cast<ConstantExpr>(result)) {
+    const llvm::APInt &value = ce->getAPValue();
+    record.clear();
+    RecordWriter writer(record);
+    writer.write<uint32_t>(value.getBitWidth());
+    writer.write<uint32_t>(value.getNumWords());
+    for (unsigned i = 0, n = value.getNumWords(); i != n; ++i)
+      writer.write<uint64_t>(value.getRawData()[i]);
+    insert(key, record);
+  }
+  return true;
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  QueryHasher hasher;
+  QueryKey key;
+  if (!computeKey(query, InitialValuesRecord, hasher, key))
+    return solver->impl->computeInitialValues(query, result, hasSolution);
+  const auto &arrays = hasher.getArrays();
+
+  std::string record;
+  if (lookup(key, record)) {
+    RecordReader reader(record);
+    uint8_t solvable;
+    uint32_t numArrays = 0;
+    bool valid = reader.read(solvable) && (!solvable || reader.read(numArrays));
+    Assignment::map_bindings_ty bindings;
+    for (uint32_t i = 0; valid && i != numArrays; ++i) {
+      std::string name;
+      uint32_t numValues;
+      valid = reader.read(name) && reader.read(numValues);
+      auto array = valid ? arrays.find(name) : arrays.end();
+      valid = valid && array != arrays.end();
+      for (uint32_t j = 0; valid && j != numValues; ++j) {
+        uint32_t index;
+        uint8_t value;
+        valid = reader.read(index) && reader.read(value);
+        if (valid)
+          bindings[array->second].add(index, value);
+      }
+    }
+    if (valid) {
+      hasSolution = solvable;
+      if (hasSolution)
+        result = std::make_shared<Assignment>(bindings);
+      return true;
+    }
+  }
+
+  if (!solver->impl->computeInitialValues(query, result, hasSolution))
+    return false;
+  record.clear();
+  RecordWriter writer(record);
+  writer.write<uint8_t>(hasSolution);
+  if (hasSolution) {
+    std::vector<std::pair<const std::string *, const CompactArrayModel *> >
+        models;
+    for (const auto &array : arrays)
+      if (const CompactArrayModel *model =
+              result->getBindingsOrNull(array.second))
+        models.push_back(std::make_pair(&array.first, model));
+    writer.write<uint32_t>(models.size());
+    for (const auto &model : models) {
+      std::map<uint32_t, uint8_t> values = model.second->asMap();
+      writer.write(*model.first);
+      writer.write<uint32_t>(values.size());
+      for (const auto &value : values) {
+        writer.write<uint32_t>(value.first);
+        writer.write<uint8_t>(value.second);
+      }
+    }
+  }
+  insert(key, record);
+  return true;
+}
+
+} // namespace
+
+Solver *klee::createPersistentCachingSolver(Solver *s, std::string path,
+                                            uint64_t size) {
+  return new Solver(new PersistentCachingSolver(s, path, size));
+}
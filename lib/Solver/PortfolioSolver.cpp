@@ -0,0 +1,493 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryShape.h"
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/OptionCategories.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/TimerStatIncrementer.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <cassert>
+#include <csignal>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+cl::opt<unsigned> PortfolioLearnAfter(
+    "portfolio-learn-after", cl::init(16),
+    cl::desc("Number of races on queries of the same shape after which the "
+             "portfolio solver only runs the backend which won at least three "
+             "quarters of them, 0 meaning never (default=16)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> PortfolioReraceInterval(
+    "portfolio-rerace-interval", cl::init(64),
+    cl::desc("Race all backends again on every n-th query of a shape with a "
+             "preferred backend, 0 meaning never (default=64)"),
+    cl::cat(SolvingCat));
+} // namespace
+
+// Shared memory for the result of each worker. This matches the size
+// STPSolver reserves for its forked counterexamples.
+static const size_t slotSize = 1 << 20;
+
+// Set in the index a worker reports when its result did not fit its slot.
+static const uint8_t slotOverflow = 0x80;
+
+/// Summarizes a query by the kinds of expressions it contains, whether it
+/// reads arrays at symbolic indices or through updates, and the logarithm
+/// of its size. Which backend is fastest mostly depends on these.
+static uint64_t getQueryShape(const Query &query) {
+  static_assert(Expr::LastKind < 40, "expression kinds do not fit the shape");
+  const uint64_t symbolicIndex = uint64_t(1) << 40;
+  const uint64_t updates = uint64_t(1) << 41;
+
+  QueryShape shape(query);
+  return shape.kinds | (shape.symbolicIndex ? symbolicIndex : 0) |
+         (shape.updates ? updates : 0) |
+         (uint64_t(Log2_32(shape.nodes)) << 48);
+}
+
+namespace {
+
+enum class Operation { Truth, Validity, Value, InitialValues };
+
+struct Result {
+  SolverImpl::SolverRunStatus status;
+  bool isValid;
+  Solver::Validity validity;
+  ref<Expr> value;
+  std::shared_ptr<const Assignment> assignment;
+  bool hasSolution;
+};
+
+class SlotWriter {
+  uint8_t *pos, *end;
+
+public:
+  SlotWriter(uint8_t *slot) : pos(slot), end(slot + slotSize) {}
+
+  bool write(const void *data, size_t size) {
+    if (size > size_t(end - pos))
+      return false;
+    memcpy(pos, data, size);
+    pos += size;
+    return true;
+  }
+
+  template <typename T> bool write(const T &value) {
+    return write(&value, sizeof(T));
+  }
+};
+
+class SlotReader {
+  const uint8_t *pos;
+
+public:
+  SlotReader(const uint8_t *slot) : pos(slot) {}
+
+  void read(void *data, size_t size) {
+    memcpy(data, pos, size);
+    pos += size;
+  }
+
+  template <typename T> T read() {
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+};
+
+class PortfolioSolver : public SolverImpl {
+  struct Backend {
+    Solver *solver;
+    Statistic &wins;
+  };
+
+  struct ShapeInfo {
+    unsigned races = 0;
+    unsigned queries = 0;
+    // index of the backend to run alone, or -1
+    int preferred = -1;
+    std::vector<unsigned> wins;
+  };
+
+  std::vector<Backend> backends;
+  std::unordered_map<uint64_t, ShapeInfo> shapes;
+  uint8_t *slots;
+  SolverRunStatus runStatusCode;
+
+  static bool runBackend(Solver *solver, Operation op, const Query &query,
+                         Result &result);
+  static bool writeResult(Operation op, const Query &query,
+                          const Result &result, uint8_t *slot);
+  static void readResult(Operation op, const uint8_t *slot, Result &result);
+
+  int race(Operation op, const Query &query, Result &result);
+  bool run(Operation op, const Query &query, Result &result);
+
+public:
+  PortfolioSolver(
+      const std::vector<std::pair<CoreSolverType, Solver *>> &solvers);
+  ~PortfolioSolver();
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+
+} // namespace
+
+PortfolioSolver::PortfolioSolver(
+    const std::vector<std::pair<CoreSolverType, Solver *>> &solvers)
+    : runStatusCode(SOLVER_RUN_STATUS_FAILURE) {
+  for (const auto &solver : solvers) {
+    Statistic *wins;
+    switch (solver.first) {
+    case STP_SOLVER:
+      wins = &stats::portfolioSTPWins;
+      break;
+    case METASMT_SOLVER:
+      wins = &stats::portfolioMetaSMTWins;
+      break;
+    case DUMMY_SOLVER:
+      wins = &stats::portfolioDummyWins;
+      break;
+    case Z3_SOLVER:
+      wins = &stats::portfolioZ3Wins;
+      break;
+    default:
+      llvm_unreachable("unexpected portfolio backend");
+    }
+    backends.push_back({solver.second, *wins});
+  }
+  assert(backends.size() < slotOverflow && "too many portfolio backends");
+
+  slots = (uint8_t *)mmap(nullptr, slotSize * backends.size(),
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                          -1, 0);
+  if (slots == MAP_FAILED)
+    llvm::report_fatal_error("unable to allocate shared memory region");
+}
+
+PortfolioSolver::~PortfolioSolver() {
+  munmap(slots, slotSize * backends.size());
+  for (auto &backend : backends)
+    delete backend.solver;
+}
+
+bool PortfolioSolver::runBackend(Solver *solver, Operation op,
+                                 const Query &query, Result &result) {
+  bool success = false;
+  switch (op) {
+  case Operation::Truth:
+    success = solver->impl->computeTruth(query, result.isValid);
+    break;
+  case Operation::Validity:
+    success = solver->impl->computeValidity(query, result.validity);
+    break;
+  case Operation::Value:
+    success = solver->impl->computeValue(query, result.value) &&
+              isa<ConstantExpr>(result.value);
+    break;
+  case Operation::InitialValues:
+    success = solver->impl->computeInitialValues(query, result.assignment,
+                                                 result.hasSolution);
+    break;
+  }
+  result.status = solver->impl->getOperationStatusCode();
+  return success;
+}
+
+bool PortfolioSolver::writeResult(Operation op, const Query &query,
+                                  const Result &result, uint8_t *slot) {
+  SlotWriter w(slot);
+  if (!w.write(result.status))
+    return false;
+
+  switch (op) {
+  case Operation::Truth:
+    return w.write(result.isValid);
+  case Operation::Validity:
+    return w.write(result.validity);
+  case Operation::Value: {
+    const APInt &value = cast<ConstantExpr>(result.value)->getAPValue();
+    return w.write(value.getBitWidth()) && w.write(value.getNumWords()) &&
+           w.write(value.getRawData(), value.getNumWords() * sizeof(uint64_t));
+  }
+  case Operation::InitialValues: {
+    if (!w.write(result.hasSolution))
+      return false;
+    if (!result.hasSolution)
+      return true;
+
+    // The worker is a fork of the solver, so arrays are identified by their
+    // addresses.
+    std::vector<ref<Expr>> exprs(query.constraints.begin(),
+                                 query.constraints.end());
+    exprs.push_back(query.expr);
+    std::vector<const Array *> objects;
+    findSymbolicObjects(exprs.begin(), exprs.end(), objects);
+
+    std::vector<std::pair<const Array *, const CompactArrayModel *>> models;
+    for (const Array *array : objects)
+      if (auto model = result.assignment->getBindingsOrNull(array))
+        models.emplace_back(array, model);
+    if (!w.write(models.size()))
+      return false;
+    for (const auto &model : models) {
+      std::map<uint32_t, uint8_t> values = model.second->asMap();
+      if (!w.write(model.first) || !w.write(values.size()))
+        return false;
+      for (const auto &value : values)
+        if (!w.write(value.first) || !w.write(value.second))
+          return false;
+    }
+    return true;
+  }
+  }
+  return false;
+}
+
+void PortfolioSolver::readResult(Operation op, const uint8_t *slot,
+                                 Result &result) {
+  SlotReader r(slot);
+  result.status = r.read<SolverRunStatus>();
+
+  switch (op) {
+  case Operation::Truth:
+    result.isValid = r.read<bool>();
+    break;
+  case Operation::Validity:
+    result.validity = r.read<Solver::Validity>();
+    break;
+  case Operation::Value: {
+    unsigned width = r.read<unsigned>();
+    std::vector<uint64_t> words(r.read<unsigned>());
+    r.read(words.data(), words.size() * sizeof(uint64_t));
+    result.value = ConstantExpr::alloc(APInt(width, words));
+    break;
+  }
+  case Operation::InitialValues: {
+    result.hasSolution = r.read<bool>();
+    if (!result.hasSolution) {
+      result.assignment = nullptr;
+      break;
+    }
+    Assignment::map_bindings_ty models;
+    for (size_t i = 0, e = r.read<size_t>(); i != e; ++i) {
+      MapArrayModel &model = models[r.read<const Array *>()];
+      for (size_t j = 0, je = r.read<size_t>(); j != je; ++j) {
+        uint32_t index = r.read<uint32_t>();
+        model.add(index, r.read<uint8_t>());
+      }
+    }
+    result.assignment = std::make_shared<Assignment>(models);
+    break;
+  }
+  }
+}
+
+/// Runs the query on every backend in a forked worker and returns the index
+/// of the first one to answer, or -1 if none did. The workers report their
+/// index through a pipe once their result is in shared memory, and the
+/// remaining ones are killed. A winner whose result does not fit its slot
+/// is run again in this process.
+int PortfolioSolver::race(Operation op, const Query &query, Result &result) {
+  TimerStatIncrementer t(stats::queryTime);
+  ++stats::queries;
+  ++stats::portfolioRaces;
+  runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  int fds[2];
+  if (pipe(fds) == -1) {
+    klee_warning("pipe failed (for portfolio solver) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    return -1;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+
+  std::vector<pid_t> pids;
+  for (unsigned i = 0; i != backends.size(); ++i) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      klee_warning("fork failed (for portfolio solver) - %s",
+                   llvm::sys::StrError(errno).c_str());
+      continue;
+    }
+    if (pid == 0) {
+      // own process group, so that processes forked by the backend are
+      // killed with it
+      setpgid(0, 0);
+      close(fds[0]);
+      Result r;
+      uint8_t index = i;
+      if (runBackend(backends[i].solver, op, query, r)) {
+        if (!writeResult(op, query, r, slots + i * slotSize))
+          index |= slotOverflow;
+        ssize_t written = write(fds[1], &index, 1);
+        (void)written;
+      }
+      _exit(0);
+    }
+    setpgid(pid, pid);
+    pids.push_back(pid);
+  }
+  close(fds[1]);
+
+  uint8_t winner;
+  ssize_t n;
+  do {
+    n = read(fds[0], &winner, 1);
+  } while (n < 0 && errno == EINTR);
+  close(fds[0]);
+
+  for (pid_t pid : pids)
+    kill(-pid, SIGKILL);
+  for (pid_t pid : pids) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  if (n != 1) {
+    if (pids.empty())
+      runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+    return -1;
+  }
+
+  if (winner & slotOverflow) {
+    winner &= ~slotOverflow;
+    klee_warning_once(0, "portfolio result does not fit its shared memory "
+                         "slot, running the winning backend in-process");
+    bool success = runBackend(backends[winner].solver, op, query, result);
+    runStatusCode = result.status;
+    if (!success)
+      return -1;
+  } else {
+    readResult(op, slots + winner * slotSize, result);
+    runStatusCode = result.status;
+  }
+  ++backends[winner].wins;
+  return winner;
+}
+
+bool PortfolioSolver::run(Operation op, const Query &query, Result &result) {
+  ShapeInfo &shape = shapes[getQueryShape(query)];
+  ++shape.queries;
+
+  if (shape.preferred >= 0 && (!PortfolioReraceInterval ||
+                               shape.queries % PortfolioReraceInterval)) {
+    Backend &backend = backends[shape.preferred];
+    ++stats::portfolioShortcuts;
+    bool success = runBackend(backend.solver, op, query, result);
+    runStatusCode = result.status;
+    if (success)
+      return true;
+    // the preferred backend failed, maybe another one does better
+  }
+
+  int winner = race(op, query, result);
+  if (winner < 0)
+    return false;
+
+  shape.wins.resize(backends.size());
+  ++shape.wins[winner];
+  ++shape.races;
+  if (PortfolioLearnAfter && shape.races >= PortfolioLearnAfter) {
+    auto best = std::max_element(shape.wins.begin(), shape.wins.end());
+    if (*best * 4 >= shape.races * 3)
+      shape.preferred = best - shape.wins.begin();
+    else
+      shape.preferred = -1;
+  }
+  return true;
+}
+
+bool PortfolioSolver::computeTruth(const Query &query, bool &isValid) {
+  Result result;
+  if (!run(Operation::Truth, query, result))
+    return false;
+  isValid = result.isValid;
+  return true;
+}
+
+bool PortfolioSolver::computeValidity(const Query &query,
+                                      Solver::Validity &validity) {
+  Result result;
+  if (!run(Operation::Validity, query, result))
+    return false;
+  validity = result.validity;
+  return true;
+}
+
+bool PortfolioSolver::computeValue(const Query &query, ref<Expr> &value) {
+  Result result;
+  if (!run(Operation::Value, query, result))
+    return false;
+  value = result.value;
+  return true;
+}
+
+bool PortfolioSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &assignment,
+    bool &hasSolution) {
+  Result result;
+  if (!run(Operation::InitialValues, query, result))
+    return false;
+  assignment = result.assignment;
+  hasSolution = result.hasSolution;
+  return true;
+}
+
+SolverImpl::SolverRunStatus PortfolioSolver::getOperationStatusCode() {
+  return runStatusCode;
+}
+
+char *PortfolioSolver::getConstraintLog(const Query &query) {
+  return backends.front().solver->getConstraintLog(query);
+}
+
+void PortfolioSolver::setCoreSolverTimeout(time::Span timeout) {
+  for (auto &backend : backends)
+    backend.solver->setCoreSolverTimeout(timeout);
+}
+
+Solver *klee::createPortfolioSolver(
+    const std::vector<std::pair<CoreSolverType, Solver *>> &solvers) {
+  return new Solver(new PortfolioSolver(solvers));
+}
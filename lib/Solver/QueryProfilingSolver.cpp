@@ -0,0 +1,291 @@
+//===-- QueryProfilingSolver.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryShape.h"
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Internal/Support/ErrorHandling.h"
+#include "klee/Internal/Support/FileHandling.h"
+#include "klee/Internal/System/Time.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Statistics.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace klee;
+
+namespace {
+
+/// Describes a query by its type and the features of its QueryShape, with
+/// sizes rounded to powers of two, so that similar queries share a shape.
+std::string getQueryShape(const char *type, const Query &query) {
+  QueryShape shape(query);
+  std::string result;
+  llvm::raw_string_ostream os(result);
+  os << type << " constraints<=" << llvm::PowerOf2Ceil(query.constraints.size())
+     << " nodes<=" << llvm::PowerOf2Ceil(shape.nodes)
+     << " arrays=" << shape.arrays;
+  if (shape.symbolicIndex)
+    os << " symbolic-index";
+  if (shape.updates)
+    os << " updates";
+  if (shape.nonlinear)
+    os << " nonlinear";
+  if (shape.symbolicShift)
+    os << " symbolic-shift";
+  if (shape.wide)
+    os << " wide";
+  return os.str();
+}
+
+struct Profile {
+  uint64_t count = 0;
+  time::Span time;
+};
+
+class QueryProfilingSolver : public SolverImpl {
+  struct HotQuery {
+    time::Span time;
+    unsigned location;
+    std::string shape;
+    std::string kquery;
+
+    bool operator<(const HotQuery &other) const { return time > other.time; }
+  };
+
+  Solver *solver;
+  std::string reportPath;
+  std::string queryPathPrefix;
+  unsigned numHotQueries;
+  std::function<std::string(unsigned)> getLocationName;
+
+  std::map<std::pair<unsigned, std::string>, Profile> profiles;
+  // a heap of the slowest queries, the fastest of them on top
+  std::vector<HotQuery> hotQueries;
+
+  template <typename F>
+  bool profile(const char *type, const Query &query, F solve,
+               const Query *falseQuery = 0,
+               const std::vector<const Array *> *objects = 0);
+
+  void writeReport();
+
+public:
+  QueryProfilingSolver(Solver *_solver, std::string _reportPath,
+                       std::string _queryPathPrefix, unsigned _numHotQueries,
+                       std::function<std::string(unsigned)> _getLocationName)
+      : solver(_solver), reportPath(_reportPath),
+        queryPathPrefix(_queryPathPrefix), numHotQueries(_numHotQueries),
+        getLocationName(_getLocationName) {}
+
+  ~QueryProfilingSolver() {
+    writeReport();
+    delete solver;
+  }
+
+  bool computeTruth(const Query &query, bool &isValid) {
+    return profile("Truth", query, [&]() {
+      return solver->impl->computeTruth(query, isValid);
+    });
+  }
+
+  bool computeValidity(const Query &query, Solver::Validity &result) {
+    return profile("Validity", query, [&]() {
+      return solver->impl->computeValidity(query, result);
+    });
+  }
+
+  bool computeValue(const Query &query, ref<Expr> &result) {
+    Query withFalse = query.withFalse();
+    return profile("Value", query, [&]() {
+      return solver->impl->computeValue(query, result);
+    }, &withFalse);
+  }
+
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) {
+    std::vector<const Array *> objects;
+    if (numHotQueries) {
+      findSymbolicObjects(query.constraints.begin(), query.constraints.end(),
+                          objects);
+      findSymbolicObjects(query.expr, objects);
+    }
+    return profile("InitialValues", query, [&]() {
+      return solver->impl->computeInitialValues(query, result, hasSolution);
+    }, 0, &objects);
+  }
+
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+
+  void setCoreSolverTimeout(time::Span timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+template <typename F>
+bool QueryProfilingSolver::profile(const char *type, const Query &query,
+                                   F solve, const Query *falseQuery,
+                                   const std::vector<const Array *> *objects) {
+  // queries are charged to the instruction executing when they are issued,
+  // like the solver time in the istats
+  unsigned location = theStatisticManager ? theStatisticManager->getIndex() : 0;
+  time::Point start = time::getWallTime();
+  bool success = solve();
+  time::Span elapsed = time::getWallTime() - start;
+
+  std::string shape = getQueryShape(type, query);
+  Profile &p = profiles[std::make_pair(location, shape)];
+  ++p.count;
+  p.time += elapsed;
+
+  if (numHotQueries &&
+      (hotQueries.size() < numHotQueries || hotQueries.front().time < elapsed)) {
+    HotQuery hq;
+    hq.time = elapsed;
+    hq.location = location;
+    hq.shape = shape;
+
+    // printed like by the .kquery query log, so that kleaver can replay it
+    llvm::raw_string_ostream os(hq.kquery);
+    const ref<Expr> *evalExprsBegin = 0, *evalExprsEnd = 0;
+    if (falseQuery) {
+      evalExprsBegin = &query.expr;
+      evalExprsEnd = &query.expr + 1;
+    }
+    const Array *const *evalArraysBegin = 0, *const *evalArraysEnd = 0;
+    if (objects && !objects->empty()) {
+      evalArraysBegin = objects->data();
+      evalArraysEnd = objects->data() + objects->size();
+    }
+    const Query &q = falseQuery ? *falseQuery : query;
+    ExprPPrinter::printQuery(os, q.constraints, q.expr, evalExprsBegin,
+                             evalExprsEnd, evalArraysBegin, evalArraysEnd);
+    os.flush();
+
+    hotQueries.push_back(std::move(hq));
+    std::push_heap(hotQueries.begin(), hotQueries.end());
+    if (hotQueries.size() > numHotQueries) {
+      std::pop_heap(hotQueries.begin(), hotQueries.end());
+      hotQueries.pop_back();
+    }
+  }
+
+  return success;
+}
+
+static void printRanked(llvm::raw_ostream &os, const char *title,
+                        std::vector<std::pair<std::string, Profile> > &profiles,
+                        time::Span total) {
+  std::stable_sort(profiles.begin(), profiles.end(),
+                   [](const std::pair<std::string, Profile> &a,
+                      const std::pair<std::string, Profile> &b) {
+                     return a.second.time > b.second.time;
+                   });
+  os << "\n# " << title << "\n"
+     << "# Time(s)   Share  Queries  Avg(ms)\n";
+  for (const auto &it : profiles) {
+    double seconds = it.second.time.toSeconds();
+    os << llvm::format("%9.3f %6.1f%% %8lu %8.3f  ", seconds,
+                       total ? 100 * seconds / total.toSeconds() : 0.,
+                       it.second.count, 1000 * seconds / it.second.count)
+       << it.first << "\n";
+  }
+}
+
+void QueryProfilingSolver::writeReport() {
+  std::map<unsigned, std::string> locationNames;
+  auto getName = [&](unsigned location) -> const std::string & {
+    auto it = locationNames.find(location);
+    if (it == locationNames.end())
+      it = locationNames.insert({location, getLocationName(location)}).first;
+    return it->second;
+  };
+
+  std::map<unsigned, Profile> byLocation;
+  std::map<std::string, Profile> byShape;
+  std::vector<std::pair<std::string, Profile> > byBoth;
+  time::Span total;
+  uint64_t count = 0;
+  for (const auto &it : profiles) {
+    Profile &l = byLocation[it.first.first];
+    Profile &s = byShape[it.first.second];
+    l.count += it.second.count;
+    s.count += it.second.count;
+    l.time += it.second.time;
+    s.time += it.second.time;
+    total += it.second.time;
+    count += it.second.count;
+    byBoth.push_back({getName(it.first.first) + "  " + it.first.second,
+                      it.second});
+  }
+
+  std::string error;
+  auto os = klee_open_output_file(reportPath, error);
+  if (!os) {
+    klee_warning("Could not open file %s : %s", reportPath.c_str(),
+                 error.c_str());
+    return;
+  }
+
+  std::vector<std::pair<std::string, Profile> > ranked;
+  for (const auto &it : byLocation)
+    ranked.push_back({getName(it.first), it.second});
+  *os << "# Queries: " << count << ", time: " << total << "\n";
+  printRanked(*os, "By location", ranked, total);
+  ranked.assign(byShape.begin(), byShape.end());
+  printRanked(*os, "By query shape", ranked, total);
+  printRanked(*os, "By location and query shape", byBoth, total);
+
+  std::sort_heap(hotQueries.begin(), hotQueries.end());
+  if (!hotQueries.empty())
+    *os << "\n# Slowest queries\n";
+  for (unsigned i = 0; i != hotQueries.size(); ++i) {
+    const HotQuery &hq = hotQueries[i];
+    std::string path = queryPathPrefix + llvm::utostr(i + 1) + ".kquery";
+    *os << llvm::format("%9.3f  ", hq.time.toSeconds()) << path << "  "
+        << getName(hq.location) << "  " << hq.shape << "\n";
+
+    auto qos = klee_open_output_file(path, error);
+    if (!qos) {
+      klee_warning("Could not open file %s : %s", path.c_str(), error.c_str());
+      continue;
+    }
+    *qos << "# Time: " << hq.time << "\n"
+         << "# Location: " << getName(hq.location) << "\n"
+         << "# Shape: " << hq.shape << "\n"
+         << hq.kquery;
+  }
+}
+} // namespace
+
+Solver *klee::createQueryProfilingSolver(
+    Solver *s, std::string reportPath, std::string queryPathPrefix,
+    unsigned numHotQueries,
+    std::function<std::string(unsigned)> getLocationName) {
+  return new Solver(new QueryProfilingSolver(s, reportPath, queryPathPrefix,
+                                             numHotQueries, getLocationName));
+}
@@ -0,0 +1,72 @@
+//===-- QueryShape.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryShape.h"
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/Solver.h"
+
+#include <unordered_set>
+#include <vector>
+
+using namespace klee;
+
+QueryShape::QueryShape(const Query &query) {
+  static_assert(Expr::LastKind < 64, "expression kinds do not fit the shape");
+  std::unordered_set<const Array *> arraysRead;
+  std::unordered_set<const Expr *> visited;
+  std::vector<const Expr *> stack;
+  for (const auto &constraint : query.constraints)
+    stack.push_back(constraint.get());
+  stack.push_back(query.expr.get());
+  while (!stack.empty()) {
+    const Expr *e = stack.back();
+    stack.pop_back();
+    if (!visited.insert(e).second)
+      continue;
+    ++nodes;
+    kinds |= uint64_t(1) << e->getKind();
+    if (e->getWidth() > 64)
+      wide = true;
+    switch (e->getKind()) {
+    case Expr::Read: {
+      const ReadExpr *re = cast<ReadExpr>(e);
+      arraysRead.insert(re->updates.root);
+      if (!isa<ConstantExpr>(re->index))
+        symbolicIndex = true;
+      for (const UpdateNode *un = re->updates.head; un; un = un->next) {
+        updates = true;
+        stack.push_back(un->index.get());
+        stack.push_back(un->value.get());
+      }
+      break;
+    }
+    case Expr::Mul:
+    case Expr::UDiv:
+    case Expr::SDiv:
+    case Expr::URem:
+    case Expr::SRem:
+      if (!isa<ConstantExpr>(e->getKid(0)) && !isa<ConstantExpr>(e->getKid(1)))
+        nonlinear = true;
+      break;
+    case Expr::Shl:
+    case Expr::LShr:
+    case Expr::AShr:
+      if (!isa<ConstantExpr>(e->getKid(1)))
+        symbolicShift = true;
+      break;
+    default:
+      break;
+    }
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      stack.push_back(e->getKid(i).get());
+  }
+  arrays = arraysRead.size();
+}
@@ -0,0 +1,44 @@
+//===-- QueryShape.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYSHAPE_H
+#define KLEE_QUERYSHAPE_H
+
+#include <cstdint>
+
+namespace klee {
+struct Query;
+
+/// QueryShape - The features of a query which usually decide how hard it
+/// is for a core solver, gathered in one walk over its expression DAG,
+/// including the indices and values of array updates.
+struct QueryShape {
+  /// A bit for each kind of expression in the query.
+  uint64_t kinds = 0;
+  /// The number of distinct expressions.
+  unsigned nodes = 0;
+  /// The number of distinct arrays read.
+  unsigned arrays = 0;
+  /// Whether an array is read at a symbolic index.
+  bool symbolicIndex = false;
+  /// Whether an array is read through updates.
+  bool updates = false;
+  /// Whether two symbolic values are multiplied or divided.
+  bool nonlinear = false;
+  /// Whether a value is shifted by a symbolic amount.
+  bool symbolicShift = false;
+  /// Whether a bitvector is wider than 64 bits.
+  bool wide = false;
+
+  explicit QueryShape(const Query &query);
+};
+
+} // namespace klee
+
+#endif /* KLEE_QUERYSHAPE_H */
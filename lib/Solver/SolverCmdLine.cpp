@@ -51,6 +51,18 @@ cl::opt<bool> UseBranchCache("use-branch-cache", cl::init(true),
                              cl::desc("Use the branch cache (default=true)"),
                              cl::cat(SolvingCat));
 
+cl::opt<std::string> PersistentQueryCache(
+    "persistent-query-cache",
+    cl::desc("Cache solver results in the given file, which can be reused by "
+             "later runs and shared by concurrent runs (default=off)"),
+    cl::value_desc("path"), cl::cat(SolvingCat));
+
+cl::opt<unsigned> PersistentQueryCacheSize(
+    "persistent-query-cache-size", cl::init(256),
+    cl::desc("Size in MiB of a newly created persistent query cache "
+             "(default=256)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool>
     UseIndependentSolver("use-independent-solver", cl::init(true),
                          cl::desc("Use constraint independence (default=true)"),
@@ -195,10 +207,23 @@ cl::opt<CoreSolverType> CoreSolverToUse(
                clEnumValN(METASMT_SOLVER, "metasmt",
                           "metaSMT" METASMT_IS_DEFAULT_STR),
                clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
-               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR)
+               clEnumValN(Z3_SOLVER, "z3", "Z3" Z3_IS_DEFAULT_STR),
+               clEnumValN(PORTFOLIO_SOLVER, "portfolio",
+                          "Race the backends of --portfolio-solvers")
                    KLEE_LLVM_CL_VAL_END),
     cl::init(DEFAULT_CORE_SOLVER), cl::cat(SolvingCat));
 
+cl::list<CoreSolverType> PortfolioSolvers(
+    "portfolio-solvers",
+    cl::desc("Comma-separated list of the backends the portfolio solver races "
+             "(default=all available)"),
+    cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+               clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+               clEnumValN(DUMMY_SOLVER, "dummy", "Dummy solver"),
+               clEnumValN(Z3_SOLVER, "z3", "Z3")
+                   KLEE_LLVM_CL_VAL_END),
+    cl::CommaSeparated, cl::cat(SolvingCat));
+
 cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
     "debug-crosscheck-core-solver",
     cl::desc(
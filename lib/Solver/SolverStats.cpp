@@ -11,17 +11,28 @@
 
 using namespace klee;
 
+Statistic stats::cexCacheLookupTime("CexCacheLookupTime", "CCLtime");
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
+Statistic stats::portfolioDummyWins("PortfolioDummyWins", "PFdummywins");
+Statistic stats::portfolioMetaSMTWins("PortfolioMetaSMTWins", "PFmetaSMTwins");
+Statistic stats::portfolioRaces("PortfolioRaces", "PFraces");
+Statistic stats::portfolioShortcuts("PortfolioShortcuts", "PFshortcuts");
+Statistic stats::portfolioSTPWins("PortfolioSTPWins", "PFSTPwins");
+Statistic stats::portfolioZ3Wins("PortfolioZ3Wins", "PFZ3wins");
 Statistic stats::queries("Queries", "Q");
 Statistic stats::queriesInvalid("QueriesInvalid", "Qiv");
 Statistic stats::queriesValid("QueriesValid", "Qv");
 Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
+Statistic stats::queryCexCacheEvictions("QueryCexCacheEvictions", "QCexEvictions");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
 Statistic stats::queryConstructTime("QueryConstructTime", "QBtime") ;
+Statistic stats::queryConstraintsReused("QueryConstraintsReused", "QCreused");
 Statistic stats::queryConstructs("QueriesConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits", "QPChits");
+Statistic stats::queryPersistentCacheMisses("QueryPersistentCacheMisses", "QPCmisses");
 Statistic stats::queryTime("QueryTime", "Qtime");
 
 #ifdef KLEE_ARRAY_DEBUG
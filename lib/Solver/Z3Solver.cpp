@@ -27,6 +27,9 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace {
 // NOTE: Very useful for debugging Z3 behaviour. These files can be given to
 // the z3 binary to replay all Z3 API calls using its `-log` option.
@@ -49,6 +52,20 @@ llvm::cl::opt<unsigned>
     Z3VerbosityLevel("debug-z3-verbosity", llvm::cl::init(0),
                      llvm::cl::desc("Z3 verbosity level (default=0)"),
                      llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<bool> Z3Incremental(
+    "z3-incremental", llvm::cl::init(false),
+    llvm::cl::desc("Keep Z3 solvers alive across queries and reuse the "
+                   "constraints they share with the next query using "
+                   "push/pop. Note that Z3 uses a different, sometimes "
+                   "slower, solver internally in this mode (default=false)"),
+    llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> Z3IncrementalSolvers(
+    "z3-incremental-solvers", llvm::cl::init(8),
+    llvm::cl::desc("Number of Z3 solvers kept alive by -z3-incremental, the "
+                   "least recently used one is replaced (default=8)"),
+    llvm::cl::cat(klee::SolvingCat));
 }
 
 #include "llvm/Support/ErrorHandling.h"
@@ -57,6 +74,18 @@ namespace klee {
 
 class Z3SolverImpl : public SolverImpl {
 private:
+  /// A solver kept alive by the incremental mode. Every constraint is
+  /// asserted in its own push frame, so the solver can be rolled back to
+  /// any prefix of the constraints.
+  struct IncrementalSolver {
+    ::Z3_solver solver;
+    std::vector<ref<Expr> > constraints;
+    /// Constant arrays whose values are asserted, mapped to the number of
+    /// constraints asserted before them.
+    std::unordered_map<const Array *, size_t> constantArrays;
+    uint64_t lastUse;
+  };
+
   Z3Builder *builder;
   time::Span timeout;
   SolverRunStatus runStatusCode;
@@ -65,10 +94,17 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  std::vector<IncrementalSolver> incrementalSolvers;
+  uint64_t incrementalUses = 0;
+
   bool internalRunSolver(const Query &,
                          std::shared_ptr<const Assignment> &result,
                          bool &hasSolution,
                          bool needsModel);
+  IncrementalSolver &getIncrementalSolver(const Query &query);
+  void assertConstantArrays(::Z3_solver theSolver, ref<Expr> e,
+                            std::unordered_map<const Array *, size_t> &asserted,
+                            size_t level, bool record = true);
   bool validateZ3Model(::Z3_solver &theSolver, ::Z3_model &theModel);
 
 public:
@@ -133,6 +169,8 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  for (auto &incremental : incrementalSolvers)
+    Z3_solver_dec_ref(builder->ctx, incremental.solver);
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -249,22 +287,29 @@ bool Z3SolverImpl::internalRunSolver(
     bool needsModel) {
 
   TimerStatIncrementer t(stats::queryTime);
-  // NOTE: Z3 will switch to using a slower solver internally if push/pop are
-  // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
-  //
-  // TODO: Investigate using a custom tactic as described in
-  // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
-
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
-    constant_arrays_in_query.visit(constraint);
+  Z3_solver theSolver;
+  IncrementalSolver *incremental = nullptr;
+  if (Z3Incremental) {
+    incremental = &getIncrementalSolver(query);
+    theSolver = incremental->solver;
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+    // the query itself is only asserted for this check
+    Z3_solver_push(builder->ctx, theSolver);
+  } else {
+    // NOTE: Z3 will switch to using a slower solver internally if push/pop
+    // are used so by default it is likely that creating a new solver each
+    // time is the right way to go until Z3 changes its behaviour.
+    //
+    // TODO: Investigate using a custom tactic as described in
+    // https://github.com/klee/klee/issues/653
+    theSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    for (auto const &constraint : query.constraints)
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
   }
   ++stats::queries;
   if (needsModel)
@@ -272,15 +317,16 @@ bool Z3SolverImpl::internalRunSolver(
 
   Z3ASTHandle z3QueryExpr =
       Z3ASTHandle(builder->construct(query.expr), builder->ctx);
-  constant_arrays_in_query.visit(query.expr);
 
-  for (auto const &constant_array : constant_arrays_in_query.results) {
-    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
-           "Constant array found in query, but not handled by Z3Builder");
-    for (auto const &arrayIndexValueExpr :
-         builder->constant_array_assertions[constant_array]) {
-      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
-    }
+  if (incremental) {
+    // arrays first seen in the query are popped together with it
+    assertConstantArrays(theSolver, query.expr, incremental->constantArrays,
+                         incremental->constraints.size(), /*record=*/false);
+  } else {
+    std::unordered_map<const Array *, size_t> asserted;
+    for (auto const &constraint : query.constraints)
+      assertConstantArrays(theSolver, constraint, asserted, 0);
+    assertConstantArrays(theSolver, query.expr, asserted, 0);
   }
 
   // KLEE Queries are validity queries i.e.
@@ -305,7 +351,10 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(query, theSolver, satisfiable, result,
                                        hasSolution, needsModel);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
+  if (incremental)
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+  else
+    Z3_solver_dec_ref(builder->ctx, theSolver);
   // Clear the builder's cache to prevent memory usage exploding.
   // By using ``autoClearConstructCache=false`` and clearning now
   // we allow Z3_ast expressions to be shared from an entire
@@ -325,6 +374,93 @@ bool Z3SolverImpl::internalRunSolver(
   return false; // failed
 }
 
+void Z3SolverImpl::assertConstantArrays(
+    ::Z3_solver theSolver, ref<Expr> e,
+    std::unordered_map<const Array *, size_t> &asserted, size_t level,
+    bool record) {
+  ConstantArrayFinder constant_arrays;
+  constant_arrays.visit(e);
+  for (auto const &constant_array : constant_arrays.results) {
+    if (asserted.count(constant_array))
+      continue;
+    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
+           "Constant array found in query, but not handled by Z3Builder");
+    for (auto const &arrayIndexValueExpr :
+         builder->constant_array_assertions[constant_array]) {
+      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+    }
+    if (record)
+      asserted[constant_array] = level;
+  }
+}
+
+Z3SolverImpl::IncrementalSolver &
+Z3SolverImpl::getIncrementalSolver(const Query &query) {
+  // Pick the solver sharing the longest prefix of constraints with the
+  // query, preferring the most recently used one.
+  IncrementalSolver *best = nullptr;
+  size_t bestPrefix = 0;
+  for (auto &incremental : incrementalSolvers) {
+    size_t prefix = 0;
+    auto it = query.constraints.begin(), ie = query.constraints.end();
+    for (; prefix < incremental.constraints.size() && it != ie;
+         ++prefix, ++it) {
+      if (incremental.constraints[prefix] != *it)
+        break;
+    }
+    if (!best || prefix > bestPrefix ||
+        (prefix == bestPrefix && incremental.lastUse > best->lastUse)) {
+      best = &incremental;
+      bestPrefix = prefix;
+    }
+  }
+
+  if (bestPrefix == 0) {
+    // nothing to reuse, start from a new solver
+    if (incrementalSolvers.size() <
+        std::max(1u, Z3IncrementalSolvers.getValue())) {
+      incrementalSolvers.emplace_back();
+      best = &incrementalSolvers.back();
+    } else {
+      best = &*std::min_element(
+          incrementalSolvers.begin(), incrementalSolvers.end(),
+          [](const IncrementalSolver &a, const IncrementalSolver &b) {
+            return a.lastUse < b.lastUse;
+          });
+      Z3_solver_dec_ref(builder->ctx, best->solver);
+    }
+    best->solver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, best->solver);
+    best->constraints.clear();
+    best->constantArrays.clear();
+  } else if (bestPrefix < best->constraints.size()) {
+    Z3_solver_pop(builder->ctx, best->solver,
+                  best->constraints.size() - bestPrefix);
+    best->constraints.resize(bestPrefix);
+    for (auto it = best->constantArrays.begin();
+         it != best->constantArrays.end();) {
+      if (it->second > bestPrefix)
+        it = best->constantArrays.erase(it);
+      else
+        ++it;
+    }
+  }
+  best->lastUse = ++incrementalUses;
+
+  auto it = query.constraints.begin(), ie = query.constraints.end();
+  std::advance(it, bestPrefix);
+  for (; it != ie; ++it) {
+    Z3_solver_push(builder->ctx, best->solver);
+    Z3_solver_assert(builder->ctx, best->solver, builder->construct(*it));
+    best->constraints.push_back(*it);
+    assertConstantArrays(best->solver, *it, best->constantArrays,
+                         best->constraints.size());
+  }
+  stats::queryConstraintsReused += bestPrefix;
+
+  return *best;
+}
+
 SolverImpl::SolverRunStatus Z3SolverImpl::handleSolverResponse(
     const Query &query,
     ::Z3_solver theSolver, ::Z3_lbool satisfiable,
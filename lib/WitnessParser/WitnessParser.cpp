@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <cctype>
 #include <cstring>
 #include <string>
 #include <queue>
@@ -10,7 +11,11 @@
 #include "klee/Expr/Expr.h"
 #include "witnessChecking/WitnessParser.h"
 #include "klee/Internal/Support/ErrorHandling.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ConvertUTF.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 namespace klee {
 llvm::cl::OptionCategory WitnessCat("Witness validator options",
@@ -24,247 +29,467 @@ llvm::cl::opt<bool> RefuteWitness(
 };
 
 
-void rapidxml::parse_error_handler(const char *what, void *where) {
-    klee::klee_error("Parsing failed: %s", what);
-}
-
-void print_err_invalid(const std::string& val, const char* attr) {
-    klee::klee_error("Parsing failed: %s is not a valid value for key %s",
-                     val.c_str(), attr);
-}
+namespace {
+/// Reads an XML document one tag or text at a time. It supports the subset
+/// of XML that GraphML witnesses use: elements with attributes, text with
+/// the predefined and numeric character references, CDATA sections,
+/// comments, and declarations, which are skipped.
+class XMLReader {
+    const char *pos;
+    const char *end;
+    // a self-closing tag was read, whose end is the next token
+    bool pending_end = false;
 
-// Set attr value according to the string str
-void set_bool_val(const char* str, const char* attr_name, bool& attr) {
-    if (strcmp(str, "") == 0)
-        return;
-    if (str == std::string("true")) {
-        attr = true; return;
+    [[noreturn]] void error(const char *what) {
+        klee::klee_error("Parsing failed: %s", what);
     }
-    if (str == std::string("false")) {
-        attr = false; return;
+    bool starts_with(const char *prefix) const {
+        return llvm::StringRef(pos, end - pos).startswith(prefix);
     }
-    print_err_invalid(str, attr_name);
+    void skip_past(const char *terminator);
+    void skip_space();
+    llvm::StringRef read_name();
+
+public:
+    enum Token { Start, End, Text, Eof };
+
+    // the name of the element of the last start or end tag
+    llvm::StringRef name;
+    // the attributes of the last start tag
+    std::vector<std::pair<llvm::StringRef, std::string> > attributes;
+    // the last text
+    std::string text;
+
+    explicit XMLReader(llvm::StringRef buffer)
+        : pos(buffer.begin()), end(buffer.end()) {}
+
+    Token next();
+
+    const std::string* get_attribute(llvm::StringRef key) const {
+        for (const auto& attribute : attributes)
+            if (attribute.first == key)
+                return &attribute.second;
+        return nullptr;
+    }
+};
 }
 
-// Parse data nodes of element graph and load into the automaton
-void WitnessAutomaton::fill_data(rapidxml::xml_node<>* root) {
-    rapidxml::xml_node<> *data_node = root->first_node("data");
-    char * attr;
-    while (data_node) {
-        attr = data_node->first_attribute("key")->value();
-        if (strcmp(attr, "witness-type") == 0) {
-            if (strcmp(data_node->value(), "violation_witness") != 0)
-                klee::klee_error("Only error witnesses are supported");
-            data.type = data_node->value();
+// Append the text in [begin, end) to out, replacing character references
+static void decode(const char *begin, const char *end, std::string& out) {
+    while (begin != end) {
+        const char *amp = static_cast<const char *>(
+            std::memchr(begin, '&', end - begin));
+        if (!amp) {
+            out.append(begin, end);
+            return;
         }
-        else if (strcmp(attr, "sourcecodelang") == 0) {
-            char *lang = data_node->value();
-            if (strcmp(lang, "C") != 0 && strcmp(lang, "c") != 0) {
-                klee::klee_message("Only C language is supported");
-                print_err_invalid(lang, "sourcecodelang");
-            }
-            data.lang = lang;
+        out.append(begin, amp);
+        const char *semi = static_cast<const char *>(
+            std::memchr(amp, ';', end - amp));
+        if (!semi) {
+            out.append(amp, end);
+            return;
         }
-        else if (strcmp(attr, "producer") == 0)
-            data.producer = data_node->value();
-        else if (strcmp(attr, "specification") == 0)
-            load_spec(data_node->value());
-        else if (strcmp(attr, "programfile") == 0)
-            data.file = data_node->value();
-        else if (strcmp(attr, "programhash") == 0)
-            data.hash = data_node->value();
-        else if (strcmp(attr, "architecture") == 0)
-            data.arch = data_node->value();
-        else if (strcmp(attr, "creationtime") == 0)
-            data.time = data_node->value();
-       // else {
-       //     std::cerr << "parse error: unknown attribute " << attr << std::endl;
-       // }
-        data_node = data_node->next_sibling("data");
-    }
-    if (data.spec.empty()) {
-        klee::klee_error("Parsing failed: Invalid or missing witness specification");
+        llvm::StringRef ref(amp + 1, semi - amp - 1);
+        unsigned long code;
+        if (ref == "lt")
+            out += '<';
+        else if (ref == "gt")
+            out += '>';
+        else if (ref == "amp")
+            out += '&';
+        else if (ref == "quot")
+            out += '"';
+        else if (ref == "apos")
+            out += '\'';
+        else if (ref.startswith("#x") && !ref.drop_front(2).getAsInteger(16, code)) {
+            char utf8[UNI_MAX_UTF8_BYTES_PER_CODE_POINT], *p = utf8;
+            if (llvm::ConvertCodePointToUTF8(code, p))
+                out.append(utf8, p);
+        } else if (ref.startswith("#") && !ref.drop_front(1).getAsInteger(10, code)) {
+            char utf8[UNI_MAX_UTF8_BYTES_PER_CODE_POINT], *p = utf8;
+            if (llvm::ConvertCodePointToUTF8(code, p))
+                out.append(utf8, p);
+        } else {
+            // unknown references are kept
+            out.append(amp, semi + 1);
+        }
+        begin = semi + 1;
     }
 }
 
-// Add nodes to the automaton
-void WitnessAutomaton::fill_nodes(rapidxml::xml_node<> *root) {
-    rapidxml::xml_node<> *child = root->first_node("node");
-    std::string id;
-    while (child) {
-        if (!child->first_attribute("id")) {
-            klee::klee_error("Parsing failed: Node missing attribute id");
+void XMLReader::skip_past(const char *terminator) {
+    llvm::StringRef rest(pos, end - pos);
+    size_t i = rest.find(terminator);
+    if (i == llvm::StringRef::npos)
+        error("unexpected end of data");
+    pos += i + std::strlen(terminator);
+}
+
+void XMLReader::skip_space() {
+    while (pos != end && std::isspace(static_cast<unsigned char>(*pos)))
+        ++pos;
+}
+
+llvm::StringRef XMLReader::read_name() {
+    const char *begin = pos;
+    while (pos != end && !std::isspace(static_cast<unsigned char>(*pos)) &&
+           *pos != '/' && *pos != '>' && *pos != '=')
+        ++pos;
+    if (pos == begin)
+        error("expected element name");
+    return llvm::StringRef(begin, pos - begin);
+}
+
+XMLReader::Token XMLReader::next() {
+    if (pending_end) {
+        pending_end = false;
+        return End;
+    }
+    while (pos != end) {
+        if (*pos != '<') {
+            const char *begin = pos;
+            pos = static_cast<const char *>(std::memchr(pos, '<', end - pos));
+            if (!pos)
+                pos = end;
+            text.clear();
+            decode(begin, pos, text);
+            return Text;
         }
-        id = child->first_attribute("id")->value();
-        if (id.empty() || nodes.find(id) != nodes.end()) {
-            klee::klee_error("Parsing failed: Missing or duplicate node id");
+        if (starts_with("<!--")) {
+            skip_past("-->");
+            continue;
+        }
+        if (starts_with("<![CDATA[")) {
+            const char *begin = pos + 9;
+            skip_past("]]>");
+            text.assign(begin, pos - 3);
+            return Text;
+        }
+        if (starts_with("<?") || starts_with("<!")) {
+            skip_past(">");
+            continue;
+        }
+        if (starts_with("</")) {
+            pos += 2;
+            name = read_name();
+            skip_space();
+            if (pos == end || *pos != '>')
+                error("expected >");
+            ++pos;
+            return End;
         }
-        node_ptr node(std::make_shared<WitnessNode>());
-        nodes[id] = node;
-        node->id=id;
-
-        fill_node_data(child, nodes[id]);
 
-        if (nodes[id]->entry) {
-            if (entry) {
-                klee::klee_error("Parsing failed: Duplicate entry node");
+        ++pos;
+        name = read_name();
+        attributes.clear();
+        while (true) {
+            skip_space();
+            if (pos == end)
+                error("unexpected end of data");
+            if (*pos == '>') {
+                ++pos;
+                return Start;
             }
-            entry = nodes[id];
-        }
-        if (nodes[id]->violation) {
-            violation.emplace(node);
+            if (*pos == '/') {
+                if (++pos == end || *pos != '>')
+                    error("expected >");
+                ++pos;
+                pending_end = true;
+                return Start;
+            }
+            llvm::StringRef key = read_name();
+            skip_space();
+            if (pos == end || *pos != '=')
+                error("expected =");
+            ++pos;
+            skip_space();
+            if (pos == end || (*pos != '"' && *pos != '\''))
+                error("expected ' or \"");
+            const char *begin = ++pos;
+            pos = static_cast<const char *>(std::memchr(pos, pos[-1], end - pos));
+            if (!pos)
+                error("unexpected end of data");
+            attributes.emplace_back(key, std::string());
+            decode(begin, pos, attributes.back().second);
+            ++pos;
         }
-        child = child->next_sibling("node");
     }
-    if (!entry)
-        klee::klee_error("Parsing failed: Missing entry node");
-    if (violation.empty())
-        klee::klee_error("Parsing failed: No violation node");
+    return Eof;
+}
 
+void print_err_invalid(const std::string& val, const char* attr) {
+    klee::klee_error("Parsing failed: %s is not a valid value for key %s",
+                     val.c_str(), attr);
 }
 
-// Parse data nodes of element node and load into the automaton node
-void WitnessAutomaton::fill_node_data(rapidxml::xml_node<> *xml_node, node_ptr node) {
-    rapidxml::xml_node<> *data_node =xml_node->first_node("data");
-    char *attr;
-    char *value;
-    while (data_node) {
-        attr = data_node->first_attribute("key")->value();
-        value = data_node->value();
-        if (strcmp(attr, "entry") == 0)
-            set_bool_val(value, attr, node->entry);
-        if (strcmp(attr, "sink") == 0)
-            set_bool_val(value, attr, node->sink);
-        if (strcmp(attr, "violation") == 0)
-            set_bool_val(value, attr, node->violation);
-        data_node = data_node->next_sibling();
+// Set attr value according to the string str
+void set_bool_val(const std::string& str, const char* attr_name, bool& attr) {
+    if (str.empty())
+        return;
+    if (str == "true") {
+        attr = true; return;
     }
+    if (str == "false") {
+        attr = false; return;
+    }
+    print_err_invalid(str, attr_name);
 }
 
-// Add edges to the automaton
-void WitnessAutomaton::fill_edges(rapidxml::xml_node<>* root) {
-    rapidxml::xml_node<> *child = root->first_node("edge");
-    std::string src_id;
-    std::string tar_id;
-    while (child) {
-        if (!child->first_attribute("source") || !child->first_attribute("target")) {
-            klee::klee_error("Parsing failed: Edge missing attribute source or target");
-        }
-        src_id = child->first_attribute("source")->value();
-        tar_id = child->first_attribute("target")->value();
-
-        if (nodes.find(src_id) == nodes.end() || nodes.find(tar_id) == nodes.end()) {
-            klee::klee_error("Parsing failed: Edge between non existent nodes");
+// Load a data element of element graph into the automaton
+void WitnessAutomaton::fill_data(const std::string& key, const std::string& value) {
+    if (key == "witness-type") {
+        if (value != "violation_witness")
+            klee::klee_error("Only error witnesses are supported");
+        data.type = value;
+    }
+    else if (key == "sourcecodelang") {
+        if (value != "C" && value != "c") {
+            klee::klee_message("Only C language is supported");
+            print_err_invalid(value, "sourcecodelang");
         }
-        edge_ptr edge = std::make_shared<WitnessEdge>();
-        edge.get()->source = nodes[src_id];
-        edge.get()->target = nodes[tar_id];
-        fill_edge_data(child, edge);
-
-        //nodes[tar_id].get()->edges_in.emplace(edge);
-         if (edge->assumResFunc.compare(0, 17, "__VERIFIER_nondet") == 0)
-            nodes[src_id]->replayEdges.emplace(edge);
-         else
-            nodes[src_id].get()->edges.emplace(edge);
-
-
-        edges.emplace(edge);
-
-        child = child->next_sibling("edge");
+        data.lang = value;
     }
+    else if (key == "producer")
+        data.producer = value;
+    else if (key == "specification")
+        load_spec(value);
+    else if (key == "programfile")
+        data.file = value;
+    else if (key == "programhash")
+        data.hash = value;
+    else if (key == "architecture")
+        data.arch = value;
+    else if (key == "creationtime")
+        data.time = value;
+   // else {
+   //     std::cerr << "parse error: unknown attribute " << key << std::endl;
+   // }
 }
 
-// Parse data nodes of element edge and load into the automaton edge
-void WitnessAutomaton::fill_edge_data (rapidxml::xml_node<>* xml_node, edge_ptr edge) {
-    rapidxml::xml_node<> *data_node =xml_node->first_node("data");
-    char * attr;
-    while (data_node) {
-        attr = data_node->first_attribute("key")->value();
-        if (strcmp(attr, "assumption") == 0)
-            edge.get()->assumption = data_node->value();
-        else if (strcmp(attr, "assumption.scope") == 0)
-            edge.get()->assumScope = data_node->value();
-        else if (strcmp(attr, "assumption.resultfunction") == 0)
-            edge.get()->assumResFunc = data_node->value();
-        else if (strcmp(attr, "control") == 0) {
-            char * control = data_node->value();
-            if (strcmp(control, "condition-true") != 0
-                    && strcmp(control, "condition-false") != 0)
-                print_err_invalid(control, "control");
-            edge.get()->control = control;
-        }
-        else if (strcmp(attr, "startline") == 0) {
-            edge.get()->startline = std::strtol(data_node->value(), nullptr, 10);
-        }
-        else if (strcmp(attr, "endline") == 0) {
-            edge.get()->endline = std::strtol(data_node->value(), nullptr, 10);
-        }
-        else if (strcmp(attr, "startoffset") == 0) {
-            edge.get()->startoffset = std::strtol(data_node->value(), nullptr, 10);
-            if (refute) {
-                klee::klee_message("Using unsupported atttribute, witness refutation disabled.");
-                refute = false;
-            }
-        }
-        else if (strcmp(attr, "endoffset") == 0) {
-            edge.get()->endoffset = std::strtol(data_node->value(), nullptr, 10);
-            if (refute) {
-                klee::klee_message("Using unsupported atttribute, witness refutation disabled.");
-                refute = false;
-            }
-        }
-        else if (strcmp(attr, "enterLoopHead") == 0) {
-            set_bool_val(data_node->value(), "enterLoopHead", edge->enterLoop);
-        }
-        else if (strcmp(attr, "enterFunction") == 0)
-            edge.get()->enterFunc = data_node->value();
-        else if (strcmp(attr, "returnFromFunction") == 0 || strcmp(attr, "returnFrom") == 0)
-            edge.get()->retFromFunc = data_node->value();
-        //else {
-        //    std::cerr << "parse error: unknown attribute " << attr << std::endl;
-        //   return false;
-        //}
-        data_node = data_node->next_sibling("data");
+// Load a data element of element node into the automaton node
+void WitnessAutomaton::fill_node_data(const std::string& key,
+                                      const std::string& value,
+                                      WitnessNode& node) {
+    if (key == "entry")
+        set_bool_val(value, "entry", node.entry);
+    if (key == "sink")
+        set_bool_val(value, "sink", node.sink);
+    if (key == "violation")
+        set_bool_val(value, "violation", node.violation);
+}
+
+// Load a data element of element edge into the automaton edge
+void WitnessAutomaton::fill_edge_data(const std::string& key,
+                                      const std::string& value,
+                                      WitnessEdge& edge) {
+    if (key == "assumption")
+        edge.assumption = value;
+    else if (key == "assumption.scope")
+        edge.assumScope = value;
+    else if (key == "assumption.resultfunction")
+        edge.assumResFunc = value;
+    else if (key == "control") {
+        if (value != "condition-true" && value != "condition-false")
+            print_err_invalid(value, "control");
+        edge.control = value;
+    }
+    else if (key == "startline") {
+        edge.startline = std::strtol(value.c_str(), nullptr, 10);
     }
-    if (!edge->assumResFunc.empty()) {
-        if (!edge->assumption.empty())
-            edge->assumption = parseAssumption(edge->assumption, refute);
+    else if (key == "endline") {
+        edge.endline = std::strtol(value.c_str(), nullptr, 10);
     }
-    else {
-        if (refute && edge->source.lock()->edges.size() > 1) {
-            klee::klee_message("Using unsupported assumptions, witness refutation disabled.");
+    else if (key == "startoffset") {
+        edge.startoffset = std::strtol(value.c_str(), nullptr, 10);
+        if (refute) {
+            klee::klee_message("Using unsupported atttribute, witness refutation disabled.");
             refute = false;
         }
+    }
+    else if (key == "endoffset") {
+        edge.endoffset = std::strtol(value.c_str(), nullptr, 10);
+        if (refute) {
+            klee::klee_message("Using unsupported atttribute, witness refutation disabled.");
+            refute = false;
+        }
+    }
+    else if (key == "enterLoopHead") {
+        set_bool_val(value, "enterLoopHead", edge.enterLoop);
+    }
+    else if (key == "enterFunction")
+        edge.enterFunc = value;
+    else if (key == "returnFromFunction" || key == "returnFrom")
+        edge.retFromFunc = value;
+    //else {
+    //    std::cerr << "parse error: unknown attribute " << key << std::endl;
+    //   return false;
+    //}
+}
 
+// Order the edges by their source, the ones with replay values last, so that
+// the edges leaving each node form two ranges. The edges are placed by
+// counting, keeping their order in the document within each range.
+void WitnessAutomaton::compile_edges() {
+    // the start of the edges of each node, then of its replay edges
+    std::vector<unsigned> starts(2 * nodes.size() + 1);
+    for (const WitnessEdge& edge : edges)
+        ++starts[2 * edge.source + edge.is_replay() + 1];
+    for (unsigned i = 1; i < starts.size(); i++)
+        starts[i] += starts[i - 1];
+
+    for (unsigned n = 0; n < nodes.size(); n++) {
+        nodes[n].edges_begin = starts[2 * n];
+        nodes[n].replay_begin = starts[2 * n + 1];
+        nodes[n].edges_end = starts[2 * n + 2];
     }
+
+    std::vector<WitnessEdge> compiled(edges.size());
+    for (WitnessEdge& edge : edges)
+        compiled[starts[2 * edge.source + edge.is_replay()]++] = std::move(edge);
+    edges.swap(compiled);
 }
 
 // Load the file and build the automaton
 void WitnessAutomaton::load (const char* filename){
     refute = klee::RefuteWitness;
-    std::ifstream ifs(filename);
-    if (!ifs.good()) {
+    auto buffer = llvm::MemoryBuffer::getFile(filename);
+    if (!buffer) {
         klee::klee_error("Parsing failed: Can not load file");
     }
 
-    std::string content( (std::istreambuf_iterator<char>(ifs) ),
-                           (std::istreambuf_iterator<char>()    ) );
+    enum Element { GraphML, Graph, Node, Edge, Data, Other };
+    // the elements enclosing the current position
+    std::vector<Element> open;
+    // node ids are interned when they are first referred to, by a node or
+    // by an edge
+    llvm::StringMap<unsigned> ids;
+    std::vector<bool> declared;
+    // the number of edges without replay values leaving each node so far
+    std::vector<unsigned> outgoing;
+    auto intern = [&](const std::string& id) {
+        auto it = ids.insert(std::make_pair(id, (unsigned)nodes.size()));
+        if (it.second) {
+            nodes.emplace_back();
+            nodes.back().id = id;
+            declared.push_back(false);
+            outgoing.push_back(0);
+        }
+        return it.first->second;
+    };
+
+    bool has_graph = false;
+    bool has_entry = false;
+    bool has_violation = false;
+    unsigned node = 0;
+    std::string key, value;
+
+    XMLReader reader((*buffer)->getBuffer());
+    XMLReader::Token token;
+    while ((token = reader.next()) != XMLReader::Eof) {
+        if (token == XMLReader::Text) {
+            if (!open.empty() && open.back() == Data)
+                value += reader.text;
+            continue;
+        }
+
+        if (token == XMLReader::Start) {
+            if (open.empty()) {
+                if (reader.name != "graphml")
+                    klee::klee_error("Parsing failed: Document missing element graphml");
+                open.push_back(GraphML);
+                continue;
+            }
 
-    rapidxml::xml_document<> wit;
-    wit.parse<0>(&content[0]);
+            Element parent = open.back();
+            Element element = Other;
+            if (parent == GraphML && reader.name == "graph" && !has_graph) {
+                element = Graph;
+                has_graph = true;
+            } else if (parent == Graph && reader.name == "node") {
+                const std::string *id = reader.get_attribute("id");
+                if (!id) {
+                    klee::klee_error("Parsing failed: Node missing attribute id");
+                }
+                if (id->empty() || declared[node = intern(*id)]) {
+                    klee::klee_error("Parsing failed: Missing or duplicate node id");
+                }
+                declared[node] = true;
+                element = Node;
+            } else if (parent == Graph && reader.name == "edge") {
+                const std::string *source = reader.get_attribute("source");
+                const std::string *target = reader.get_attribute("target");
+                if (!source || !target) {
+                    klee::klee_error("Parsing failed: Edge missing attribute source or target");
+                }
+                edges.emplace_back();
+                edges.back().source = intern(*source);
+                edges.back().target = intern(*target);
+                element = Edge;
+            } else if ((parent == Graph || parent == Node || parent == Edge) &&
+                       reader.name == "data") {
+                const std::string *k = reader.get_attribute("key");
+                key = k ? *k : std::string();
+                value.clear();
+                element = Data;
+            }
+            open.push_back(element);
+            continue;
+        }
 
-    if (strcmp(wit.first_node()->name(), "graphml") != 0) {
-        klee::klee_error("Parsing failed: Document missing element graphml");
+        if (open.empty())
+            klee::klee_error("Parsing failed: unexpected end tag");
+        Element element = open.back();
+        open.pop_back();
+        if (element == Data) {
+            if (open.back() == Graph)
+                fill_data(key, value);
+            else if (open.back() == Node)
+                fill_node_data(key, value, nodes[node]);
+            else
+                fill_edge_data(key, value, edges.back());
+        } else if (element == Node) {
+            if (nodes[node].entry) {
+                if (has_entry) {
+                    klee::klee_error("Parsing failed: Duplicate entry node");
+                }
+                entry = node;
+                has_entry = true;
+            }
+            if (nodes[node].violation) {
+                has_violation = true;
+            }
+        } else if (element == Edge) {
+            WitnessEdge& edge = edges.back();
+            if (!edge.assumResFunc.empty()) {
+                if (!edge.assumption.empty())
+                    edge.assumption = parseAssumption(edge.assumption, refute);
+            }
+            if (edge.assumResFunc.empty() && refute && outgoing[edge.source] > 1) {
+                klee::klee_message("Using unsupported assumptions, witness refutation disabled.");
+                refute = false;
+            }
+            if (!edge.is_replay())
+                ++outgoing[edge.source];
+        }
     }
-    rapidxml::xml_node<>* root = wit.first_node()->first_node("graph");
-    if (strcmp(root->name(), "graph") != 0) {
+
+    if (!open.empty())
+        klee::klee_error("Parsing failed: unexpected end of data");
+    if (!has_graph) {
         klee::klee_error("Parsing failed: Document missing element graph");
     }
-    fill_data(root);
-    fill_nodes(root);
-    fill_edges(root);
-
-
+    if (data.spec.empty()) {
+        klee::klee_error("Parsing failed: Invalid or missing witness specification");
+    }
+    if (!has_entry)
+        klee::klee_error("Parsing failed: Missing entry node");
+    if (!has_violation)
+        klee::klee_error("Parsing failed: No violation node");
+    if (std::find(declared.begin(), declared.end(), false) != declared.end()) {
+        klee::klee_error("Parsing failed: Edge between non existent nodes");
+    }
+    compile_edges();
 }
 
 // Get the necessary info out of the specification
@@ -314,7 +539,7 @@ bool WitnessAutomaton::get_spec(WitnessSpec s){
 
 
 /* Fill nondet_* function return values provided by the witness */
-std::pair<bool, klee::ConcreteValue> fill_replay(WitnessEdge e) {
+std::pair<bool, klee::ConcreteValue> fill_replay(const WitnessEdge& e) {
     std::string value_string = e.assumption;
     if (value_string.empty()) {
         klee::klee_warning("Parsing: Ignoring assumption.resultfuntion: invalid format");
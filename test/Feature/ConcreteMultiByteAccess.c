@@ -0,0 +1,41 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc %S/Inputs/violation-witness.graphml 2>&1 | FileCheck %s
+
+#include "klee/klee.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+int main() {
+  unsigned char buf[32];
+  unsigned i;
+  unsigned char c;
+
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = i;
+
+  // concrete multi-byte reads of bytes written one at a time
+  assert(*(uint16_t *)&buf[2] == 0x0302);
+  assert(*(uint32_t *)&buf[4] == 0x07060504);
+  assert(*(uint64_t *)&buf[8] == 0x0f0e0d0c0b0a0908ULL);
+
+  // concrete multi-byte writes read back byte by byte
+  *(uint64_t *)&buf[16] = 0x1122334455667788ULL;
+  assert(buf[16] == 0x88 && buf[23] == 0x11);
+  *(uint32_t *)&buf[17] = 0xaabbccdd;
+  assert(buf[16] == 0x88 && buf[17] == 0xdd && buf[20] == 0xaa &&
+         buf[21] == 0x33);
+
+  // a symbolic byte in the range takes the byte-wise path
+  klee_make_symbolic(&c, sizeof(c), "c");
+  klee_assume(c == 0x42);
+  buf[25] = c;
+  *(uint16_t *)&buf[26] = 0xbeef;
+  assert(*(uint32_t *)&buf[24] == 0xbeef4218);
+  *(uint32_t *)&buf[24] = 0x01020304;
+  assert(*(uint64_t *)&buf[24] == 0x1f1e1d1c01020304ULL);
+
+  // CHECK: KLEE: done: completed paths = 1
+  return 0;
+}
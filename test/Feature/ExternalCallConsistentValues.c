@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --external-calls=all %t.bc %S/Inputs/violation-witness.graphml > %t.out 2>&1
+// RUN: FileCheck --input-file=%t.out %s
+
+#include "klee/klee.h"
+#include <stdio.h>
+#include <string.h>
+
+int main() {
+  char buf[2];
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_assume(x > 'a');
+  klee_assume(x < 'z');
+  buf[0] = x;
+  buf[1] = 0;
+
+  // the argument and the flushed byte must be concretized consistently
+  // CHECK: found
+  // CHECK-NOT: missing
+  if (memchr(buf, x, 1))
+    printf("found\n");
+  else
+    printf("missing\n");
+
+  return 0;
+}
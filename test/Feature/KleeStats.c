@@ -3,6 +3,8 @@
 // RUN: %klee --output-dir=%t.klee-out  %t.bc 2> %t.log
 // RUN: klee-stats --print-more %t.klee-out > %t.stats
 // RUN: FileCheck -check-prefix=CHECK-STATS -input-file=%t.stats %s
+// RUN: klee-stats --print-all %t.klee-out > %t.allstats
+// RUN: FileCheck -check-prefix=CHECK-ALL -input-file=%t.allstats %s
 #include "klee/klee.h"
 #include <stdlib.h>
 int main(){
@@ -17,3 +19,5 @@ int main(){
 // CHECK-STATS: | Path | Instrs| Time(s)| ICov(%)| BCov(%)| ICount| TSolver(%)|
 //Check there is a line with .klee-out dir, non zero instruction, less than 1 second execution time and 100 ICov.
 // CHECK-STATS: {{.*\.klee-out\|[ ]*[1-9]+\|[ ]*0\.([0-9]+)\|[ ]*100\.00}}
+// Check the bounds check counters are reported
+// CHECK-ALL: BChecks{{.*}}BCQueries{{.*}}BCSaved{{.*}}Allocs{{.*}}OSAllocs{{.*}}PoolMem{{.*}}QPCHits{{.*}}QPCMisses{{.*}}SPQueries{{.*}}SPHits{{.*}}RQueries{{.*}}RSaved{{.*}}SegPSaved
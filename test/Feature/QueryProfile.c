@@ -0,0 +1,27 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --query-profile --query-profile-dump=2 %t.bc %S/Inputs/violation-witness.graphml
+// RUN: FileCheck --input-file=%t.klee-out/query-profile.txt %s
+// RUN: %kleaver %t.klee-out/hot-query-1.kquery
+// RUN: %kleaver %t.klee-out/hot-query-2.kquery
+
+#include "klee/klee.h"
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+
+  // CHECK: # By location
+  // CHECK: QueryProfile.c:{{[0-9]+}}
+  // CHECK: # By query shape
+  // CHECK: nonlinear
+  // CHECK: # Slowest queries
+  // CHECK-NEXT: hot-query-1.kquery
+  // CHECK-NEXT: hot-query-2.kquery
+  if (x * y == 42)
+    return 1;
+  if (x < y)
+    return 2;
+  return 0;
+}
@@ -0,0 +1,30 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --speculative-workers=2 %t.bc %S/Inputs/violation-witness.graphml 2> %t.log
+// RUN: FileCheck -input-file=%t.log %s
+// RUN: klee-stats --print-all %t.klee-out > %t.stats
+// RUN: FileCheck -check-prefix=CHECK-STATS -input-file=%t.stats %s
+#include "klee/klee.h"
+
+int main() {
+  int a[4];
+  klee_make_symbolic(a, sizeof(a), "a");
+
+  int count = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (a[i] > i)
+      ++count;
+  }
+
+  // infeasible branches must still be pruned with speculated results
+  if (a[0] > 0 && a[0] < 0)
+    klee_assert(0);
+
+  return count;
+}
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 16
+// The states waiting in the loop reach their next branch on a[i] through
+// concrete code, so check that some were speculated and their results used
+// CHECK-STATS: {{SPQueries\|[ ]*SPHits\|[ ]*RQueries\|[ ]*RSaved\|[ ]*SegPSaved\|$}}
+// CHECK-STATS: {{\|[ ]*[1-9][0-9]*\|[ ]*[1-9][0-9]*\|[ ]*[0-9]+\|[ ]*[0-9]+\|[ ]*[0-9]+\|$}}
@@ -0,0 +1,38 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc %S/Inputs/violation-witness.graphml 2>&1 | FileCheck %s
+// RUN: klee-stats --print-all %t.klee-out > %t.stats
+// RUN: FileCheck -check-prefix=CHECK-STATS -input-file=%t.stats %s
+
+#include "klee/klee.h"
+#include <stdlib.h>
+
+#define N 32
+
+int main() {
+  int *buf[N];
+  unsigned i, s;
+
+  for (i = 0; i < N; i++) {
+    buf[i] = malloc(sizeof(*buf[i]));
+    *buf[i] = i;
+  }
+
+  klee_make_symbolic(&s, sizeof(s), "s");
+  klee_assume(s >= 7);
+  klee_assume(s < 10);
+
+  // the loaded pointer has a symbolic segment that may only
+  // resolve to the objects in buf[7..9]
+  int x = *buf[s];
+  if (x < 7 || x >= 10)
+    abort();
+
+  return 0;
+}
+// CHECK-NOT: KLEE: ERROR
+// CHECK: KLEE: done: completed paths = 3
+// Only three of the live segments are feasible, so bisecting them must
+// save queries compared to checking every segment
+// CHECK-STATS: {{RQueries\|[ ]*RSaved\|[ ]*SegPSaved\|$}}
+// CHECK-STATS: {{\|[ ]*[1-9][0-9]*\|[ ]*[1-9][0-9]*\|[ ]*[0-9]+\|$}}
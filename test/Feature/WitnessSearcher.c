@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --search=witness %t.bc %S/Inputs/witness-searcher.graphml > %t.out 2> %t.log
+// RUN: FileCheck -input-file=%t.out %s
+// RUN: FileCheck -check-prefix=CHECK-LOG -input-file=%t.log %s
+#include <stdio.h>
+
+extern void reach_error(void);
+extern int __VERIFIER_nondet_int(void);
+
+void report(void) {
+  printf("report\n");
+  reach_error(); // the violation of the witness
+}
+
+int main() {
+  // the state calling report is selected first, as the edge to the
+  // violation node is closer to it through the call, although the other
+  // state was added last
+  if (__VERIFIER_nondet_int() > 0)
+    report();
+  else
+    printf("other\n");
+  return 0;
+}
+// CHECK: report
+// CHECK-NOT: other
+// CHECK-LOG: Valid violation witness
@@ -0,0 +1,89 @@
+//===-- BitArrayTest.cpp ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/util/BitArray.h"
+
+using klee::BitArray;
+
+namespace {
+
+TEST(BitArrayTest, SetRange) {
+  BitArray ba(200);
+  ba.setRange(3, 150, true);
+  for (unsigned i = 0; i < 200; ++i)
+    EXPECT_EQ(ba.get(i), i >= 3 && i < 150);
+  EXPECT_EQ(ba.count(), 147u);
+
+  ba.setRange(64, 128, false);
+  EXPECT_TRUE(ba.allSet(3, 64));
+  EXPECT_TRUE(ba.noneSet(64, 128));
+  EXPECT_FALSE(ba.allSet(3, 65));
+  EXPECT_EQ(ba.count(), 83u);
+}
+
+TEST(BitArrayTest, FindFirst) {
+  BitArray ba(300, true);
+  EXPECT_EQ(ba.findFirstUnset(), 300u);
+  ba.unset(70);
+  ba.unset(299);
+  EXPECT_EQ(ba.findFirstUnset(), 70u);
+  EXPECT_EQ(ba.findFirstUnset(71), 299u);
+  EXPECT_EQ(ba.findFirstSet(70), 71u);
+
+  BitArray empty(130);
+  EXPECT_EQ(empty.findFirstSet(), 130u);
+  empty.set(129);
+  EXPECT_EQ(empty.findFirstSet(5), 129u);
+}
+
+TEST(BitArrayTest, RangeQueriesStopAtEnd) {
+  BitArray ba(100000);
+  ba.setRange(0, 16, true);
+  EXPECT_TRUE(ba.allSet(0, 16));
+  EXPECT_TRUE(ba.allSet(5, 16));
+  EXPECT_FALSE(ba.allSet(0, 17));
+  EXPECT_TRUE(ba.noneSet(16, 100000));
+  EXPECT_FALSE(ba.noneSet(15, 17));
+  EXPECT_TRUE(ba.allSet(7, 7));
+  EXPECT_TRUE(ba.noneSet(64, 64));
+
+  ba.setRange(64, 128, true);
+  ba.set(99999);
+  EXPECT_TRUE(ba.allSet(64, 128));
+  EXPECT_FALSE(ba.allSet(63, 128));
+  EXPECT_FALSE(ba.allSet(64, 129));
+  EXPECT_TRUE(ba.noneSet(128, 99999));
+  EXPECT_FALSE(ba.noneSet(128, 100000));
+}
+
+TEST(BitArrayTest, Resize) {
+  BitArray ba(10, true);
+  ba.resize(5);
+  ba.resize(100, false);
+  EXPECT_EQ(ba.count(), 5u);
+  EXPECT_EQ(ba.findFirstUnset(), 5u);
+  ba.resize(0);
+  ba.resize(70, true);
+  EXPECT_TRUE(ba.allSet(0, 70));
+}
+
+TEST(BitArrayTest, CopiesAreIndependent) {
+  BitArray ba(5000);
+  ba.setRange(0, 5000, true);
+  BitArray copy(ba);
+  copy.unset(4096);
+  EXPECT_TRUE(ba.get(4096));
+  EXPECT_FALSE(copy.get(4096));
+  EXPECT_EQ(ba.count(), 5000u);
+  EXPECT_EQ(copy.count(), 4999u);
+}
+
+} // namespace
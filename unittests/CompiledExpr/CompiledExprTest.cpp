@@ -0,0 +1,261 @@
+//===-- CompiledExprTest.cpp ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/CompiledExpr.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+const Expr::Width Widths[] = {Expr::Bool, 5,  Expr::Int8, Expr::Int16,
+                              Expr::Int32, Expr::Int64, 77, 128};
+
+/// Generates random expressions over a few symbolic arrays, a constant
+/// array and an array with symbolic updates.
+class ExprGenerator {
+  std::mt19937 rng;
+  ArrayCache cache;
+
+  unsigned pick(unsigned n) { return rng() % n; }
+
+  ref<Expr> binary(Expr::Kind k, const ref<Expr> &l, ref<Expr> r) {
+    // like the executor, never divide by a constant zero, which
+    // ExprEvaluator doesn't handle
+    if (k >= Expr::UDiv && k <= Expr::SRem)
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(r))
+        if (CE->isZero())
+          r = ConstantExpr::alloc(1, r->getWidth());
+    std::vector<Expr::CreateArg> args;
+    args.push_back(Expr::CreateArg(l));
+    args.push_back(Expr::CreateArg(r));
+    return Expr::createFromKind(k, args);
+  }
+
+  ref<Expr> byte(unsigned depth) {
+    ref<Expr> index;
+    if (depth && pick(4) == 0)
+      index = ZExtExpr::create(gen(Expr::Int8, depth - 1), Expr::Int32);
+    else
+      index = ConstantExpr::alloc(pick(10), Expr::Int32);
+    switch (pick(3)) {
+    case 0:
+      return ReadExpr::create(UpdateList(constantArray, 0), index);
+    case 1:
+      return ReadExpr::create(updated, index);
+    default:
+      return ReadExpr::create(UpdateList(arrays[pick(arrays.size())], 0),
+                              index);
+    }
+  }
+
+  ref<Expr> leaf(Expr::Width w, unsigned depth) {
+    if (pick(3) == 0) {
+      llvm::APInt v(w, 0);
+      for (unsigned i = 0; i < w; i += 32)
+        v |= llvm::APInt(w, rng()).shl(i);
+      // small values make divisions by zero and overshifts likely
+      if (pick(2))
+        v = llvm::APInt(w, pick(4));
+      return ConstantExpr::alloc(v);
+    }
+    ref<Expr> e = byte(depth);
+    while (e->getWidth() < w)
+      e = ConcatExpr::create(byte(depth), e);
+    return ExtractExpr::create(e, 0, w);
+  }
+
+public:
+  std::vector<const Array *> arrays;
+  const Array *constantArray;
+  UpdateList updated;
+
+  ExprGenerator() : rng(7), updated(0, 0) {
+    for (unsigned i = 0; i < 3; ++i)
+      arrays.push_back(cache.CreateArray("arr" + std::to_string(i), 8));
+    std::vector<ref<ConstantExpr> > values;
+    for (unsigned i = 0; i < 6; ++i)
+      values.push_back(ConstantExpr::alloc(3 * i + 1, Expr::Int8));
+    constantArray = cache.CreateArray("const", values.size(), &values[0],
+                                      &values[0] + values.size());
+    updated = UpdateList(arrays[0], 0);
+    for (unsigned i = 0; i < 4; ++i)
+      updated.extend(ZExtExpr::create(leaf(Expr::Int8, 0), Expr::Int32),
+                     leaf(Expr::Int8, 0));
+  }
+
+  ref<Expr> gen(Expr::Width w, unsigned depth) {
+    if (!depth)
+      return leaf(w, 0);
+    --depth;
+    switch (pick(8)) {
+    case 0:
+      return leaf(w, depth);
+    case 1: {
+      Expr::Kind k = Expr::Kind(Expr::Add + pick(Expr::AShr - Expr::Add + 1));
+      return binary(k, gen(w, depth), gen(w, depth));
+    }
+    case 2:
+      if (w == Expr::Bool) {
+        Expr::Width ow = Widths[pick(8)];
+        Expr::Kind k = Expr::Kind(Expr::Eq + pick(Expr::Sge - Expr::Eq + 1));
+        return binary(k, gen(ow, depth), gen(ow, depth));
+      }
+      return NotExpr::create(gen(w, depth));
+    case 3:
+      return SelectExpr::create(gen(Expr::Bool, depth), gen(w, depth),
+                                gen(w, depth));
+    case 4:
+      if (w > 1) {
+        Expr::Width l = 1 + pick(w - 1);
+        return ConcatExpr::create(gen(l, depth), gen(w - l, depth));
+      }
+      return gen(w, depth);
+    case 5: {
+      Expr::Width from = w + 1 + pick(70);
+      return ExtractExpr::create(gen(from, depth), pick(from - w + 1), w);
+    }
+    case 6: {
+      Expr::Width from = 1 + pick(w);
+      ref<Expr> e = gen(from, depth);
+      return pick(2) ? ZExtExpr::create(e, w) : SExtExpr::create(e, w);
+    }
+    default:
+      return NotOptimizedExpr::create(gen(w, depth));
+    }
+  }
+
+  std::shared_ptr<const Assignment> assignment() {
+    Assignment::map_bindings_ty models;
+    for (const Array *array : arrays) {
+      // leave some arrays and bytes unbound
+      if (pick(4) == 0)
+        continue;
+      for (unsigned i = 0; i < 10; ++i)
+        if (pick(4))
+          models[array].add(i, pick(3) ? rng() : pick(3));
+    }
+    return std::make_shared<const Assignment>(models);
+  }
+};
+
+TEST(CompiledExprTest, AgreesWithAssignment) {
+  ExprGenerator g;
+  CompiledExprCache cache;
+  unsigned compiled = 0, fallbacks = 0;
+  for (unsigned i = 0; i < 1500; ++i) {
+    Expr::Width w = Widths[i % 8];
+    ref<Expr> e = g.gen(w, 1 + i % 5);
+    CompiledExpr c(e);
+    for (unsigned j = 0; j < 6; ++j) {
+      std::shared_ptr<const Assignment> a = g.assignment();
+      ref<Expr> expected = a->evaluate(e);
+      // ExprEvaluator does not fold a NotOptimizedExpr whose operand
+      // evaluated to a constant, which compiled expressions do
+      if (!isa<ConstantExpr>(expected))
+        continue;
+
+      ref<ConstantExpr> value;
+      if (c.evaluate(*a, value)) {
+        ++compiled;
+        ASSERT_EQ(expected, ref<Expr>(value)) << "for " << e;
+      } else {
+        ++fallbacks;
+      }
+      if (w == Expr::Bool) {
+        bool isTrue;
+        if (c.isTrue(*a, isTrue)) {
+          ASSERT_EQ(expected->isTrue(), isTrue);
+        }
+      }
+
+      // twice, the second time from the memoized values
+      ASSERT_EQ(expected, cache.evaluate(e, a));
+      ASSERT_EQ(expected, cache.evaluate(e, a));
+    }
+  }
+  // most expressions don't divide by zero
+  ASSERT_GT(compiled, 10 * fallbacks);
+}
+
+TEST(CompiledExprTest, DivisionByZero) {
+  ExprGenerator g;
+  ref<Expr> x = ReadExpr::create(UpdateList(g.arrays[0], 0),
+                                 ConstantExpr::alloc(0, Expr::Int32));
+  ref<Expr> y = ReadExpr::create(UpdateList(g.arrays[1], 0),
+                                 ConstantExpr::alloc(0, Expr::Int32));
+  CompiledExpr c(UDivExpr::create(x, y));
+
+  Assignment::map_bindings_ty models;
+  models[g.arrays[0]].add(0, 7);
+  models[g.arrays[1]].add(0, 2);
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(c.evaluate(Assignment(models), value));
+  ASSERT_EQ(value->getZExtValue(), 3u);
+
+  models[g.arrays[1]].add(0, 0);
+  ASSERT_FALSE(c.evaluate(Assignment(models), value));
+}
+
+TEST(CompiledExprTest, MemoizedPerAssignment) {
+  ExprGenerator g;
+  ref<Expr> e = EqExpr::create(
+      ReadExpr::create(UpdateList(g.arrays[0], 0),
+                       ConstantExpr::alloc(1, Expr::Int32)),
+      ConstantExpr::alloc(5, Expr::Int8));
+  CompiledExprCache cache;
+
+  for (unsigned i = 0; i < 100; ++i) {
+    Assignment::map_bindings_ty models;
+    models[g.arrays[0]].add(1, i % 2 ? 5 : 6);
+    // assignments freed in between may be allocated at the same address
+    auto a = std::make_shared<const Assignment>(models);
+    ASSERT_EQ(cache.evaluate(e, a)->isTrue(), i % 2 == 1);
+  }
+  ASSERT_EQ(cache.size(), 1u);
+}
+
+TEST(CompiledExprTest, FreedAssignmentsDropExpressions) {
+  ExprGenerator g;
+  ref<Expr> x = ZExtExpr::create(
+      ReadExpr::create(UpdateList(g.arrays[0], 0),
+                       ConstantExpr::alloc(0, Expr::Int32)),
+      Expr::Int32);
+  CompiledExprCache cache;
+
+  Assignment::map_bindings_ty models;
+  models[g.arrays[0]].add(0, 3);
+  auto kept = std::make_shared<const Assignment>(models);
+  ref<Expr> keptExpr = EqExpr::create(x, ConstantExpr::alloc(3, Expr::Int32));
+  ASSERT_TRUE(cache.evaluate(keptExpr, kept)->isTrue());
+
+  for (unsigned i = 0; i < 5000; ++i) {
+    auto a = std::make_shared<const Assignment>(models);
+    ref<Expr> e = EqExpr::create(
+        AddExpr::create(x, ConstantExpr::alloc(i, Expr::Int32)),
+        ConstantExpr::alloc(3 + i, Expr::Int32));
+    ASSERT_TRUE(cache.evaluate(e, a)->isTrue());
+  }
+  // expressions only evaluated under freed assignments are swept
+  ASSERT_LT(cache.size(), 2500u);
+
+  // the one evaluated under a live assignment is kept
+  size_t size = cache.size();
+  ASSERT_TRUE(cache.evaluate(keptExpr, kept)->isTrue());
+  ASSERT_EQ(cache.size(), size);
+}
+
+} // namespace
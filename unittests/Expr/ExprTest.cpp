@@ -11,6 +11,7 @@
 #include "gtest/gtest.h"
 
 #include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 
 using namespace klee;
@@ -264,4 +265,44 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, RelatedConstraints) {
+  ArrayCache ac;
+  const Array *a = ac.CreateArray("a", 4);
+  const Array *b = ac.CreateArray("b", 4);
+  const Array *c = ac.CreateArray("c", 4);
+  auto read = [](const Array *array, ref<Expr> index) {
+    return ReadExpr::create(UpdateList(array, 0), index);
+  };
+  ref<Expr> a0 = read(a, getConstant(0, 32));
+  ref<Expr> a1 = read(a, getConstant(1, 32));
+  ref<Expr> b0 = read(b, getConstant(0, 32));
+  ref<Expr> c0 = read(c, getConstant(0, 32));
+
+  ConstraintManager cm;
+  ref<Expr> e0 = UltExpr::create(a0, b0);
+  ref<Expr> e1 = UltExpr::create(a1, getConstant(10, 8));
+  ref<Expr> e2 = UltExpr::create(c0, getConstant(10, 8));
+  cm.addConstraint(e0);
+  cm.addConstraint(e1);
+  cm.addConstraint(e2);
+
+  std::vector<ref<Expr>> related;
+  cm.getRelatedConstraints(UltExpr::create(b0, getConstant(3, 8)), related);
+  EXPECT_EQ(std::vector<ref<Expr>>({e0}), related);
+
+  // a copy shares the clusters until either side adds a constraint
+  ConstraintManager copy(cm);
+  ref<Expr> e3 = UltExpr::create(read(a, ZExtExpr::create(c0, 32)),
+                                 getConstant(5, 8));
+  copy.addConstraint(e3);
+
+  related.clear();
+  copy.getRelatedConstraints(UltExpr::create(b0, getConstant(3, 8)), related);
+  EXPECT_EQ(std::vector<ref<Expr>>({e0, e1, e2, e3}), related);
+
+  related.clear();
+  cm.getRelatedConstraints(UltExpr::create(b0, getConstant(3, 8)), related);
+  EXPECT_EQ(std::vector<ref<Expr>>({e0}), related);
+}
 }
@@ -0,0 +1,119 @@
+//===-- SetTrieTest.cpp -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/SetTrie.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+
+using klee::SetTrie;
+
+namespace {
+
+// puts elements into few buckets so that the trie has to tell apart
+// elements with the same hash
+struct CollidingInfo {
+  static unsigned getHash(int k) { return k % 3; }
+  static bool isEqual(int a, int b) { return a == b; }
+  static bool isLess(int a, int b) { return a < b; }
+};
+
+typedef SetTrie<int, int, CollidingInfo> Trie;
+
+Trie::key_ty makeKey(std::initializer_list<int> elements) {
+  Trie::key_ty key(elements);
+  Trie::normalize(key);
+  return key;
+}
+
+TEST(SetTrieTest, Lookup) {
+  Trie t;
+  t.insert(makeKey({1, 2, 3}), 1);
+  t.insert(makeKey({1, 4}), 2);
+  t.insert(makeKey({}), 3);
+
+  ASSERT_TRUE(t.lookup(makeKey({3, 2, 1})));
+  EXPECT_EQ(*t.lookup(makeKey({3, 2, 1})), 1);
+  EXPECT_EQ(*t.lookup(makeKey({1, 4})), 2);
+  EXPECT_EQ(*t.lookup(makeKey({})), 3);
+  // same hashes as {1, 4}
+  EXPECT_FALSE(t.lookup(makeKey({1, 7})));
+  EXPECT_FALSE(t.lookup(makeKey({1, 2})));
+
+  t.insert(makeKey({1, 4}), 4);
+  EXPECT_EQ(*t.lookup(makeKey({1, 4})), 4);
+  EXPECT_EQ(t.size(), 3u);
+}
+
+TEST(SetTrieTest, Eviction) {
+  Trie t;
+  t.insert(makeKey({1}), 1);
+  t.insert(makeKey({2}), 2);
+  t.insert(makeKey({3}), 3);
+  t.lookup(makeKey({1}));
+
+  t.setMaxSize(2);
+  EXPECT_EQ(t.size(), 2u);
+  EXPECT_TRUE(t.lookup(makeKey({1})));
+  EXPECT_FALSE(t.lookup(makeKey({2})));
+
+  EXPECT_EQ(t.insert(makeKey({4, 5}), 4), 1u);
+  EXPECT_FALSE(t.lookup(makeKey({3})));
+  EXPECT_TRUE(t.lookup(makeKey({1})));
+  EXPECT_TRUE(t.lookup(makeKey({4, 5})));
+}
+
+TEST(SetTrieTest, RandomSubsetsAndSupersets) {
+  Trie t;
+  std::vector<std::set<int> > sets;
+  srand(1);
+  for (unsigned i = 0; i < 200; ++i) {
+    std::set<int> s;
+    for (unsigned n = rand() % 6; n; --n)
+      s.insert(rand() % 12);
+    Trie::key_ty key(s.begin(), s.end());
+    Trie::normalize(key);
+    t.insert(key, sets.size());
+    sets.push_back(s);
+  }
+
+  for (unsigned i = 0; i < 200; ++i) {
+    std::set<int> q;
+    for (unsigned n = rand() % 8; n; --n)
+      q.insert(rand() % 12);
+    Trie::key_ty key(q.begin(), q.end());
+    Trie::normalize(key);
+
+    // collect every match by rejecting all of them
+    std::set<std::set<int> > subsets, supersets;
+    t.findSubset(key, [&](const Trie::key_ty &k, int) {
+      subsets.insert(std::set<int>(k.begin(), k.end()));
+      return false;
+    });
+    t.findSuperset(key, [&](const Trie::key_ty &k, int) {
+      supersets.insert(std::set<int>(k.begin(), k.end()));
+      return false;
+    });
+
+    std::set<std::set<int> > expectedSubsets, expectedSupersets;
+    for (auto &s : sets) {
+      if (std::includes(q.begin(), q.end(), s.begin(), s.end()))
+        expectedSubsets.insert(s);
+      if (std::includes(s.begin(), s.end(), q.begin(), q.end()))
+        expectedSupersets.insert(s);
+    }
+    EXPECT_EQ(expectedSubsets, subsets);
+    EXPECT_EQ(expectedSupersets, supersets);
+  }
+}
+
+}
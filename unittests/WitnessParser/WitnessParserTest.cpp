@@ -0,0 +1,197 @@
+//===-- WitnessParserTest.cpp -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ConcreteValue.h"
+#include "witnessChecking/WitnessParser.h"
+
+#include "gtest/gtest.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+namespace {
+
+const char *Header =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+    "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+    " <key attr.name=\"entry\" id=\"entry\" for=\"node\">"
+    "<default>false</default></key>\n"
+    " <graph edgedefault=\"directed\">\n"
+    "  <data key=\"witness-type\">violation_witness</data>\n"
+    "  <data key=\"sourcecodelang\">C</data>\n"
+    "  <data key=\"specification\">"
+    "CHECK( init(main()), LTL(G ! call(reach_error())) )</data>\n";
+
+const char *Footer = " </graph>\n</graphml>\n";
+
+const char *Entry = "  <node id=\"A\"><data key=\"entry\">true</data></node>\n";
+const char *Violation =
+    "  <node id=\"V\"><data key=\"violation\">true</data></node>\n";
+
+/// Loads the witness whose graph holds \a elements besides its data.
+void load(WitnessAutomaton &witness, const std::string &elements) {
+  llvm::SmallString<128> path;
+  int fd;
+  ASSERT_FALSE(llvm::sys::fs::createTemporaryFile("witness", "graphml", fd,
+                                                  path));
+  llvm::FileRemover remover(path);
+  {
+    llvm::raw_fd_ostream out(fd, true);
+    out << Header << elements << Footer;
+  }
+  witness.load(path.c_str());
+}
+
+/// Returns the index of the node with \a id.
+unsigned findNode(const WitnessAutomaton &witness, const std::string &id) {
+  for (unsigned n = 0; n != witness.get_nodes_number(); ++n)
+    if (witness.get_node(n).id == id)
+      return n;
+  ADD_FAILURE() << "no node " << id;
+  return 0;
+}
+
+TEST(WitnessParserTest, Graph) {
+  WitnessAutomaton witness;
+  load(witness, "  <node id=\"A\"><data key=\"entry\">true</data></node>\n"
+                "  <node id=\"B\"><data key=\"violation\">true</data></node>\n"
+                "  <edge source=\"A\" target=\"B\">\n"
+                "   <data key=\"startline\">12</data>\n"
+                "   <data key=\"endline\">14</data>\n"
+                "   <data key=\"control\">condition-true</data>\n"
+                "  </edge>\n");
+
+  ASSERT_EQ(witness.get_nodes_number(), 2u);
+  ASSERT_EQ(witness.get_edges_number(), 1u);
+  unsigned a = findNode(witness, "A"), b = findNode(witness, "B");
+  ASSERT_EQ(witness.get_entry(), a);
+  ASSERT_TRUE(witness.get_node(b).violation);
+  ASSERT_TRUE(witness.get_spec(unreach_call));
+  ASSERT_EQ(witness.get_err_function(), "reach_error");
+
+  const WitnessNode &node = witness.get_node(a);
+  ASSERT_EQ(node.edges_end - node.edges_begin, 1u);
+  const WitnessEdge &edge = witness.get_edge(node.edges_begin);
+  ASSERT_EQ(edge.source, a);
+  ASSERT_EQ(edge.target, b);
+  ASSERT_EQ(edge.startline, 12);
+  ASSERT_EQ(edge.endline, 14);
+  ASSERT_EQ(edge.control, "condition-true");
+}
+
+TEST(WitnessParserTest, CharacterReferencesAndCDATA) {
+  WitnessAutomaton witness;
+  load(witness,
+       "  <!-- a <node id=\"C\"/> in a comment is skipped -->\n"
+       "  <node id=\"A&amp;B\"><data key=\"entry\">true</data></node>\n"
+       "  <node id='V'><data key=\"violation\">&#116;r&#x75;e</data></node>\n"
+       "  <edge source=\"A&#38;B\" target=\"&#x56;\">\n"
+       "   <data key=\"enterFunction\">f&lt;&#111;&#x3E;</data>\n"
+       "   <data key=\"assumption.scope\">"
+       "x<![CDATA[<&amp;>]]>&quot;&apos;&unknown;</data>\n"
+       "   <data key=\"returnFrom\"><![CDATA[]]></data>\n"
+       "  </edge>\n");
+
+  ASSERT_EQ(witness.get_nodes_number(), 2u);
+  unsigned a = findNode(witness, "A&B"), v = findNode(witness, "V");
+  ASSERT_EQ(witness.get_entry(), a);
+  ASSERT_TRUE(witness.get_node(v).violation);
+
+  const WitnessEdge &edge = witness.get_edge(witness.get_node(a).edges_begin);
+  ASSERT_EQ(edge.target, v);
+  ASSERT_EQ(edge.enterFunc, "f<o>");
+  // CDATA is taken literally, and unknown references are kept
+  ASSERT_EQ(edge.assumScope, "x<&amp;>\"'&unknown;");
+  ASSERT_EQ(edge.retFromFunc, "");
+}
+
+TEST(WitnessParserTest, SelfClosingTags) {
+  WitnessAutomaton witness;
+  load(witness, "  <node id=\"A\"><data key=\"entry\">true</data></node>\n"
+                "  <node id=\"B\"/>\n"
+                "  <node id=\"V\" ><data key=\"violation\">true</data></node>\n"
+                "  <edge source=\"A\" target=\"B\"/>\n"
+                "  <edge source=\"B\" target=\"V\" >\n"
+                "   <data key=\"startline\">3</data>\n"
+                "   <data key=\"enterFunction\"/>\n"
+                "  </edge>\n");
+
+  ASSERT_EQ(witness.get_nodes_number(), 3u);
+  ASSERT_EQ(witness.get_edges_number(), 2u);
+  unsigned a = findNode(witness, "A"), b = findNode(witness, "B"),
+           v = findNode(witness, "V");
+  ASSERT_FALSE(witness.get_node(b).violation);
+
+  const WitnessEdge &first = witness.get_edge(witness.get_node(a).edges_begin);
+  ASSERT_EQ(first.target, b);
+  ASSERT_EQ(first.startline, 0);
+  const WitnessEdge &second = witness.get_edge(witness.get_node(b).edges_begin);
+  ASSERT_EQ(second.target, v);
+  ASSERT_EQ(second.startline, 3);
+  ASSERT_EQ(second.enterFunc, "");
+}
+
+TEST(WitnessParserTest, EdgesBeforeNodes) {
+  WitnessAutomaton witness;
+  load(witness, "  <edge source=\"A\" target=\"B\"/>\n"
+                "  <edge source=\"B\" target=\"V\">\n"
+                "   <data key=\"assumption.resultfunction\">"
+                "__VERIFIER_nondet_int</data>\n"
+                "   <data key=\"assumption\">\\result == 5;</data>\n"
+                "  </edge>\n"
+                "  <edge source=\"B\" target=\"A\"/>\n"
+                "  <node id=\"V\"><data key=\"violation\">true</data></node>\n"
+                "  <node id=\"B\"/>\n"
+                "  <node id=\"A\"><data key=\"entry\">true</data></node>\n");
+
+  ASSERT_EQ(witness.get_nodes_number(), 3u);
+  unsigned a = findNode(witness, "A"), b = findNode(witness, "B"),
+           v = findNode(witness, "V");
+  ASSERT_EQ(witness.get_entry(), a);
+  ASSERT_TRUE(witness.get_node(v).violation);
+
+  // the edges leaving a node are its own, the replay ones last
+  const WitnessNode &node = witness.get_node(b);
+  ASSERT_EQ(node.replay_begin - node.edges_begin, 1u);
+  ASSERT_EQ(node.edges_end - node.replay_begin, 1u);
+  ASSERT_EQ(witness.get_edge(node.edges_begin).target, a);
+  const WitnessEdge &replay = witness.get_edge(node.replay_begin);
+  ASSERT_EQ(replay.source, b);
+  ASSERT_EQ(replay.target, v);
+  ASSERT_TRUE(replay.is_replay());
+}
+
+TEST(WitnessParserTest, DuplicateNodeId) {
+  WitnessAutomaton witness;
+  ASSERT_EXIT(load(witness, std::string(Entry) + Violation +
+                                "  <node id=\"A\"/>\n"
+                                "  <edge source=\"A\" target=\"V\"/>\n"),
+              ::testing::ExitedWithCode(1), "Missing or duplicate node id");
+}
+
+TEST(WitnessParserTest, MissingNode) {
+  WitnessAutomaton witness;
+  ASSERT_EXIT(load(witness, std::string(Entry) + Violation +
+                                "  <edge source=\"A\" target=\"V\"/>\n"
+                                "  <edge source=\"V\" target=\"W\"/>\n"),
+              ::testing::ExitedWithCode(1), "Edge between non existent nodes");
+}
+
+TEST(WitnessParserTest, MissingEntry) {
+  WitnessAutomaton witness;
+  ASSERT_EXIT(load(witness, std::string("  <node id=\"A\"/>\n") + Violation +
+                                "  <edge source=\"A\" target=\"V\"/>\n"),
+              ::testing::ExitedWithCode(1), "Missing entry node");
+}
+
+} // namespace